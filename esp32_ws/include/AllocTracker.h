@@ -0,0 +1,133 @@
+/**
+ * @file AllocTracker.h
+ * @brief Heap allocation accounting per subsystem
+ *
+ * malloc/calloc/realloc/free are intercepted (linker --wrap on the ESP32,
+ * symbol interposition in the native build) and counted globally and for
+ * the task that has an AllocTracker::Scope open. A scope attributes the
+ * allocations made by its own task to a subsystem; nested scopes are
+ * inclusive, so the main loop also counts the state changes it triggers.
+ * Scope::getRetainedBytes() tells how much of that is still allocated,
+ * which DeviceManager uses for the heap held by each device.
+ *
+ * AllocTracker::loop() samples free heap and the largest free block
+ * (internal RAM and PSRAM) once a minute to show the fragmentation trend.
+ */
+
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+enum class AllocSubsystem : uint8_t
+{
+    MainLoop,
+    WebSocket,
+    StateChange,
+    DeviceSetup,
+    Count
+};
+
+struct AllocCounters
+{
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t bytes = 0;
+    int64_t liveBytes = 0; // Usable bytes allocated minus freed; only tracked per task
+};
+
+class AllocTracker
+{
+public:
+    static constexpr uint8_t SAMPLE_COUNT = 60;
+    static constexpr uint32_t SAMPLE_INTERVAL_MS = 60000;
+
+    /**
+     * @class Scope
+     * @brief RAII bracket that attributes the current task's allocations to a subsystem
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(AllocSubsystem subsystem);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        /**
+         * @brief Heap still held from allocations made by this task since the scope opened
+         */
+        int32_t getRetainedBytes() const;
+
+    private:
+        AllocSubsystem _subsystem;
+        int8_t _slot;
+        AllocCounters _start;
+    };
+
+    struct SubsystemStats
+    {
+        uint32_t calls = 0;
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+        uint32_t maxAllocationsPerCall = 0;
+        uint64_t allocationsAtLastSample = 0;
+        float allocationsPerSec = 0;
+    };
+
+    struct HeapSample
+    {
+        uint32_t uptimeSec;
+        uint32_t freeHeap;
+        uint32_t largestFreeBlock;
+        uint32_t freePsram;
+        uint32_t largestFreePsramBlock;
+    };
+
+    /**
+     * @brief Take a heap sample every SAMPLE_INTERVAL_MS; call from the main loop
+     */
+    static void loop();
+
+    /**
+     * @brief Allocations made by all tasks since boot (or the last reset)
+     */
+    static AllocCounters getTotals();
+
+    static SubsystemStats getSubsystemStats(AllocSubsystem subsystem);
+    static const char *getSubsystemName(AllocSubsystem subsystem);
+
+    /**
+     * @brief Fragmentation in percent: share of free memory not usable for the largest allocation
+     */
+    static uint8_t getFragmentation(uint32_t freeBytes, uint32_t largestFreeBlock);
+
+    /**
+     * @brief Write totals, per-subsystem stats, current heap and the sample history into obj
+     */
+    static void toJson(JsonObject obj);
+
+    static void reset();
+
+    // Called by the allocator hooks; onFree gets the block's usable size, read before it is freed
+    static void onAllocate(size_t size, void *ptr);
+    static void onFree(size_t blockBytes);
+
+private:
+    static void takeSample();
+
+    static SubsystemStats subsystems[static_cast<uint8_t>(AllocSubsystem::Count)];
+    static HeapSample samples[SAMPLE_COUNT];
+    static uint8_t sampleCount;
+    static uint8_t sampleHead;
+    static unsigned long lastSampleMs;
+    static uint64_t totalAllocationsAtLastSample;
+    static float totalAllocationsPerSec;
+
+    // Private constructor to prevent instantiation
+    AllocTracker() {}
+};
+
+#endif // ALLOC_TRACKER_H
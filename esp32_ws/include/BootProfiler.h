@@ -0,0 +1,84 @@
+/**
+ * @file BootProfiler.h
+ * @brief Timing of the phases of setup()
+ *
+ * main.cpp opens a BootProfiler::Phase around every step of setup() and
+ * DeviceManager adds one per device it sets up, nested under the phase
+ * that is open at the time. BootProfiler::finish() closes the boot; phases
+ * opened after that (devices added at runtime) are not recorded.
+ *
+ * Times are in microseconds since the application started, so the first
+ * phase also shows how long the bootloader and Arduino core took.
+ */
+
+#ifndef BOOT_PROFILER_H
+#define BOOT_PROFILER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class BootProfiler
+{
+public:
+    static constexpr uint8_t MAX_PHASES = 48;
+
+    struct PhaseRecord
+    {
+        const char *name = nullptr;
+        String detail; // e.g. the device id
+        uint8_t depth = 0;
+        uint32_t startUs = 0;
+        uint32_t durationUs = 0;
+    };
+
+    /**
+     * @class Phase
+     * @brief RAII bracket that records one step of the boot
+     */
+    class Phase
+    {
+    public:
+        explicit Phase(const char *name, const String &detail = String());
+        ~Phase();
+
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+    private:
+        int _index;
+    };
+
+    /**
+     * @brief Mark the end of setup(); records the total boot time
+     */
+    static void finish();
+
+    static bool isFinished() { return finished; }
+    static uint8_t getPhaseCount() { return phaseCount; }
+    static const PhaseRecord &getPhase(uint8_t index) { return phases[index]; }
+    static uint32_t getTotalUs() { return totalUs; }
+    static uint32_t getDroppedCount() { return droppedCount; }
+
+    /**
+     * @brief Why the chip started, e.g. "brownout", "power-on", "panic"
+     */
+    static const char *getResetReason();
+
+    /**
+     * @brief Write {resetReason, totalUs, phases[]} into obj
+     */
+    static void toJson(JsonObject obj);
+
+private:
+    static PhaseRecord phases[MAX_PHASES];
+    static uint8_t phaseCount;
+    static uint8_t depth;
+    static uint32_t totalUs;
+    static uint32_t droppedCount;
+    static bool finished;
+
+    // Private constructor to prevent instantiation
+    BootProfiler() {}
+};
+
+#endif // BOOT_PROFILER_H
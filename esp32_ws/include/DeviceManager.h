@@ -14,15 +14,17 @@ using HasClients = std::function<bool()>;
 
 class DeviceManager
 {
+public:
+    static const int MAX_DEVICES = 30;
 
 private:
-    static const int MAX_DEVICES = 30;
     Device *devices[MAX_DEVICES];
     int devicesCount;
 
     NotifyClients notifyClients;
     HasClients hasClients;
     std::function<void()> onDevicesChanged;
+    uint32_t devicesVersion = 0;
 
 public:
     NetworkSettings loadNetworkSettings();
@@ -40,6 +42,11 @@ public:
 
     Device *getDeviceById(const String &deviceId) const;
 
+    /**
+     * @brief The root device whose tree holds deviceId (the device itself for a root), or nullptr
+     */
+    Device *getRootDeviceOf(const String &deviceId) const;
+
     template <typename T>
     T *getDeviceByIdAs(const String &deviceId) const
     {
@@ -50,7 +57,17 @@ public:
 
     void setOnDevicesChanged(std::function<void()> callback) { onDevicesChanged = callback; }
     void setHasClients(HasClients callback) { hasClients = callback; }
-    void notifyDevicesChanged() { if (onDevicesChanged) onDevicesChanged(); }
+    void notifyDevicesChanged()
+    {
+        devicesVersion++;
+        if (onDevicesChanged)
+            onDevicesChanged();
+    }
+
+    /**
+     * @brief Bumped when devices are added, removed, reordered or their config is saved; caches of the device tree compare it
+     */
+    uint32_t getDevicesVersion() const { return devicesVersion; }
 
     bool addDevice(Device *device);
     bool removeDevice(const String &deviceId);
@@ -67,10 +84,35 @@ public:
 
     void getDevices(Device **deviceList, int &count, int maxResults);
 
+    /**
+     * @brief Call fn(Device *) for every root device, in order
+     */
+    template <typename F>
+    void forEachRootDevice(F &&fn) const
+    {
+        for (int i = 0; i < devicesCount; i++)
+        {
+            if (devices[i] != nullptr)
+            {
+                fn(devices[i]);
+            }
+        }
+    }
+
     void setup();
     void teardown();
     void loop();
 
+    /**
+     * @brief Set up one device, recording the heap it keeps as the setup part of its heap usage
+     */
+    void setupDevice(Device *device);
+
+    /**
+     * @brief Clear loop timing of all devices and of the main loop
+     */
+    void resetLoopStats();
+
     int getDeviceCount() const { return devicesCount; }
 
     std::vector<Device*> getAllDevices();
@@ -0,0 +1,80 @@
+/**
+ * @file LoopStats.h
+ * @brief Timing statistics for loop() iterations
+ *
+ * LoopStats keeps min/avg/max and a log2 histogram of durations in
+ * microseconds; percentiles are read from the histogram (upper bound of
+ * the bucket, clamped to the observed maximum). Every Device owns two
+ * instances (including and excluding its children), LoopProfiler holds
+ * the ones for the Arduino main loop.
+ *
+ * Stats are written from the main loop task and read from WebSocket and
+ * serial handlers without locking; a report may mix two iterations.
+ */
+
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class LoopStats
+{
+public:
+    // Bucket i holds durations below 2^i us; the last bucket takes everything from ~16 ms up
+    static constexpr uint8_t BUCKET_COUNT = 16;
+
+    void record(uint32_t durationUs);
+    void reset();
+
+    uint32_t getCount() const { return _count; }
+    uint32_t getMin() const { return _count ? _min : 0; }
+    uint32_t getMax() const { return _max; }
+    uint32_t getAverage() const { return _count ? static_cast<uint32_t>(_total / _count) : 0; }
+    uint32_t getPercentile(uint8_t percent) const;
+
+    /**
+     * @brief Write {count, min, avg, max, p99} (microseconds) into obj
+     */
+    void toJson(JsonObject obj) const;
+
+private:
+    uint32_t _count = 0;
+    uint32_t _min = UINT32_MAX;
+    uint32_t _max = 0;
+    uint64_t _total = 0;
+    uint32_t _buckets[BUCKET_COUNT] = {};
+};
+
+/**
+ * @class LoopProfiler
+ * @brief Main loop period and duration, recorded by main.cpp
+ */
+class LoopProfiler
+{
+public:
+    /**
+     * @brief Call at the start of loop(); records the period since the previous start
+     */
+    static void beginMainLoop();
+
+    /**
+     * @brief Call at the end of loop(); records the time spent in this iteration
+     */
+    static void endMainLoop();
+
+    static const LoopStats &getMainLoopPeriod() { return mainLoopPeriod; }
+    static const LoopStats &getMainLoopDuration() { return mainLoopDuration; }
+    static void reset();
+
+private:
+    static LoopStats mainLoopPeriod;
+    static LoopStats mainLoopDuration;
+    static uint32_t loopStartUs;
+    static bool hasPreviousStart;
+
+    // Private constructor to prevent instantiation
+    LoopProfiler() {}
+};
+
+#endif // LOOP_STATS_H
@@ -102,10 +102,9 @@ public:
     IPAddress getIPAddress() const;
 
     /**
-     * @brief Get network status as JSON
-     * @return JSON string with network status information
+     * @brief Write network status (mode, connected, ssid, ip, rssi/clients) into obj
      */
-    String getStatusJSON() const;
+    void addStatusToJson(JsonObject obj) const;
 
     /**
      * @brief Process captive portal (call in main loop when in AP mode)
@@ -17,6 +17,11 @@ public:
 
     void loop();
 
+    /**
+     * @brief Print the time spent in each phase of setup()
+     */
+    void logBootStats();
+
 private:
     DeviceManager &m_deviceManager;
     Network *&m_network;
@@ -69,6 +74,8 @@ private:
     unsigned long m_lastToggleTime = 0;
 
     void logNetworkInfo();
+    void logLoopStats();
+    void logAllocStats();
     void handleInteractiveInput(char incoming);
     void handleCommand(const String &input);
     void handleSelectingNetworkInput(char incoming);
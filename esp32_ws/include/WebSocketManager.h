@@ -10,67 +10,350 @@
 class Device;
 class DeviceManager;
 #include "Network.h"
+#include "WsHistory.h"
+#include "WsMessageRegistry.h"
 
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <map>
+#include <set>
 #include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// Task that runs inbound commands; override with build flags. The main loop runs at priority 1 on core 1
+#ifndef WS_COMMAND_TASK_PRIORITY
+#define WS_COMMAND_TASK_PRIORITY 2
+#endif
+#ifndef WS_COMMAND_TASK_CORE
+#define WS_COMMAND_TASK_CORE 1
+#endif
+
+// Bytes of recent broadcasts kept for clients that resume after a reconnect (in PSRAM when available)
+#ifndef WS_HISTORY_BYTES
+#define WS_HISTORY_BYTES (64 * 1024)
+#endif
 
 class WebSocketManager
 {
+public:
+    /**
+     * @brief Messages discarded by notifyClients()/endBatch() and the command queue, as read by getDropStats()
+     */
+    struct DropStats
+    {
+        uint32_t batchQueueFull = 0; // Batch already held kMaxQueuedBatchMessages
+        uint32_t sendBufferFull = 0; // Frames dropped from a client's outbound queue, summed over clients
+        uint32_t commandQueueFull = 0; // Inbound messages refused because the command queue was full
+    };
+
+    /**
+     * @brief Holds inbound commands back while open
+     *
+     * The main loop keeps one open for a whole iteration, so handlers run
+     * between iterations and never during deviceManager.loop().
+     */
+    class CommandPause
+    {
+    public:
+        explicit CommandPause(WebSocketManager &manager);
+        ~CommandPause();
+
+        CommandPause(const CommandPause &) = delete;
+        CommandPause &operator=(const CommandPause &) = delete;
+
+    private:
+        WebSocketManager &_manager;
+    };
+
+    /**
+     * @brief Frames one client lost because its outbound queue was full
+     */
+    struct ClientDropStats
+    {
+        uint32_t responses = 0;
+        uint32_t states = 0;
+        uint32_t telemetry = 0;
+        uint32_t telemetrySuperseded = 0; // Replaced by a newer sample of the same device; not a loss
+    };
+
+    /**
+     * @brief Importance of an outgoing frame when a client cannot keep up
+     *
+     * Responses and device state are sent in order and never evicted;
+     * telemetry waits behind them and is the first to go when the queue is full.
+     */
+    enum class Priority : uint8_t
+    {
+        Telemetry,
+        State,
+        Response
+    };
+
+    /**
+     * @brief Wire format of outgoing frames, chosen per client with a set-encoding message
+     *
+     * MessagePack clients get the same arrays of messages as WS_BINARY frames.
+     * Inbound messages are always JSON text.
+     */
+    enum class Encoding : uint8_t
+    {
+        Json,
+        MsgPack
+    };
+
 private:
     AsyncWebSocket ws;
     DeviceManager *deviceManager;
     Network *network;
     bool scanInProgress = false;
-    std::map<uint32_t, String> messageBuffers;
+    std::vector<WsRequest> scanRequests; // Requests answered when the running WiFi scan completes
     
+    struct QueuedMessage
+    {
+        String json;
+        std::vector<uint8_t> msgpack; // Only encoded while a MessagePack client is connected
+        String deviceId;              // Set on device-state changes, which go to subscribed clients only
+        String deviceType;
+        Priority priority = Priority::Response;
+    };
+
+    /**
+     * @brief Encoded frame waiting for a client whose socket queue is full
+     */
+    struct OutgoingFrame
+    {
+        std::shared_ptr<const std::vector<uint8_t>> data; // Shared by every client that gets the same frame
+        bool binary = false;
+        Priority priority = Priority::Response;
+        String telemetryDeviceId; // Sample of this device; a newer sample replaces it while queued
+    };
+
+    /**
+     * @brief Telemetry samples of one device for one client, sent every periodMs
+     */
+    struct TelemetryStream
+    {
+        uint32_t periodMs = 0;
+        uint32_t nextMs = 0;
+        String lastSample; // Unchanged samples (device at rest) are not sent again
+    };
+
+    /**
+     * @brief Per-client state: wire format, device-state subscriptions, telemetry streams
+     * and the inbound message being reassembled
+     *
+     * A new client gets the device snapshot, or the messages it missed if
+     * it resumes, first and every broadcast after it. After its first
+     * subscribe it only gets device-state changes of the listed device ids
+     * and types.
+     */
+    struct ClientInfo
+    {
+        Encoding encoding = Encoding::Json;
+        bool awaitingSnapshot = false; // Connected; broadcasts are held back until the snapshot is sent
+        bool snapshotDue = false;      // Sent a first message, or waited kSnapshotWaitMs for it
+        uint32_t connectedMs = 0;
+        bool resume = false; // Asked for the broadcasts after resumeSeq instead of the snapshot
+        uint32_t resumeSeq = 0;
+        bool filtered = false;
+        std::set<String> deviceIds;
+        std::set<String> deviceTypes;
+        std::map<String, TelemetryStream> telemetry; // By device id
+
+        // Frames the socket could not take yet; bounded by kMaxOutboxFrames/kMaxOutboxBytes
+        std::deque<OutgoingFrame> outbox;
+        size_t outboxBytes = 0;
+        ClientDropStats drops;
+
+        // Fragments of the inbound text message in progress, NUL terminated once complete
+        std::vector<char> inbox;
+        bool inboxDiscarding = false; // Message exceeds kMaxMessageBytes; skip its remaining fragments
+
+        bool wants(const QueuedMessage &message) const;
+    };
+
     // Message batching - collects messages during loop
-    std::vector<String> messageQueue;
+    std::vector<QueuedMessage> messageQueue;
     bool batchingActive = false;
+    // Drop counters; commandQueueFull is counted on the async_tcp task, the others on the main loop
+    std::atomic<uint32_t> batchQueueFullCount{0};
+    std::atomic<uint32_t> sendBufferFullCount{0};
+    std::atomic<uint32_t> commandQueueFullCount{0};
+
+    // Every connected client; guarded by clientsMutex (events arrive on the async_tcp task)
+    std::map<uint32_t, ClientInfo> clients;
+    SemaphoreHandle_t clientsMutex = nullptr;
+    std::atomic<uint32_t> msgpackClientCount{0};
+    std::atomic<uint32_t> filteredClientCount{0};
+    std::atomic<uint32_t> awaitingClientCount{0}; // Held back until sendSnapshots() serves them
+    std::atomic<uint32_t> telemetryStreamCount{0};
+    std::atomic<uint32_t> queuedFrameCount{0}; // Frames in all outboxes
+
+    /**
+     * @brief devices-list, device-config and device-state of every device as one JSON frame
+     *
+     * Built on the main loop when a client connects and reused until the
+     * device tree (DeviceManager::getDevicesVersion()) or a state version changes.
+     */
+    struct Snapshot
+    {
+        std::shared_ptr<const std::vector<uint8_t>> json;
+        std::shared_ptr<const std::vector<uint8_t>> msgpack; // Only for clients that switched encoding before it was sent
+        uint32_t devicesVersion = 0;
+        uint32_t stateVersions = 0; // Sum of every device's state version
+        uint32_t builds = 0;
+        uint32_t sent = 0;
+    };
+    Snapshot snapshot;
+    std::atomic<bool> snapshotPending{false}; // A client is waiting for the snapshot
+    uint32_t sumStateVersions();
+    void buildSnapshot();
+    void sendSnapshots();
+    OutgoingFrame makeSyncFrame(Encoding encoding, bool resumed) const;
+
+    // Broadcasts by seq for resuming clients; epoch tells a resume across a reboot apart
+    WsHistory history{WS_HISTORY_BYTES};
+    uint32_t epoch = 0;
+    uint32_t resumes = 0;
+    uint32_t resumesRefused = 0; // Fell back to the snapshot
+    void stampMessages(std::vector<QueuedMessage> &messages);
+    void releaseSnapshot(uint32_t clientId);
+    void handleResume(const WsRequest &request, JsonDocument &doc);
+
+    bool hasMsgPackClients() const { return msgpackClientCount > 0; }
+    bool hasFilteredClients() const { return filteredClientCount > 0; }
+    void updateClientCounts(); // Call with clientsMutex held
+    void queueOrSend(QueuedMessage &&message);
+    void sendMessages(std::vector<QueuedMessage> &messages);
+    static size_t writeJsonFrame(const std::vector<QueuedMessage> &messages, const ClientInfo *client, char *out);
+    static size_t writeMsgPackFrame(const std::vector<QueuedMessage> &messages, const ClientInfo *client, std::vector<uint8_t> &out);
+    static Priority framePriority(const std::vector<QueuedMessage> &messages, const ClientInfo *client);
+    void sendToClient(uint32_t clientId, const JsonDocument &doc);
+    void sendToClient(uint32_t clientId, const char *json, size_t length);
+
+    /**
+     * @brief Answer a request: to the requesting client only, tagged with its requestId
+     */
+    void reply(const WsRequest &request, JsonDocument &response);
+    void reply(const WsRequest &request, JsonDocument &&response) { reply(request, response); }
+
+    /**
+     * @brief Send a change a request caused to every client, tagged with the requestId
+     *
+     * A requester still waiting for its snapshot, which broadcasts skip, is sent it directly.
+     */
+    void broadcast(const WsRequest &request, JsonDocument &response);
+
+    // Per-client outbound queues; call with clientsMutex held
+    static OutgoingFrame encodeFrame(const JsonDocument &frame, Encoding encoding, Priority priority);
+    void enqueueFrame(uint32_t clientId, ClientInfo &client, OutgoingFrame &&frame);
+    void writeFrame(uint32_t clientId, const OutgoingFrame &frame);
+    void dropFrame(ClientInfo &client, Priority priority);
+    void drainOutboxes();
+    void handleGetClientStats(const WsRequest &request, JsonDocument &doc);
+
+    // Reassembles fragmented text messages per client and queues them for the command task
+    void receiveData(AsyncWebSocketClient *client, const AwsFrameInfo &info, uint8_t *data, size_t len);
+
+    /**
+     * @brief Complete inbound message; the command task owns and deletes it
+     */
+    struct Command
+    {
+        uint32_t clientId;
+        std::vector<char> *message; // NUL terminated
+    };
+
+    QueueHandle_t commandQueue = nullptr;
+    SemaphoreHandle_t commandMutex = nullptr; // Held by the command task per command and by CommandPause
+    std::atomic<bool> commandWaiting{false};  // Command task is blocked on commandMutex
+    void queueCommand(uint32_t clientId, std::vector<char> *message);
+    static void commandTask(void *arg);
+
+    void handleSetEncoding(const WsRequest &request, JsonDocument &doc);
+    void handleSubscribe(const WsRequest &request, JsonDocument &doc);
+    void handleUnsubscribe(const WsRequest &request, JsonDocument &doc);
+    void updateSubscription(const WsRequest &request, JsonDocument &doc, bool subscribe);
+    void handleTelemetry(const WsRequest &request, JsonDocument &doc);
+    void sendTelemetry();
+
+    // Devices whose state changed while batching, in order of first change; serialized once in endBatch()
+    std::vector<String> dirtyStates;
+    bool deferStateChange(const String &deviceId);
+    void flushDirtyStates();
+    bool buildStateChange(const String &deviceId, QueuedMessage &message);
+    QueuedMessage makeDeviceMessage(const JsonDocument &doc, const String &deviceId);
 
     // Helper methods for cleaner message handling
-    void handleRestart();
-    void handleDeviceFunction(JsonDocument &doc);
-    void handleDeviceState(JsonDocument &doc);
-    void handleDeviceGetState(JsonDocument &doc);
-    void handleGetDevices(JsonDocument &doc);
-    void serializeDeviceToJson(Device *device, JsonObject deviceObj);
+    void handleRestart(const WsRequest &request);
+    void handleDeviceFunction(const WsRequest &request, JsonDocument &doc);
+    void handleDeviceState(const WsRequest &request, JsonDocument &doc);
+    void handleDeviceGetState(const WsRequest &request, JsonDocument &doc);
+    void handleGetDevices(const WsRequest &request, JsonDocument &doc);
+    void writeDevicesList(Print &out, const String &requestId);
+    size_t devicesListReserve = 0; // Largest devices-list written so far; reserved so the next is written in one go
+    void writeDeviceJson(Device *device, Print &out);
+
+    // Adds the built-in message types to WsMessageRegistry
+    void registerHandlers();
 
 public:
     WebSocketManager(DeviceManager *deviceManager, Network *network, const char *path = "/ws");
     void setup(AsyncWebServer &server);
     void loop();
-    void notifyClients(String state);
+    void notifyClients(const String &state);
+
+    /**
+     * @brief Send a reply document; serialized once, straight into the batch or the socket buffer
+     */
+    void notifyClients(const JsonDocument &doc);
     void beginBatch();
     void endBatch();
     String getStatus() const;
     uint32_t getClientCount() const;
     bool hasClients() const { return ws.count() > 0; }
+    /**
+     * @brief Whether a connected client has not been sent its snapshot or missed broadcasts yet; broadcasts skip it until then
+     */
+    bool hasAwaitingClients() const { return awaitingClientCount > 0; }
+    DropStats getDropStats() const;
+    Encoding getClientEncoding(uint32_t clientId);
+    ClientDropStats getClientDropStats(uint32_t clientId);
     void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
     void setDeviceManager(DeviceManager *deviceManager);
     void setNetwork(Network *network);
 
-    // Made public to allow global function access
-    void parseMessage(String message);
+    // Made public to allow global function access; dispatches through WsMessageRegistry
+    void parseMessage(const char *message, size_t length, uint32_t clientId = 0);
 
     // Device config handlers
-    void handleDeviceSaveConfig(JsonDocument &doc);
-    void handleDeviceReadConfig(JsonDocument &doc);
-    void handleSetDevicesConfig(JsonDocument &doc);
-    void handleGetDevicesConfig(JsonDocument &doc);
+    void handleDeviceSaveConfig(const WsRequest &request, JsonDocument &doc);
+    void handleDeviceReadConfig(const WsRequest &request, JsonDocument &doc);
+    void handleSetDevicesConfig(const WsRequest &request, JsonDocument &doc);
+    void handleGetDevicesConfig(const WsRequest &request, JsonDocument &doc);
 
     // Device management handlers
-    void handleAddDevice(JsonDocument &doc);
-    void handleRemoveDevice(JsonDocument &doc);
-    void handleReorderDevices(JsonDocument &doc);
+    void handleAddDevice(const WsRequest &request, JsonDocument &doc);
+    void handleRemoveDevice(const WsRequest &request, JsonDocument &doc);
+    void handleReorderDevices(const WsRequest &request, JsonDocument &doc);
 
     // Network config handlers
-    void handleGetNetworkConfig(JsonDocument &doc);
-    void handleSetNetworkConfig(JsonDocument &doc);
-    void handleGetNetworks(JsonDocument &doc);
-    void handleGetNetworkStatus(JsonDocument &doc);
+    void handleGetNetworkConfig(const WsRequest &request, JsonDocument &doc);
+    void handleSetNetworkConfig(const WsRequest &request, JsonDocument &doc);
+    void handleGetNetworks(const WsRequest &request, JsonDocument &doc);
+    void handleGetNetworkStatus(const WsRequest &request, JsonDocument &doc);
 
     // I2C handlers
-    void handleGetExpanderAddresses(JsonDocument &doc);
+    void handleGetExpanderAddresses(const WsRequest &request, JsonDocument &doc);
+
+    // Diagnostics handlers
+    void handleGetLoopStats(const WsRequest &request, JsonDocument &doc);
+    void handleGetAllocStats(const WsRequest &request, JsonDocument &doc);
+    void handleGetBootStats(const WsRequest &request, JsonDocument &doc);
 };
 
 #endif
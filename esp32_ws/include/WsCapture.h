@@ -0,0 +1,78 @@
+/**
+ * @file WsCapture.h
+ * @brief Recording of inbound WebSocket traffic for replay
+ *
+ * While a capture is active, WebSocketManager::onEvent() records client
+ * connects, disconnects and every complete inbound text message (after
+ * reassembly of fragmented frames) with the client id and the time since
+ * the capture started. Records are queued from the async_tcp task and
+ * appended to a LittleFS file by WsCapture::loop() on the main loop, one
+ * JSON object per line:
+ *
+ *   {"t":1234,"client":3,"event":"message","data":"{\"type\":\"devices-list\"}"}
+ *
+ * The file can be downloaded from the LittleFS browser of the website host
+ * and fed to the native replay tool (src/native/replay).
+ */
+
+#ifndef WS_CAPTURE_H
+#define WS_CAPTURE_H
+
+#include <Arduino.h>
+
+class WsCapture
+{
+public:
+    enum class Event : uint8_t
+    {
+        Connect,
+        Disconnect,
+        Message
+    };
+
+    static constexpr const char *DEFAULT_PATH = "/ws-capture.jsonl";
+
+    // Records waiting for the main loop; more are counted as dropped
+    static constexpr size_t MAX_PENDING_RECORDS = 128;
+
+    /**
+     * @brief Start a new capture, truncating the file
+     * @return false if the file cannot be created
+     */
+    static bool start(const String &path = DEFAULT_PATH);
+
+    /**
+     * @brief Stop capturing and write the pending records
+     */
+    static void stop();
+
+    static bool isActive();
+
+    /**
+     * @brief Queue a record; no-op when no capture is active
+     */
+    static void record(uint32_t clientId, Event event, const String &message = "");
+
+    /**
+     * @brief Append pending records to the capture file; call from the main loop
+     */
+    static void loop();
+
+    static const String &getPath() { return path; }
+    static uint32_t getRecordedCount() { return recordedCount; }
+    static uint32_t getDroppedCount() { return droppedCount; }
+
+    static const char *getEventName(Event event);
+
+private:
+    WsCapture() = delete;
+
+    static void flush();
+
+    static String path;
+    static unsigned long startMs;
+    static uint32_t recordedCount;
+    static uint32_t droppedCount;
+};
+
+#endif // WS_CAPTURE_H
@@ -0,0 +1,102 @@
+/**
+ * @file WsHistory.h
+ * @brief Recent broadcast messages by sequence number, for clients that reconnect
+ *
+ * WebSocketManager numbers every message it broadcasts ("seq") and appends
+ * it here. A client that reconnects and sends a resume message with the
+ * last seq it got is sent the messages after it from here instead of the
+ * full device snapshot.
+ *
+ * Messages are stored back to back in one ring buffer, in PSRAM when the
+ * board has it; the oldest are evicted to make room. A seq that was taken
+ * but never appended (a broadcast nobody was connected for) leaves a hole,
+ * and resuming across a hole or an evicted message is refused.
+ */
+
+#ifndef WS_HISTORY_H
+#define WS_HISTORY_H
+
+#include <Arduino.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class WsHistory
+{
+public:
+    // {"seq": and up to 10 digits, plus the NUL
+    static constexpr size_t kSeqPrefixSize = 18;
+
+    /**
+     * @brief Write {"seq":N, the start of a numbered message, into prefix
+     * @return The length written, without the NUL
+     */
+    static size_t formatSeqPrefix(char (&prefix)[kSeqPrefixSize], uint32_t seq);
+
+    explicit WsHistory(size_t capacity);
+    ~WsHistory();
+
+    WsHistory(const WsHistory &) = delete;
+    WsHistory &operator=(const WsHistory &) = delete;
+
+    /**
+     * @brief Allocate the buffer; call once the heap (and PSRAM) is up
+     * @return false if no memory; messages are then only numbered
+     */
+    bool begin();
+
+    /**
+     * @brief Number the next broadcast message
+     */
+    uint32_t takeSeq() { return ++lastSeq; }
+
+    /**
+     * @brief Take a seq for a broadcast nobody got; resuming across it is refused
+     */
+    void skip() { ++lastSeq; }
+
+    /**
+     * @brief Store a numbered message (JSON object text); evicts the oldest to make room
+     */
+    void append(uint32_t seq, const char *json, size_t length);
+
+    /**
+     * @brief Whether every message after seq is still held and they fit in maxLength bytes as a frame
+     */
+    bool canResume(uint32_t seq, size_t maxLength = SIZE_MAX) const;
+
+    /**
+     * @brief The messages after seq as a JSON array, e.g. [{"seq":8,...},{"seq":9,...}]
+     * @return false if one of them is no longer held or the frame would exceed maxLength
+     */
+    bool writeSince(uint32_t seq, std::vector<uint8_t> &out, size_t maxLength = SIZE_MAX) const;
+
+    uint32_t getLastSeq() const { return lastSeq; }
+    uint32_t getOldestSeq() const { return entries.empty() ? 0 : entries.front().seq; }
+    size_t getCapacity() const { return buffer ? capacity : 0; }
+    size_t getUsedBytes() const { return usedBytes; }
+    size_t getMessageCount() const { return entries.size(); }
+    bool isInPsram() const { return inPsram; }
+
+private:
+    struct Entry
+    {
+        uint32_t seq;
+        size_t offset; // Into buffer; the message may wrap around its end
+        size_t length;
+    };
+
+    void evictOldest();
+    std::deque<Entry>::const_iterator firstAfter(uint32_t seq) const;
+    size_t frameLength(std::deque<Entry>::const_iterator from) const;
+
+    uint8_t *buffer = nullptr;
+    size_t capacity;
+    bool inPsram = false;
+    size_t head = 0; // Where the next message goes
+    size_t usedBytes = 0;
+    uint32_t lastSeq = 0;
+    std::deque<Entry> entries; // Oldest first, ascending seq
+};
+
+#endif // WS_HISTORY_H
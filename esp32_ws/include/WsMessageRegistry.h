@@ -0,0 +1,80 @@
+/**
+ * @file WsMessageRegistry.h
+ * @brief Handlers for inbound WebSocket messages, keyed by message type
+ *
+ * WebSocketManager::parseMessage() looks the "type" field up here instead
+ * of comparing it against every known type. Types are keyed by their
+ * FNV-1a hash; the stored name is compared once on a hit to rule out a
+ * collision. WebSocketManager registers the built-in types, other
+ * subsystems (device types included) can add their own during setup().
+ *
+ * The map is not locked: WebSocketManager::setup() seals it before the
+ * command task starts, and from then on it is only read. find() returns a
+ * pointer into it, which stays valid because nothing is added or removed.
+ *
+ * Every handler gets the WsRequest it is answering: direct replies go to
+ * that client only and echo its requestId, state changes are broadcast.
+ */
+
+#ifndef WS_MESSAGE_REGISTRY_H
+#define WS_MESSAGE_REGISTRY_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <functional>
+
+/**
+ * @brief Sender of an inbound message
+ *
+ * clientId 0 means no WebSocket client asked (serial console, a refresh
+ * after a change); replies to it are broadcast.
+ */
+struct WsRequest
+{
+    uint32_t clientId = 0;
+    String requestId; // Echoed on replies when the client sent one
+};
+
+class WsMessageRegistry
+{
+public:
+    using Handler = std::function<void(const WsRequest &request, JsonDocument &doc)>;
+
+    /**
+     * @brief 32-bit FNV-1a hash of a message type
+     */
+    static constexpr uint32_t hash(const char *type)
+    {
+        uint32_t value = 2166136261u;
+        while (*type)
+        {
+            value = (value ^ static_cast<uint8_t>(*type++)) * 16777619u;
+        }
+        return value;
+    }
+
+    /**
+     * @brief Add or replace the handler for a message type; only before seal()
+     * @return false if the type's hash collides with another registered type, or the registry is sealed
+     */
+    static bool registerHandler(const char *type, Handler handler);
+    static void unregisterHandler(const char *type);
+
+    /**
+     * @brief Refuse any change from now on; called before messages are dispatched on another task
+     */
+    static void seal();
+
+    /**
+     * @brief Handler for a message type, nullptr if none is registered
+     */
+    static const Handler *find(const char *type);
+
+    static size_t getHandlerCount();
+
+private:
+    // Private constructor to prevent instantiation
+    WsMessageRegistry() {}
+};
+
+#endif // WS_MESSAGE_REGISTRY_H
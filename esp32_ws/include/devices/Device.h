@@ -16,6 +16,7 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <vector>
+#include "LoopStats.h"
 
 /**
  * @class Device
@@ -41,6 +42,14 @@ public:
     // Check if setup has been called
     bool isSetup() const { return _isInitialized; }
 
+    // Timed entry point used by parents and DeviceManager: runs loop() and records its duration
+    uint32_t runLoop();
+
+    // Loop timing, including and excluding children
+    const LoopStats &getLoopStats() const { return _loopStats; }
+    const LoopStats &getSelfLoopStats() const { return _selfLoopStats; }
+    void resetLoopStats();
+
     // Identity
     String getId() const { return _id; }
     String getType() const { return _type; }
@@ -59,6 +68,12 @@ public:
         return static_cast<T *>(getChildById(id));
     }
 
+    // Heap kept since creation and configuration, plus that of the latest setup (including children)
+    int32_t getHeapBytes() const { return _heapBytes + _setupHeapBytes; }
+    void addHeapBytes(int32_t bytes) { _heapBytes += bytes; }
+    // Replaces the previous setup's bytes; teardown() clears them
+    void setSetupHeapBytes(int32_t bytes) { _setupHeapBytes = bytes; }
+
     // Pins (for collision detection)
     virtual std::vector<String> getPins() const { return {}; }
 
@@ -74,6 +89,13 @@ protected:
     bool _isInitialized = false;
     std::vector<Device *> _children;
     std::vector<String> _mixins;
+
+private:
+    LoopStats _loopStats;
+    LoopStats _selfLoopStats;
+    uint32_t _childLoopUs = 0;
+    int32_t _heapBytes = 0;
+    int32_t _setupHeapBytes = 0;
 };
 
 #endif // DEVICE_H
@@ -84,6 +84,7 @@ namespace devices
         // ControllableMixin implementation
         void addStateToJson(JsonDocument &doc) override;
         bool control(const String &action, JsonObject *args = nullptr) override;
+        bool addTelemetryToJson(JsonObject obj) override;
 
         // SerializableMixin implementation
         void jsonToConfig(const JsonDocument &config) override;
@@ -147,6 +147,7 @@ namespace devices
         // ControllableMixin implementation
         void addStateToJson(JsonDocument &doc) override;
         bool control(const String &action, JsonObject *args = nullptr) override;
+        bool addTelemetryToJson(JsonObject obj) override;
 
         // SerializableMixin implementation
         void jsonToConfig(const JsonDocument &config) override;
@@ -175,6 +176,11 @@ namespace devices
          */
         void updateCurrentAngle();
 
+        /**
+         * @brief The angle the stepper is at now, -1 before the zero position is known
+         */
+        float computeCurrentAngle() const;
+
         void setErrorState(WheelErrorCode errorCode, const String &errorMessage);
 
         unsigned long _initStartTime = 0; // Start time for init operation
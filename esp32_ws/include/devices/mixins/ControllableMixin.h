@@ -4,6 +4,15 @@
  *
  * Requires the derived class to implement:
  * - void addStateToJson(JsonDocument &doc);
+ *
+ * State changes are sent as deltas: the mixin keeps the last state it
+ * sent and a version number, and a device-state message carries only the
+ * top-level keys that changed ("delta": true, removed keys in "removed").
+ * A client that sees a version gap asks for a snapshot with a device-state
+ * request: any pending change is first sent to every client, then only the
+ * requester gets the last sent state in full, a version all clients share.
+ * A client that connects gets the last sent state the same way, so the
+ * deltas that follow apply to it.
  */
 
 #ifndef CONTROLLABLE_MIXIN_H
@@ -13,8 +22,10 @@
 #include "IControllable.h"
 #include <functional>
 #include "Logging.h"
+#include "AllocTracker.h"
 
 using NotifyClients = std::function<void(const String &)>;
+using DeferStateChange = std::function<bool(const String &deviceId)>;
 
 /**
  * @class ControllableMixinBase
@@ -24,6 +35,8 @@ class ControllableMixinBase
 {
 protected:
     inline static NotifyClients s_globalNotifyClients;
+    inline static bool s_stateDeltas = true;
+    inline static DeferStateChange s_deferStateChange;
 
 public:
     /**
@@ -39,6 +52,27 @@ public:
     {
         return s_globalNotifyClients;
     }
+
+    /**
+     * @brief Send only changed keys on state changes (default) or the full state every time
+     */
+    static void setStateDeltas(bool enabled)
+    {
+        s_stateDeltas = enabled;
+    }
+
+    static bool getStateDeltas()
+    {
+        return s_stateDeltas;
+    }
+
+    /**
+     * @brief Hand state changes to WebSocketManager (batching, subscriptions); the callback returns true if it took the change
+     */
+    static void setDeferStateChange(DeferStateChange callback)
+    {
+        s_deferStateChange = callback;
+    }
 };
 
 /**
@@ -69,6 +103,83 @@ public:
     // Provide Device virtual override via mixin when combined
     virtual IControllable *getControllableInterface() { return this; }
 
+    uint32_t getStateVersion() const override { return _stateVersion; }
+
+    void addStateSnapshotToJson(JsonDocument &doc) override
+    {
+        JsonDocument stateDoc;
+        addStateToJson(stateDoc);
+        doc["version"] = ++_stateVersion;
+        doc["state"] = stateDoc;
+        _lastState = stateDoc;
+    }
+
+    bool addLastStateToJson(JsonDocument &doc) const override
+    {
+        if (_lastState.isNull())
+        {
+            return false;
+        }
+        doc["version"] = _stateVersion;
+        doc["state"] = _lastState;
+        return true;
+    }
+
+    bool addStateChangeToJson(JsonDocument &doc) override
+    {
+        auto *derived = static_cast<Derived *>(this);
+        JsonDocument stateDoc;
+        addStateToJson(stateDoc);
+
+        doc["type"] = "device-state";
+        doc["deviceId"] = derived->getId();
+        doc["success"] = true;
+
+        if (s_stateDeltas && !_lastState.isNull())
+        {
+            JsonObject last = _lastState.as<JsonObject>();
+            JsonObject changes = doc["state"].to<JsonObject>();
+            for (JsonPair kv : stateDoc.as<JsonObject>())
+            {
+                const char *key = kv.key().c_str();
+                if (!last.containsKey(key) || last[key] != kv.value())
+                {
+                    changes[key] = kv.value();
+                }
+            }
+
+            JsonArray removed;
+            for (JsonPair kv : last)
+            {
+                if (!stateDoc.containsKey(kv.key().c_str()))
+                {
+                    if (removed.isNull())
+                    {
+                        removed = doc["removed"].to<JsonArray>();
+                    }
+                    removed.add(kv.key().c_str());
+                }
+            }
+
+            // Nothing the clients do not have already
+            if (changes.size() == 0 && removed.isNull())
+            {
+                doc.clear();
+                return false;
+            }
+            doc["delta"] = true;
+        }
+        else
+        {
+            doc["state"] = stateDoc;
+        }
+        doc["version"] = ++_stateVersion;
+
+        // Keys and values were copied into doc, so the base can be replaced now
+        _lastState = stateDoc;
+        return true;
+    }
+
 protected:
     ControllableMixin()
     {
@@ -85,34 +196,39 @@ protected:
     }
 
 private:
+    JsonDocument _lastState; // Base for the next delta, null until the first broadcast
+    uint32_t _stateVersion = 0;
+
     /**
      * @brief Subscribe to state changes from StateMixin
      */
     void subscribeToStateChanges()
     {
         auto *derived = static_cast<Derived *>(this);
-        derived->onStateChange([this](void *state)
+        derived->onStateChange([this](void *)
                                { this->handleStateChange(); });
     }
 
     /**
      * @brief When state changes, automatically notify clients via WebSocket
+     *
+     * While a batch is open the change is only recorded; the batch owner calls
+     * addStateChangeToJson() once per device when it flushes.
      */
     void handleStateChange()
     {
+        auto *derived = static_cast<Derived *>(this);
+        if (s_deferStateChange && s_deferStateChange(derived->getId()))
+            return;
+
         NotifyClients callback = getNotifyClients();
         if (!callback)
             return;
 
-        auto *derived = static_cast<Derived *>(this);
+        AllocTracker::Scope allocScope(AllocSubsystem::StateChange);
         JsonDocument doc;
-        doc["type"] = "device-state";
-        doc["deviceId"] = derived->getId();
-        doc["success"] = true;
-
-        JsonDocument stateDoc;
-        addStateToJson(stateDoc);
-        doc["state"] = stateDoc;
+        if (!addStateChangeToJson(doc))
+            return;
 
         String message;
         serializeJson(doc, message);
@@ -10,6 +10,34 @@ public:
     virtual ~IControllable() = default;
     virtual void addStateToJson(JsonDocument &doc) = 0;
     virtual bool control(const String &action, JsonObject *args = nullptr) = 0;
+
+    /**
+     * @brief Version of the last state sent to clients; bumped by every device-state broadcast
+     */
+    virtual uint32_t getStateVersion() const = 0;
+
+    /**
+     * @brief Write the full state and a new version into doc and make it the base for later deltas
+     */
+    virtual void addStateSnapshotToJson(JsonDocument &doc) = 0;
+
+    /**
+     * @brief Write the state clients last got and its version into doc, without starting a new version
+     * @return false if no state has been sent yet
+     */
+    virtual bool addLastStateToJson(JsonDocument &doc) const = 0;
+
+    /**
+     * @brief Write a device-state message with the changes since the last broadcast into doc
+     * @return false (doc left empty) if nothing changed
+     */
+    virtual bool addStateChangeToJson(JsonDocument &doc) = 0;
+
+    /**
+     * @brief Write the continuously changing values (position, angle) sampled by telemetry streams into obj
+     * @return false if the device has nothing to stream
+     */
+    virtual bool addTelemetryToJson(JsonObject /*obj*/) { return false; }
 };
 
 namespace mixins {
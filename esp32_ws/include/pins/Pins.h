@@ -2,6 +2,7 @@
 #define PINS_H
 
 #include <ArduinoJson.h>
+#include <functional>
 #include "IPin.h"
 #include "GpioPin.h"
 #include "I2cExpanderPin.h"
@@ -27,12 +28,19 @@ struct PinConfig
 class PinFactory
 {
 public:
+    using PinCreator = std::function<pins::IPin *(const PinConfig &config)>;
+
     static void setup();
     static pins::IPin *createPin(const PinConfig &config);
     static PinConfig jsonToConfig(const JsonDocument &doc);
     static void configToJson(const PinConfig &config, JsonDocument &doc);
     // For backward compatibility, create from int
     static pins::IPin *createPin(int pinNumber);
+    // Replace pin creation for all configs (e.g. simulated pins on the host); nullptr restores the default
+    static void setPinCreator(PinCreator creator);
+
+private:
+    static PinCreator pinCreator;
 };
 
 #endif // PINS_H
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "Arduino.h"
+#include "NativeHal.h"
+#include "driver/mcpwm.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point gBootTime = Clock::now();
+    std::atomic<double> gTimeScale{1.0};
+
+    double elapsedMicros()
+    {
+        return std::chrono::duration<double, std::micro>(Clock::now() - gBootTime).count() * gTimeScale.load();
+    }
+
+    constexpr int kPinCount = 64;
+    constexpr int kLedcChannelCount = 16;
+
+    std::mutex gPinMutex;
+    int gPinLevel[kPinCount] = {};
+    uint8_t gPinMode[kPinCount] = {};
+    int gPinLedcChannel[kPinCount];
+    uint32_t gLedcFrequency[kLedcChannelCount] = {};
+    float gMcpwmDuty[MCPWM_UNIT_MAX][MCPWM_TIMER_MAX][MCPWM_OPR_MAX] = {};
+
+    std::mutex gSerialMutex;
+    std::deque<char> gSerialInput;
+
+    std::mutex gRandomMutex;
+    std::mt19937 gRandom(12345);
+
+    void (*gRestartHandler)() = nullptr;
+
+    struct PinTableInit
+    {
+        PinTableInit()
+        {
+            for (int &channel : gPinLedcChannel)
+                channel = -1;
+        }
+    } gPinTableInit;
+
+    bool validPin(uint8_t pin) { return pin < kPinCount; }
+}
+
+HardwareSerial Serial(0);
+EspClass ESP;
+
+// ----------------------------------------------------------------------------
+// Timing
+// ----------------------------------------------------------------------------
+
+unsigned long millis()
+{
+    return static_cast<unsigned long>(elapsedMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return static_cast<unsigned long>(elapsedMicros());
+}
+
+void delay(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    const auto realUs = static_cast<int64_t>(us / gTimeScale.load());
+    if (realUs > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(realUs));
+    }
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+// ----------------------------------------------------------------------------
+// GPIO / LEDC
+// ----------------------------------------------------------------------------
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (!validPin(pin))
+        return;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gPinMode[pin] = mode;
+    if (mode == INPUT_PULLUP)
+        gPinLevel[pin] = HIGH;
+    else if (mode == INPUT_PULLDOWN)
+        gPinLevel[pin] = LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if (!validPin(pin))
+        return;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gPinLevel[pin] = val ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin)
+{
+    if (!validPin(pin))
+        return LOW;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    return gPinLevel[pin];
+}
+
+uint16_t analogRead(uint8_t pin)
+{
+    return digitalRead(pin) ? 4095 : 0;
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+    digitalWrite(pin, value > 0 ? HIGH : LOW);
+}
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits)
+{
+    (void)resolutionBits;
+    if (channel >= kLedcChannelCount)
+        return 0;
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel)
+{
+    if (!validPin(pin))
+        return;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gPinLedcChannel[pin] = channel;
+}
+
+void ledcDetachPin(uint8_t pin)
+{
+    if (!validPin(pin))
+        return;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gPinLedcChannel[pin] = -1;
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty)
+{
+    (void)channel;
+    (void)duty;
+}
+
+uint32_t ledcWriteTone(uint8_t channel, uint32_t freq)
+{
+    if (channel >= kLedcChannelCount)
+        return 0;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gLedcFrequency[channel] = freq;
+    return freq;
+}
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t unit, mcpwm_io_signals_t signal, int gpio)
+{
+    (void)signal;
+    return (unit < MCPWM_UNIT_MAX && gpio >= 0 && gpio < kPinCount) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t mcpwm_init(mcpwm_unit_t unit, mcpwm_timer_t timer, const mcpwm_config_t *config)
+{
+    if (unit >= MCPWM_UNIT_MAX || timer >= MCPWM_TIMER_MAX || config == nullptr)
+        return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gMcpwmDuty[unit][timer][MCPWM_OPR_A] = config->cmpr_a;
+    gMcpwmDuty[unit][timer][MCPWM_OPR_B] = config->cmpr_b;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_set_duty(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_operator_t op, float duty)
+{
+    if (unit >= MCPWM_UNIT_MAX || timer >= MCPWM_TIMER_MAX || op >= MCPWM_OPR_MAX)
+        return ESP_ERR_INVALID_ARG;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    gMcpwmDuty[unit][timer][op] = duty;
+    return ESP_OK;
+}
+
+esp_err_t mcpwm_set_duty_type(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_operator_t op, mcpwm_duty_type_t dutyType)
+{
+    (void)dutyType;
+    return (unit < MCPWM_UNIT_MAX && timer < MCPWM_TIMER_MAX && op < MCPWM_OPR_MAX) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+float mcpwm_get_duty(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_operator_t op)
+{
+    if (unit >= MCPWM_UNIT_MAX || timer >= MCPWM_TIMER_MAX || op >= MCPWM_OPR_MAX)
+        return 0.0f;
+    std::lock_guard<std::mutex> lock(gPinMutex);
+    return gMcpwmDuty[unit][timer][op];
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Math
+// ----------------------------------------------------------------------------
+
+long random(long max)
+{
+    return max <= 0 ? 0 : random(0, max);
+}
+
+long random(long min, long max)
+{
+    if (min >= max)
+        return min;
+    std::lock_guard<std::mutex> lock(gRandomMutex);
+    std::uniform_int_distribution<long> dist(min, max - 1);
+    return dist(gRandom);
+}
+
+void randomSeed(unsigned long seed)
+{
+    if (seed == 0)
+        return;
+    std::lock_guard<std::mutex> lock(gRandomMutex);
+    gRandom.seed(static_cast<std::mt19937::result_type>(seed));
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+    const long inRange = inMax - inMin;
+    if (inRange == 0)
+        return outMin;
+    return (x - inMin) * (outMax - outMin) / inRange + outMin;
+}
+
+// ----------------------------------------------------------------------------
+// Print / Serial / ESP
+// ----------------------------------------------------------------------------
+
+size_t Print::printf(const char *format, ...)
+{
+    char stackBuf[256];
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    const int len = vsnprintf(stackBuf, sizeof(stackBuf), format, copy);
+    va_end(copy);
+
+    if (len < 0)
+    {
+        va_end(args);
+        return 0;
+    }
+
+    size_t written;
+    if (static_cast<size_t>(len) < sizeof(stackBuf))
+    {
+        written = write(reinterpret_cast<const uint8_t *>(stackBuf), static_cast<size_t>(len));
+    }
+    else
+    {
+        std::string heapBuf(static_cast<size_t>(len) + 1, '\0');
+        vsnprintf(&heapBuf[0], heapBuf.size(), format, args);
+        written = write(reinterpret_cast<const uint8_t *>(heapBuf.data()), static_cast<size_t>(len));
+    }
+    va_end(args);
+    return written;
+}
+
+int HardwareSerial::available()
+{
+    if (_uartNum != 0)
+        return 0;
+    std::lock_guard<std::mutex> lock(gSerialMutex);
+    return static_cast<int>(gSerialInput.size());
+}
+
+int HardwareSerial::read()
+{
+    if (_uartNum != 0)
+        return -1;
+    std::lock_guard<std::mutex> lock(gSerialMutex);
+    if (gSerialInput.empty())
+        return -1;
+    const char c = gSerialInput.front();
+    gSerialInput.pop_front();
+    return static_cast<unsigned char>(c);
+}
+
+int HardwareSerial::peek()
+{
+    if (_uartNum != 0)
+        return -1;
+    std::lock_guard<std::mutex> lock(gSerialMutex);
+    return gSerialInput.empty() ? -1 : static_cast<unsigned char>(gSerialInput.front());
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (_uartNum != 0)
+        return size;
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush()
+{
+    if (_uartNum == 0)
+        fflush(stdout);
+}
+
+void EspClass::restart()
+{
+    fflush(stdout);
+    if (gRestartHandler)
+    {
+        gRestartHandler();
+    }
+    std::exit(0);
+}
+
+// ----------------------------------------------------------------------------
+// Simulation controls
+// ----------------------------------------------------------------------------
+
+namespace nativehal
+{
+    void pushSerialInput(const String &data)
+    {
+        std::lock_guard<std::mutex> lock(gSerialMutex);
+        gSerialInput.insert(gSerialInput.end(), data.begin(), data.end());
+    }
+
+    void setPinLevel(uint8_t pin, int level)
+    {
+        if (!validPin(pin))
+            return;
+        std::lock_guard<std::mutex> lock(gPinMutex);
+        gPinLevel[pin] = level ? HIGH : LOW;
+    }
+
+    int getPinLevel(uint8_t pin)
+    {
+        return digitalRead(pin);
+    }
+
+    uint32_t getLedcFrequency(uint8_t channel)
+    {
+        if (channel >= kLedcChannelCount)
+            return 0;
+        std::lock_guard<std::mutex> lock(gPinMutex);
+        return gLedcFrequency[channel];
+    }
+
+    void setTimeScale(double scale)
+    {
+        gTimeScale = scale > 0 ? scale : 1.0;
+    }
+
+    double getTimeScale()
+    {
+        return gTimeScale.load();
+    }
+
+    void setRestartHandler(void (*handler)())
+    {
+        gRestartHandler = handler;
+    }
+}
@@ -0,0 +1,12 @@
+/**
+ * @file AsyncTCP.h
+ * @brief Host placeholder for AsyncTCP (networking is simulated in ESPAsyncWebServer.h)
+ */
+
+#ifndef NATIVE_HAL_ASYNCTCP_H
+#define NATIVE_HAL_ASYNCTCP_H
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+#endif // NATIVE_HAL_ASYNCTCP_H
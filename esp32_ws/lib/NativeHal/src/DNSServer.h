@@ -0,0 +1,26 @@
+/**
+ * @file DNSServer.h
+ * @brief Host implementation of the captive portal DNS server (no-op)
+ */
+
+#ifndef NATIVE_HAL_DNSSERVER_H
+#define NATIVE_HAL_DNSSERVER_H
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+class DNSServer
+{
+public:
+    bool start(const uint16_t port, const String &domainName, const IPAddress &resolvedIP)
+    {
+        (void)port;
+        (void)domainName;
+        (void)resolvedIP;
+        return true;
+    }
+    void processNextRequest() {}
+    void stop() {}
+};
+
+#endif // NATIVE_HAL_DNSSERVER_H
@@ -0,0 +1,62 @@
+/**
+ * @file DYPlayerArduino.h
+ * @brief Host implementation of the DY-SV/HV serial MP3 player driver
+ *
+ * Tracks "play" for a fixed simulated duration.
+ */
+
+#ifndef NATIVE_HAL_DYPLAYER_ARDUINO_H
+#define NATIVE_HAL_DYPLAYER_ARDUINO_H
+
+#include <Arduino.h>
+#include "HardwareSerial.h"
+
+namespace DY
+{
+    enum class PlayState : int8_t
+    {
+        Fail = -1,
+        Stopped = 0,
+        Playing = 1,
+        Paused = 2
+    };
+
+    class Player
+    {
+    public:
+        static constexpr unsigned long kSimulatedTrackMs = 3000;
+
+        Player() = default;
+        explicit Player(HardwareSerial *port) : _port(port) {}
+
+        void begin() {}
+        void play() { _playStartMs = millis(); _playing = true; }
+        void pause() { _playing = false; }
+        void stop() { _playing = false; }
+        void playSpecified(uint16_t number)
+        {
+            _track = number;
+            play();
+        }
+        void setVolume(uint8_t volume) { _volume = volume; }
+        uint8_t getVolume() const { return _volume; }
+        uint16_t getPlayingSound() const { return _playing ? _track : 0; }
+        PlayState checkPlayState()
+        {
+            if (_playing && millis() - _playStartMs >= kSimulatedTrackMs)
+            {
+                _playing = false;
+            }
+            return _playing ? PlayState::Playing : PlayState::Stopped;
+        }
+
+    private:
+        HardwareSerial *_port = nullptr;
+        uint16_t _track = 0;
+        uint8_t _volume = 20;
+        bool _playing = false;
+        unsigned long _playStartMs = 0;
+    };
+}
+
+#endif // NATIVE_HAL_DYPLAYER_ARDUINO_H
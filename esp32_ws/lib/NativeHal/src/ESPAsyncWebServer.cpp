@@ -0,0 +1,325 @@
+#include "ESPAsyncWebServer.h"
+
+#include <algorithm>
+#include <cstring>
+
+// ----------------------------------------------------------------------------
+// AsyncWebSocketClient
+// ----------------------------------------------------------------------------
+
+void AsyncWebSocketClient::close(uint16_t code, const char *message)
+{
+    (void)code;
+    (void)message;
+    _status = WS_DISCONNECTING;
+}
+
+void AsyncWebSocketClient::ping(const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+}
+
+void AsyncWebSocketClient::text(AsyncWebSocketMessageBuffer *buffer)
+{
+    if (!buffer)
+        return;
+    enqueue(String(reinterpret_cast<const char *>(buffer->get()), buffer->length()), false);
+    delete buffer;
+}
+
+void AsyncWebSocketClient::binary(AsyncWebSocketMessageBuffer *buffer)
+{
+    if (!buffer)
+        return;
+    enqueue(String(reinterpret_cast<const char *>(buffer->get()), buffer->length()), true);
+    delete buffer;
+}
+
+size_t AsyncWebSocketClient::queueLen() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queue.size();
+}
+
+bool AsyncWebSocketClient::queueIsFull() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _queue.size() >= _queueLimit || _status != WS_CONNECTED;
+}
+
+void AsyncWebSocketClient::setSink(Sink sink)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sink = std::move(sink);
+}
+
+void AsyncWebSocketClient::setQueueLimit(size_t limit)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queueLimit = limit;
+}
+
+std::vector<AsyncWebSocketClient::Message> AsyncWebSocketClient::drain(size_t maxMessages)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<Message> out;
+    while (!_queue.empty() && out.size() < maxMessages)
+    {
+        out.push_back(std::move(_queue.front()));
+        _queue.pop_front();
+    }
+    return out;
+}
+
+uint32_t AsyncWebSocketClient::sentCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _sent;
+}
+
+uint32_t AsyncWebSocketClient::droppedCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped;
+}
+
+void AsyncWebSocketClient::enqueue(const String &data, bool binary)
+{
+    Sink sink;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_status != WS_CONNECTED)
+        {
+            return;
+        }
+        if (!_sink && _queue.size() >= _queueLimit)
+        {
+            // Same policy as the real library: the message is discarded
+            _dropped++;
+            return;
+        }
+        _sent++;
+        if (!_sink)
+        {
+            _queue.push_back({data, binary});
+            return;
+        }
+        sink = _sink;
+    }
+    sink(this, data, binary);
+}
+
+// ----------------------------------------------------------------------------
+// AsyncWebSocket
+// ----------------------------------------------------------------------------
+
+std::vector<AsyncWebSocketClient *> AsyncWebSocket::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<AsyncWebSocketClient *> clients;
+    clients.reserve(_clients.size());
+    for (const auto &entry : _clients)
+    {
+        if (entry.second->status() == WS_CONNECTED)
+            clients.push_back(entry.second.get());
+    }
+    return clients;
+}
+
+size_t AsyncWebSocket::count() const
+{
+    return snapshot().size();
+}
+
+AsyncWebSocketClient *AsyncWebSocket::client(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _clients.find(id);
+    return (it != _clients.end() && it->second->status() == WS_CONNECTED) ? it->second.get() : nullptr;
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients)
+{
+    std::vector<uint32_t> toClose;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto &entry : _clients)
+        {
+            if (entry.second->status() == WS_DISCONNECTING)
+                toClose.push_back(entry.first);
+        }
+        size_t connected = _clients.size() - toClose.size();
+        for (const auto &entry : _clients)
+        {
+            if (connected <= maxClients)
+                break;
+            if (entry.second->status() == WS_CONNECTED)
+            {
+                toClose.push_back(entry.first);
+                connected--;
+            }
+        }
+    }
+    for (uint32_t id : toClose)
+    {
+        disconnect(id);
+    }
+}
+
+void AsyncWebSocket::close(uint32_t id, uint16_t code, const char *message)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (c)
+        c->close(code, message);
+}
+
+void AsyncWebSocket::closeAll(uint16_t code, const char *message)
+{
+    for (AsyncWebSocketClient *c : snapshot())
+        c->close(code, message);
+}
+
+bool AsyncWebSocket::availableForWriteAll()
+{
+    for (AsyncWebSocketClient *c : snapshot())
+    {
+        if (c->queueIsFull())
+            return false;
+    }
+    return true;
+}
+
+bool AsyncWebSocket::availableForWrite(uint32_t id)
+{
+    AsyncWebSocketClient *c = client(id);
+    return c == nullptr || !c->queueIsFull();
+}
+
+void AsyncWebSocket::text(uint32_t id, const char *message, size_t len)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (c)
+        c->text(message, len);
+}
+
+void AsyncWebSocket::textAll(const char *message, size_t len)
+{
+    for (AsyncWebSocketClient *c : snapshot())
+        c->text(message, len);
+}
+
+void AsyncWebSocket::textAll(AsyncWebSocketMessageBuffer *buffer)
+{
+    if (!buffer)
+        return;
+    textAll(reinterpret_cast<const char *>(buffer->get()), buffer->length());
+    delete buffer;
+}
+
+void AsyncWebSocket::binary(uint32_t id, const uint8_t *message, size_t len)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (c)
+        c->binary(message, len);
+}
+
+void AsyncWebSocket::binaryAll(const uint8_t *message, size_t len)
+{
+    for (AsyncWebSocketClient *c : snapshot())
+        c->binary(message, len);
+}
+
+void AsyncWebSocket::binaryAll(AsyncWebSocketMessageBuffer *buffer)
+{
+    if (!buffer)
+        return;
+    binaryAll(buffer->get(), buffer->length());
+    delete buffer;
+}
+
+AsyncWebSocketClient *AsyncWebSocket::connect(AsyncWebSocketClient::Sink sink, const IPAddress &remoteIP)
+{
+    AsyncWebSocketClient *c;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const uint32_t id = _nextId++;
+        auto inserted = _clients.emplace(id, std::unique_ptr<AsyncWebSocketClient>(new AsyncWebSocketClient(this, id, remoteIP)));
+        c = inserted.first->second.get();
+        c->_sink = std::move(sink);
+    }
+    dispatch(c, WS_EVT_CONNECT, nullptr, nullptr, 0);
+    return c;
+}
+
+void AsyncWebSocket::disconnect(uint32_t id)
+{
+    std::unique_ptr<AsyncWebSocketClient> removed;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _clients.find(id);
+        if (it == _clients.end())
+            return;
+        it->second->_status = WS_DISCONNECTED;
+        removed = std::move(it->second);
+        _clients.erase(it);
+    }
+    dispatch(removed.get(), WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+}
+
+void AsyncWebSocket::receive(uint32_t id, const String &message, size_t fragmentSize, bool binary)
+{
+    AsyncWebSocketClient *c = client(id);
+    if (!c)
+        return;
+
+    const size_t total = message.length();
+    if (fragmentSize == 0 || fragmentSize > total)
+        fragmentSize = total;
+
+    size_t index = 0;
+    uint32_t frameNum = 0;
+    do
+    {
+        const size_t len = std::min(fragmentSize, total - index);
+
+        AwsFrameInfo info = {};
+        info.message_opcode = binary ? WS_BINARY : WS_TEXT;
+        info.opcode = binary ? WS_BINARY : WS_TEXT;
+        info.num = frameNum;
+        info.index = index;
+        info.len = total;
+        info.final = (index + len) >= total;
+
+        // The real library hands over the receive buffer with one spare byte, which handlers use for a terminator
+        std::vector<uint8_t> frame(len + 1, 0);
+        memcpy(frame.data(), message.c_str() + index, len);
+        dispatch(c, WS_EVT_DATA, &info, frame.data(), len);
+
+        index += len;
+        frameNum++;
+    } while (index < total);
+}
+
+void AsyncWebSocket::dispatch(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    if (_eventHandler)
+    {
+        _eventHandler(this, client, type, arg, data, len);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// AsyncWebServer
+// ----------------------------------------------------------------------------
+
+AsyncWebSocket *AsyncWebServer::webSocket(const String &url)
+{
+    for (AsyncWebHandler *handler : _handlers)
+    {
+        auto *ws = dynamic_cast<AsyncWebSocket *>(handler);
+        if (ws && url == ws->url())
+            return ws;
+    }
+    return nullptr;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file ESPAsyncWebServer.h
+ * @brief Host implementation of the ESPAsyncWebServer WebSocket API
+ *
+ * No sockets are opened. Host code creates synthetic clients with
+ * AsyncWebSocket::connect() and injects frames with receive(); outgoing
+ * messages are either handed to a per-client sink or queued per client
+ * (bounded by WS_MAX_QUEUED_MESSAGES, like the real library) until drained.
+ */
+
+#ifndef NATIVE_HAL_ESPASYNCWEBSERVER_H
+#define NATIVE_HAL_ESPASYNCWEBSERVER_H
+
+#include <Arduino.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AsyncTCP.h"
+
+#ifndef WS_MAX_QUEUED_MESSAGES
+#define WS_MAX_QUEUED_MESSAGES 32
+#endif
+
+#ifndef DEFAULT_MAX_WS_CLIENTS
+#define DEFAULT_MAX_WS_CLIENTS 8
+#endif
+
+typedef enum
+{
+    WS_CONTINUATION,
+    WS_TEXT,
+    WS_BINARY,
+    WS_DISCONNECT = 0x08,
+    WS_PING,
+    WS_PONG
+} AwsFrameType;
+
+typedef enum
+{
+    WS_DISCONNECTED,
+    WS_CONNECTED,
+    WS_DISCONNECTING
+} AwsClientStatus;
+
+typedef enum
+{
+    WS_EVT_CONNECT,
+    WS_EVT_DISCONNECT,
+    WS_EVT_PONG,
+    WS_EVT_ERROR,
+    WS_EVT_DATA
+} AwsEventType;
+
+typedef struct
+{
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+} AwsFrameInfo;
+
+class AsyncWebSocket;
+
+class AsyncWebSocketMessageBuffer
+{
+public:
+    explicit AsyncWebSocketMessageBuffer(size_t size) : _data(size) {}
+    AsyncWebSocketMessageBuffer(const uint8_t *data, size_t size) : _data(data, data + size) {}
+    uint8_t *get() { return _data.data(); }
+    size_t length() const { return _data.size(); }
+
+private:
+    std::vector<uint8_t> _data;
+};
+
+class AsyncWebSocketClient
+{
+public:
+    struct Message
+    {
+        String data;
+        bool binary;
+    };
+    using Sink = std::function<void(AsyncWebSocketClient *client, const String &data, bool binary)>;
+
+    AsyncWebSocketClient(AsyncWebSocket *server, uint32_t id, const IPAddress &remoteIP)
+        : _server(server), _id(id), _remoteIP(remoteIP) {}
+
+    uint32_t id() const { return _id; }
+    IPAddress remoteIP() const { return _remoteIP; }
+    AwsClientStatus status() const { return _status; }
+    AsyncWebSocket *server() { return _server; }
+    void close(uint16_t code = 0, const char *message = nullptr);
+    void ping(const uint8_t *data = nullptr, size_t len = 0);
+
+    void text(const char *message, size_t len) { enqueue(String(message, len), false); }
+    void text(const char *message) { enqueue(String(message), false); }
+    void text(const String &message) { enqueue(message, false); }
+    void text(AsyncWebSocketMessageBuffer *buffer);
+    void binary(const uint8_t *message, size_t len) { enqueue(String(reinterpret_cast<const char *>(message), len), true); }
+    void binary(const char *message, size_t len) { enqueue(String(message, len), true); }
+    void binary(const String &message) { enqueue(message, true); }
+    void binary(AsyncWebSocketMessageBuffer *buffer);
+
+    size_t queueLen() const;
+    bool queueIsFull() const;
+    bool canSend() const { return !queueIsFull(); }
+
+    // Host-side controls
+    void setSink(Sink sink);
+    void setQueueLimit(size_t limit);
+    std::vector<Message> drain(size_t maxMessages = SIZE_MAX);
+    uint32_t sentCount() const;
+    uint32_t droppedCount() const;
+
+private:
+    friend class AsyncWebSocket;
+    void enqueue(const String &data, bool binary);
+
+    AsyncWebSocket *_server;
+    uint32_t _id;
+    IPAddress _remoteIP;
+    AwsClientStatus _status = WS_CONNECTED;
+
+    mutable std::mutex _mutex;
+    std::deque<Message> _queue;
+    size_t _queueLimit = WS_MAX_QUEUED_MESSAGES;
+    Sink _sink;
+    uint32_t _sent = 0;
+    uint32_t _dropped = 0;
+};
+
+typedef std::function<void(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)> AwsEventHandler;
+
+class AsyncWebHandler
+{
+public:
+    virtual ~AsyncWebHandler() = default;
+};
+
+class AsyncWebSocket : public AsyncWebHandler
+{
+public:
+    explicit AsyncWebSocket(const String &url) : _url(url) {}
+
+    const char *url() const { return _url.c_str(); }
+    void onEvent(AwsEventHandler handler) { _eventHandler = handler; }
+
+    size_t count() const;
+    AsyncWebSocketClient *client(uint32_t id);
+    bool hasClient(uint32_t id) { return client(id) != nullptr; }
+    void cleanupClients(uint16_t maxClients = DEFAULT_MAX_WS_CLIENTS);
+    void close(uint32_t id, uint16_t code = 0, const char *message = nullptr);
+    void closeAll(uint16_t code = 0, const char *message = nullptr);
+
+    bool availableForWriteAll();
+    bool availableForWrite(uint32_t id);
+
+    void text(uint32_t id, const char *message, size_t len);
+    void text(uint32_t id, const char *message) { text(id, message, strlen(message)); }
+    void text(uint32_t id, const String &message) { text(id, message.c_str(), message.length()); }
+    void textAll(const char *message, size_t len);
+    void textAll(const char *message) { textAll(message, strlen(message)); }
+    void textAll(const String &message) { textAll(message.c_str(), message.length()); }
+    void textAll(AsyncWebSocketMessageBuffer *buffer);
+    void binary(uint32_t id, const uint8_t *message, size_t len);
+    void binary(uint32_t id, const char *message, size_t len) { binary(id, reinterpret_cast<const uint8_t *>(message), len); }
+    void binary(uint32_t id, const String &message)
+    {
+        binary(id, reinterpret_cast<const uint8_t *>(message.c_str()), message.length());
+    }
+    void binaryAll(const uint8_t *message, size_t len);
+    void binaryAll(const String &message)
+    {
+        binaryAll(reinterpret_cast<const uint8_t *>(message.c_str()), message.length());
+    }
+    void binaryAll(AsyncWebSocketMessageBuffer *buffer);
+    AsyncWebSocketMessageBuffer *makeBuffer(size_t size = 0) { return new AsyncWebSocketMessageBuffer(size); }
+    AsyncWebSocketMessageBuffer *makeBuffer(const uint8_t *data, size_t size) { return new AsyncWebSocketMessageBuffer(data, size); }
+
+    // Host-side controls
+
+    /**
+     * @brief Open a synthetic client connection (fires WS_EVT_CONNECT)
+     *
+     * The sink, if given, is installed before the connect event so the
+     * welcome message is captured too.
+     */
+    AsyncWebSocketClient *connect(AsyncWebSocketClient::Sink sink = nullptr, const IPAddress &remoteIP = IPAddress(127, 0, 0, 1));
+
+    /**
+     * @brief Drop a synthetic client connection (fires WS_EVT_DISCONNECT)
+     */
+    void disconnect(uint32_t id);
+
+    /**
+     * @brief Deliver a message from a client, split into frames of fragmentSize bytes (0 = single frame)
+     */
+    void receive(uint32_t id, const String &message, size_t fragmentSize = 0, bool binary = false);
+
+private:
+    void dispatch(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
+    std::vector<AsyncWebSocketClient *> snapshot() const;
+
+    String _url;
+    AwsEventHandler _eventHandler;
+    mutable std::mutex _mutex;
+    std::map<uint32_t, std::unique_ptr<AsyncWebSocketClient>> _clients;
+    uint32_t _nextId = 1;
+};
+
+class AsyncWebServer
+{
+public:
+    explicit AsyncWebServer(uint16_t port) : _port(port) {}
+
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler)
+    {
+        _handlers.push_back(handler);
+        return *handler;
+    }
+    void begin() {}
+    void end() {}
+
+    /**
+     * @brief Host-side lookup of a registered WebSocket handler
+     */
+    AsyncWebSocket *webSocket(const String &url = "/ws");
+
+private:
+    uint16_t _port;
+    std::vector<AsyncWebHandler *> _handlers;
+};
+
+#endif // NATIVE_HAL_ESPASYNCWEBSERVER_H
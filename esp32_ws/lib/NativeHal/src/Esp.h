@@ -0,0 +1,36 @@
+/**
+ * @file Esp.h
+ * @brief Host implementation of the ESP32 chip information class
+ *
+ * Heap figures describe a simulated ESP32-S3 internal heap so that
+ * diagnostics code prints plausible values.
+ */
+
+#ifndef NATIVE_HAL_ESP_H
+#define NATIVE_HAL_ESP_H
+
+#include <cstdint>
+
+class EspClass
+{
+public:
+    uint32_t getHeapSize() { return 327680; }
+    uint32_t getFreeHeap() { return 262144; }
+    uint32_t getMinFreeHeap() { return 262144; }
+    uint32_t getMaxAllocHeap() { return 131072; }
+    uint32_t getPsramSize() { return 8 * 1024 * 1024; }
+    uint32_t getFreePsram() { return 8 * 1024 * 1024; }
+    uint32_t getMinFreePsram() { return 8 * 1024 * 1024; }
+    uint32_t getMaxAllocPsram() { return 4 * 1024 * 1024; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    const char *getChipModel() { return "ESP32-S3 (native)"; }
+    uint32_t getFlashChipSize() { return 16 * 1024 * 1024; }
+    uint32_t getSketchSize() { return 0; }
+    uint32_t getFreeSketchSpace() { return 0; }
+    uint64_t getEfuseMac() { return 0; }
+    [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
+
+#endif // NATIVE_HAL_ESP_H
@@ -0,0 +1,299 @@
+#include "FS.h"
+#include "LittleFS.h"
+#include "NativeHal.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+fs::LittleFSFS LittleFS;
+
+namespace
+{
+    std::mutex gRootMutex;
+    std::string gRoot;
+
+    std::string root()
+    {
+        std::lock_guard<std::mutex> lock(gRootMutex);
+        if (gRoot.empty())
+        {
+            const char *env = std::getenv("MARBLE_FS_ROOT");
+            gRoot = (env && *env) ? env : "native_fs";
+        }
+        return gRoot;
+    }
+
+    stdfs::path hostPath(const char *path)
+    {
+        std::string relative = path ? path : "";
+        while (!relative.empty() && relative.front() == '/')
+        {
+            relative.erase(relative.begin());
+        }
+        return stdfs::path(root()) / relative;
+    }
+}
+
+namespace fs
+{
+    class FileImpl
+    {
+    public:
+        std::string path;
+        std::string name;
+        stdfs::path host;
+        FILE *fp = nullptr;
+        bool directory = false;
+        std::vector<std::string> entries;
+        size_t nextEntry = 0;
+
+        ~FileImpl()
+        {
+            if (fp)
+                fclose(fp);
+        }
+    };
+
+    size_t File::write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+
+    size_t File::write(const uint8_t *buf, size_t size)
+    {
+        if (!_impl || !_impl->fp)
+            return 0;
+        return fwrite(buf, 1, size, _impl->fp);
+    }
+
+    int File::available()
+    {
+        if (!_impl || !_impl->fp)
+            return 0;
+        const long pos = ftell(_impl->fp);
+        return pos < 0 ? 0 : static_cast<int>(size() - static_cast<size_t>(pos));
+    }
+
+    int File::read()
+    {
+        if (!_impl || !_impl->fp)
+            return -1;
+        const int c = fgetc(_impl->fp);
+        return c == EOF ? -1 : c;
+    }
+
+    int File::peek()
+    {
+        if (!_impl || !_impl->fp)
+            return -1;
+        const int c = fgetc(_impl->fp);
+        if (c == EOF)
+            return -1;
+        ungetc(c, _impl->fp);
+        return c;
+    }
+
+    void File::flush()
+    {
+        if (_impl && _impl->fp)
+            fflush(_impl->fp);
+    }
+
+    size_t File::read(uint8_t *buf, size_t size)
+    {
+        if (!_impl || !_impl->fp)
+            return 0;
+        return fread(buf, 1, size, _impl->fp);
+    }
+
+    bool File::seek(uint32_t pos)
+    {
+        return _impl && _impl->fp && fseek(_impl->fp, static_cast<long>(pos), SEEK_SET) == 0;
+    }
+
+    size_t File::position() const
+    {
+        if (!_impl || !_impl->fp)
+            return 0;
+        const long pos = ftell(_impl->fp);
+        return pos < 0 ? 0 : static_cast<size_t>(pos);
+    }
+
+    size_t File::size() const
+    {
+        if (!_impl || _impl->directory)
+            return 0;
+        if (_impl->fp)
+            fflush(_impl->fp);
+        std::error_code ec;
+        const auto bytes = stdfs::file_size(_impl->host, ec);
+        return ec ? 0 : static_cast<size_t>(bytes);
+    }
+
+    void File::close()
+    {
+        _impl.reset();
+    }
+
+    File::operator bool() const
+    {
+        return _impl && (_impl->fp || _impl->directory);
+    }
+
+    time_t File::getLastWrite()
+    {
+        if (!_impl)
+            return 0;
+        std::error_code ec;
+        const auto ftime = stdfs::last_write_time(_impl->host, ec);
+        if (ec)
+            return 0;
+        const auto sys = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+            ftime - stdfs::file_time_type::clock::now() + std::chrono::system_clock::now());
+        return std::chrono::system_clock::to_time_t(sys);
+    }
+
+    const char *File::path() const
+    {
+        return _impl ? _impl->path.c_str() : nullptr;
+    }
+
+    const char *File::name() const
+    {
+        return _impl ? _impl->name.c_str() : nullptr;
+    }
+
+    bool File::isDirectory() const
+    {
+        return _impl && _impl->directory;
+    }
+
+    File File::openNextFile(const char *mode)
+    {
+        if (!_impl || !_impl->directory || _impl->nextEntry >= _impl->entries.size())
+            return File();
+        std::string child = _impl->path;
+        if (child.empty() || child.back() != '/')
+            child += '/';
+        child += _impl->entries[_impl->nextEntry++];
+        return LittleFS.open(child.c_str(), mode);
+    }
+
+    void File::rewindDirectory()
+    {
+        if (_impl)
+            _impl->nextEntry = 0;
+    }
+
+    bool FS::begin(bool formatOnFail, const char *basePath, uint8_t maxOpenFiles, const char *partitionLabel)
+    {
+        (void)basePath;
+        (void)maxOpenFiles;
+        (void)partitionLabel;
+        std::error_code ec;
+        if (stdfs::is_directory(root(), ec))
+            return true;
+        return formatOnFail && stdfs::create_directories(root(), ec);
+    }
+
+    void FS::end() {}
+
+    File FS::open(const char *path, const char *mode, const bool create)
+    {
+        (void)create;
+        auto impl = std::make_shared<FileImpl>();
+        impl->path = path ? path : "/";
+        impl->host = hostPath(path);
+        impl->name = impl->host.filename().string();
+
+        std::error_code ec;
+        if (stdfs::is_directory(impl->host, ec))
+        {
+            impl->directory = true;
+            for (const auto &entry : stdfs::directory_iterator(impl->host, ec))
+            {
+                impl->entries.push_back(entry.path().filename().string());
+            }
+            return File(impl);
+        }
+
+        const bool writing = mode && (mode[0] == 'w' || mode[0] == 'a');
+        if (writing)
+        {
+            stdfs::create_directories(impl->host.parent_path(), ec);
+        }
+        impl->fp = fopen(impl->host.string().c_str(), writing ? mode : "rb");
+        if (!impl->fp)
+            return File();
+        return File(impl);
+    }
+
+    bool FS::exists(const char *path)
+    {
+        std::error_code ec;
+        return stdfs::exists(hostPath(path), ec);
+    }
+
+    bool FS::remove(const char *path)
+    {
+        std::error_code ec;
+        return stdfs::remove(hostPath(path), ec);
+    }
+
+    bool FS::rename(const char *pathFrom, const char *pathTo)
+    {
+        std::error_code ec;
+        stdfs::rename(hostPath(pathFrom), hostPath(pathTo), ec);
+        return !ec;
+    }
+
+    bool FS::mkdir(const char *path)
+    {
+        std::error_code ec;
+        stdfs::create_directories(hostPath(path), ec);
+        return !ec;
+    }
+
+    bool FS::rmdir(const char *path)
+    {
+        std::error_code ec;
+        return stdfs::remove(hostPath(path), ec);
+    }
+
+    size_t FS::totalBytes()
+    {
+        return 1024 * 1024;
+    }
+
+    size_t FS::usedBytes()
+    {
+        size_t used = 0;
+        std::error_code ec;
+        for (const auto &entry : stdfs::recursive_directory_iterator(root(), ec))
+        {
+            if (entry.is_regular_file(ec))
+                used += static_cast<size_t>(entry.file_size(ec));
+        }
+        return used;
+    }
+}
+
+namespace nativehal
+{
+    void setFsRoot(const String &path)
+    {
+        std::lock_guard<std::mutex> lock(gRootMutex);
+        gRoot = path.c_str();
+    }
+
+    String getFsRoot()
+    {
+        return String(root().c_str());
+    }
+}
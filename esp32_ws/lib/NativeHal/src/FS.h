@@ -0,0 +1,80 @@
+/**
+ * @file FS.h
+ * @brief Host implementation of the Arduino-ESP32 filesystem API
+ *
+ * Paths are resolved below a host directory (see nativehal::setFsRoot()).
+ */
+
+#ifndef NATIVE_HAL_FS_H
+#define NATIVE_HAL_FS_H
+
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include "Stream.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+    class FileImpl;
+
+    class File : public Stream
+    {
+    public:
+        File() = default;
+        explicit File(std::shared_ptr<FileImpl> impl) : _impl(std::move(impl)) {}
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buf, size_t size) override;
+        using Print::write;
+        int available() override;
+        int read() override;
+        int peek() override;
+        void flush() override;
+        size_t read(uint8_t *buf, size_t size);
+        bool seek(uint32_t pos);
+        size_t position() const;
+        size_t size() const;
+        void close();
+        operator bool() const;
+        time_t getLastWrite();
+        const char *path() const;
+        const char *name() const;
+        bool isDirectory() const;
+        File openNextFile(const char *mode = FILE_READ);
+        void rewindDirectory();
+
+    private:
+        std::shared_ptr<FileImpl> _impl;
+    };
+
+    class FS
+    {
+    public:
+        bool begin(bool formatOnFail = false, const char *basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+                   const char *partitionLabel = nullptr);
+        void end();
+        File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+        File open(const String &path, const char *mode = FILE_READ, const bool create = false)
+        {
+            return open(path.c_str(), mode, create);
+        }
+        bool exists(const char *path);
+        bool exists(const String &path) { return exists(path.c_str()); }
+        bool remove(const char *path);
+        bool remove(const String &path) { return remove(path.c_str()); }
+        bool rename(const char *pathFrom, const char *pathTo);
+        bool mkdir(const char *path);
+        bool rmdir(const char *path);
+        size_t totalBytes();
+        size_t usedBytes();
+    };
+}
+
+using fs::File;
+using fs::FS;
+
+#endif // NATIVE_HAL_FS_H
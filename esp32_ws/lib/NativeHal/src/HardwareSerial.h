@@ -0,0 +1,49 @@
+/**
+ * @file HardwareSerial.h
+ * @brief Host implementation of the ESP32 UART driver
+ *
+ * UART 0 (Serial) writes to stdout and reads from an input buffer that the
+ * host feeds via nativehal::pushSerialInput(). Other UARTs swallow output.
+ */
+
+#ifndef NATIVE_HAL_HARDWARE_SERIAL_H
+#define NATIVE_HAL_HARDWARE_SERIAL_H
+
+#include "Stream.h"
+
+#define SERIAL_8N1 0x800001c
+
+class HardwareSerial : public Stream
+{
+public:
+    explicit HardwareSerial(int uartNum) : _uartNum(uartNum) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1)
+    {
+        (void)config;
+        (void)rxPin;
+        (void)txPin;
+        _baud = baud;
+    }
+    void end() { _baud = 0; }
+    unsigned long baudRate() const { return _baud; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+
+    operator bool() const { return true; }
+
+private:
+    int _uartNum;
+    unsigned long _baud = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif // NATIVE_HAL_HARDWARE_SERIAL_H
@@ -0,0 +1,38 @@
+/**
+ * @file IPAddress.h
+ * @brief Host implementation of the Arduino IPAddress class
+ */
+
+#ifndef NATIVE_HAL_IPADDRESS_H
+#define NATIVE_HAL_IPADDRESS_H
+
+#include <cstdint>
+#include <cstdio>
+#include "WString.h"
+
+class IPAddress
+{
+public:
+    IPAddress() = default;
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _bytes{a, b, c, d} {}
+
+    String toString() const
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+        return String(buf);
+    }
+
+    uint8_t operator[](int index) const { return _bytes[index]; }
+    bool operator==(const IPAddress &other) const
+    {
+        return _bytes[0] == other._bytes[0] && _bytes[1] == other._bytes[1] &&
+               _bytes[2] == other._bytes[2] && _bytes[3] == other._bytes[3];
+    }
+    bool operator!=(const IPAddress &other) const { return !(*this == other); }
+
+private:
+    uint8_t _bytes[4] = {0, 0, 0, 0};
+};
+
+#endif // NATIVE_HAL_IPADDRESS_H
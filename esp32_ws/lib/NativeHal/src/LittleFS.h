@@ -0,0 +1,20 @@
+/**
+ * @file LittleFS.h
+ * @brief Host implementation of the LittleFS global
+ */
+
+#ifndef NATIVE_HAL_LITTLEFS_H
+#define NATIVE_HAL_LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs
+{
+    class LittleFSFS : public FS
+    {
+    };
+}
+
+extern fs::LittleFSFS LittleFS;
+
+#endif // NATIVE_HAL_LITTLEFS_H
@@ -0,0 +1,60 @@
+/**
+ * @file NativeHal.h
+ * @brief Simulation controls for the native host build
+ *
+ * The firmware never includes this header; it is used by the host entry
+ * point and host-side tools to drive the simulated hardware.
+ */
+
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+#include <cstdint>
+#include "WString.h"
+
+namespace nativehal
+{
+    /**
+     * @brief Set the host directory that backs LittleFS (default: ./native_fs)
+     */
+    void setFsRoot(const String &path);
+    String getFsRoot();
+
+    /**
+     * @brief Append bytes to the Serial receive buffer
+     */
+    void pushSerialInput(const String &data);
+
+    /**
+     * @brief Drive the level seen by digitalRead() on an input pin
+     */
+    void setPinLevel(uint8_t pin, int level);
+
+    /**
+     * @brief Read the last level written with digitalWrite()
+     */
+    int getPinLevel(uint8_t pin);
+
+    /**
+     * @brief Current tone frequency on a LEDC channel (0 = silent)
+     */
+    uint32_t getLedcFrequency(uint8_t channel);
+
+    /**
+     * @brief Run simulated time this many times faster than real time (default 1)
+     *
+     * Scales millis()/micros(), the delay functions and every FreeRTOS
+     * timeout, so device tasks and libraries stay consistent with each
+     * other. Call once at startup: the scale applies to the whole time
+     * since boot.
+     */
+    void setTimeScale(double scale);
+    double getTimeScale();
+
+    /**
+     * @brief Called by ESP.restart(); defaults to exiting the process
+     */
+    void setRestartHandler(void (*handler)());
+}
+
+#endif // NATIVE_HAL_H
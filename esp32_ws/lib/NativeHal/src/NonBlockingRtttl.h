@@ -0,0 +1,23 @@
+/**
+ * @file NonBlockingRtttl.h
+ * @brief Host implementation of the NonBlockingRTTTL player
+ *
+ * Songs are not synthesised; a song "plays" for a duration estimated from
+ * its note count so callers polling isPlaying() behave as on hardware.
+ */
+
+#ifndef NATIVE_HAL_NONBLOCKING_RTTTL_H
+#define NATIVE_HAL_NONBLOCKING_RTTTL_H
+
+#include <Arduino.h>
+
+namespace rtttl
+{
+    void begin(byte iPin, const char *iSongBuffer);
+    void play();
+    void stop();
+    bool isPlaying();
+    bool done();
+}
+
+#endif // NATIVE_HAL_NONBLOCKING_RTTTL_H
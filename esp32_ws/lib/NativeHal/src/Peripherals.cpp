@@ -0,0 +1,62 @@
+#include "WiFi.h"
+#include "Wire.h"
+#include "NonBlockingRtttl.h"
+
+#include <atomic>
+
+WiFiClass WiFi;
+TwoWire Wire(0);
+TwoWire Wire1(1);
+
+namespace
+{
+    constexpr unsigned long kSimulatedNoteMs = 150;
+
+    std::atomic<bool> gRtttlPlaying{false};
+    std::atomic<unsigned long> gRtttlEndMs{0};
+}
+
+namespace rtttl
+{
+    void begin(byte iPin, const char *iSongBuffer)
+    {
+        (void)iPin;
+        // RTTTL format is "name:defaults:note,note,..."; every comma-separated note gets a fixed duration
+        unsigned long notes = 0;
+        const char *notesStart = iSongBuffer ? strrchr(iSongBuffer, ':') : nullptr;
+        if (notesStart && notesStart[1] != '\0')
+        {
+            notes = 1;
+            for (const char *p = notesStart; *p; ++p)
+            {
+                if (*p == ',')
+                    notes++;
+            }
+        }
+        gRtttlEndMs = millis() + notes * kSimulatedNoteMs;
+        gRtttlPlaying = notes > 0;
+    }
+
+    void play()
+    {
+        if (gRtttlPlaying && millis() >= gRtttlEndMs)
+        {
+            gRtttlPlaying = false;
+        }
+    }
+
+    void stop()
+    {
+        gRtttlPlaying = false;
+    }
+
+    bool isPlaying()
+    {
+        return gRtttlPlaying;
+    }
+
+    bool done()
+    {
+        return !gRtttlPlaying;
+    }
+}
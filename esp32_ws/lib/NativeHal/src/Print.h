@@ -0,0 +1,72 @@
+/**
+ * @file Print.h
+ * @brief Host implementation of the Arduino Print base class
+ */
+
+#ifndef NATIVE_HAL_PRINT_H
+#define NATIVE_HAL_PRINT_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include "WString.h"
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+        {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+    size_t write(const char *str) { return str ? write(reinterpret_cast<const uint8_t *>(str), strlen(str)) : 0; }
+    size_t write(const char *buffer, size_t size) { return write(reinterpret_cast<const uint8_t *>(buffer), size); }
+    virtual void flush() {}
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const String &s) { return write(s.c_str(), s.length()); }
+    size_t print(const char *str) { return write(str); }
+    size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+    size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(unsigned char value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(int value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(unsigned int value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(unsigned long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(long long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(unsigned long long value, int base = 10) { return print(String(value, static_cast<unsigned char>(base))); }
+    size_t print(double value, int digits = 2) { return print(String(value, static_cast<unsigned int>(digits))); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &value)
+    {
+        const size_t n = print(value);
+        return n + println();
+    }
+    template <typename T>
+    size_t println(const T &value, int format)
+    {
+        const size_t n = print(value, format);
+        return n + println();
+    }
+
+private:
+    static size_t strlen(const char *str)
+    {
+        size_t n = 0;
+        while (str[n])
+            n++;
+        return n;
+    }
+};
+
+#endif // NATIVE_HAL_PRINT_H
@@ -0,0 +1,62 @@
+/**
+ * @file Stream.h
+ * @brief Host implementation of the Arduino Stream base class
+ */
+
+#ifndef NATIVE_HAL_STREAM_H
+#define NATIVE_HAL_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    unsigned long getTimeout() const { return _timeout; }
+
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t count = 0;
+        while (count < length)
+        {
+            const int c = read();
+            if (c < 0)
+                break;
+            *buffer++ = static_cast<char>(c);
+            count++;
+        }
+        return count;
+    }
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes(reinterpret_cast<char *>(buffer), length); }
+
+    String readString()
+    {
+        String ret;
+        int c;
+        while ((c = read()) >= 0)
+        {
+            ret += static_cast<char>(c);
+        }
+        return ret;
+    }
+
+    String readStringUntil(char terminator)
+    {
+        String ret;
+        int c;
+        while ((c = read()) >= 0 && c != terminator)
+        {
+            ret += static_cast<char>(c);
+        }
+        return ret;
+    }
+
+protected:
+    unsigned long _timeout = 1000;
+};
+
+#endif // NATIVE_HAL_STREAM_H
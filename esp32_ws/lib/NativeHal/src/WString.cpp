@@ -0,0 +1,135 @@
+#include "WString.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    std::string formatUnsigned(unsigned long value, unsigned char base)
+    {
+        if (base < 2 || base > 36)
+            base = 10;
+        if (value == 0)
+            return "0";
+        std::string out;
+        while (value > 0)
+        {
+            const unsigned digit = value % base;
+            out.push_back(static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10));
+            value /= base;
+        }
+        std::reverse(out.begin(), out.end());
+        return out;
+    }
+}
+
+String::String(long value, unsigned char base)
+{
+    if (value < 0 && base == 10)
+    {
+        _str = "-" + formatUnsigned(static_cast<unsigned long>(-(value + 1)) + 1, base);
+    }
+    else
+    {
+        _str = formatUnsigned(static_cast<unsigned long>(value), base);
+    }
+}
+
+String::String(unsigned long value, unsigned char base) : _str(formatUnsigned(value, base)) {}
+
+String::String(double value, unsigned int decimalPlaces)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", static_cast<int>(decimalPlaces), value);
+    _str = buf;
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const
+{
+    if (!buf || bufsize == 0)
+        return;
+    if (index >= _str.size())
+    {
+        buf[0] = 0;
+        return;
+    }
+    const size_t n = std::min<size_t>(bufsize - 1, _str.size() - index);
+    memcpy(buf, _str.data() + index, n);
+    buf[n] = 0;
+}
+
+bool String::equalsIgnoreCase(const String &s) const
+{
+    if (_str.size() != s._str.size())
+        return false;
+    for (size_t i = 0; i < _str.size(); i++)
+    {
+        if (tolower(static_cast<unsigned char>(_str[i])) != tolower(static_cast<unsigned char>(s._str[i])))
+            return false;
+    }
+    return true;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+    if (beginIndex > endIndex)
+        std::swap(beginIndex, endIndex);
+    if (beginIndex >= _str.size())
+        return String();
+    endIndex = std::min<unsigned int>(endIndex, length());
+    return String(_str.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(char find, char replace)
+{
+    std::replace(_str.begin(), _str.end(), find, replace);
+}
+
+void String::replace(const String &find, const String &replace)
+{
+    if (find._str.empty())
+        return;
+    size_t pos = 0;
+    while ((pos = _str.find(find._str, pos)) != std::string::npos)
+    {
+        _str.replace(pos, find._str.size(), replace._str);
+        pos += replace._str.size();
+    }
+}
+
+void String::toLowerCase()
+{
+    for (char &c : _str)
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+}
+
+void String::toUpperCase()
+{
+    for (char &c : _str)
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+}
+
+void String::trim()
+{
+    const size_t first = _str.find_first_not_of(" \t\r\n\f\v");
+    if (first == std::string::npos)
+    {
+        _str.clear();
+        return;
+    }
+    const size_t last = _str.find_last_not_of(" \t\r\n\f\v");
+    _str = _str.substr(first, last - first + 1);
+}
+
+long String::toInt() const
+{
+    return strtol(_str.c_str(), nullptr, 10);
+}
+
+double String::toDouble() const
+{
+    return strtod(_str.c_str(), nullptr);
+}
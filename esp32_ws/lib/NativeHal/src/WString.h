@@ -0,0 +1,236 @@
+/**
+ * @file WString.h
+ * @brief Host implementation of the Arduino String class
+ *
+ * Backed by std::string. Only the subset of the Arduino API used by the
+ * firmware is provided, with the same semantics (indices are unsigned,
+ * missing matches return -1, numeric conversions never throw).
+ */
+
+#ifndef NATIVE_HAL_WSTRING_H
+#define NATIVE_HAL_WSTRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String
+{
+public:
+    String() = default;
+    String(const char *cstr) : _str(cstr ? cstr : "") {}
+    String(const char *cstr, size_t length) : _str(cstr ? std::string(cstr, length) : std::string()) {}
+    String(const __FlashStringHelper *pstr) : String(reinterpret_cast<const char *>(pstr)) {}
+    String(const std::string &str) : _str(str) {}
+    String(const String &) = default;
+    String(String &&) noexcept = default;
+    explicit String(char c) : _str(1, c) {}
+    explicit String(unsigned char value, unsigned char base = 10) : String(static_cast<unsigned long>(value), base) {}
+    explicit String(int value, unsigned char base = 10) : String(static_cast<long>(value), base) {}
+    explicit String(unsigned int value, unsigned char base = 10) : String(static_cast<unsigned long>(value), base) {}
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10) : String(static_cast<long>(value), base) {}
+    explicit String(unsigned long long value, unsigned char base = 10) : String(static_cast<unsigned long>(value), base) {}
+    explicit String(float value, unsigned int decimalPlaces = 2) : String(static_cast<double>(value), decimalPlaces) {}
+    explicit String(double value, unsigned int decimalPlaces = 2);
+
+    String &operator=(const String &) = default;
+    String &operator=(String &&) noexcept = default;
+    String &operator=(const char *cstr)
+    {
+        _str = cstr ? cstr : "";
+        return *this;
+    }
+
+    // Capacity
+    unsigned int length() const { return static_cast<unsigned int>(_str.size()); }
+    bool isEmpty() const { return _str.empty(); }
+    bool reserve(unsigned int size)
+    {
+        _str.reserve(size);
+        return true;
+    }
+    void clear() { _str.clear(); }
+
+    // Access
+    const char *c_str() const { return _str.c_str(); }
+    char *begin() { return &_str[0]; }
+    char *end() { return &_str[0] + _str.size(); }
+    const char *begin() const { return _str.c_str(); }
+    const char *end() const { return _str.c_str() + _str.size(); }
+    char charAt(unsigned int index) const { return index < _str.size() ? _str[index] : 0; }
+    void setCharAt(unsigned int index, char c)
+    {
+        if (index < _str.size())
+            _str[index] = c;
+    }
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index) { return _str[index]; }
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const
+    {
+        toCharArray(reinterpret_cast<char *>(buf), bufsize, index);
+    }
+
+    // Concatenation
+    bool concat(const String &str)
+    {
+        _str += str._str;
+        return true;
+    }
+    bool concat(const char *cstr)
+    {
+        if (cstr)
+            _str += cstr;
+        return true;
+    }
+    bool concat(const char *cstr, unsigned int length)
+    {
+        if (cstr)
+            _str.append(cstr, length);
+        return true;
+    }
+    bool concat(char c)
+    {
+        _str += c;
+        return true;
+    }
+    template <typename T>
+    bool concat(T value) { return concat(String(value)); }
+
+    String &operator+=(const String &rhs)
+    {
+        concat(rhs);
+        return *this;
+    }
+    String &operator+=(const char *cstr)
+    {
+        concat(cstr);
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        concat(c);
+        return *this;
+    }
+    template <typename T>
+    String &operator+=(T value)
+    {
+        concat(String(value));
+        return *this;
+    }
+
+    // Comparison
+    int compareTo(const String &s) const { return _str.compare(s._str); }
+    bool equals(const String &s) const { return _str == s._str; }
+    bool equals(const char *cstr) const { return _str == (cstr ? cstr : ""); }
+    bool equalsIgnoreCase(const String &s) const;
+    bool startsWith(const String &prefix) const { return _str.compare(0, prefix._str.size(), prefix._str) == 0; }
+    bool startsWith(const String &prefix, unsigned int offset) const
+    {
+        return offset <= _str.size() && _str.compare(offset, prefix._str.size(), prefix._str) == 0;
+    }
+    bool endsWith(const String &suffix) const
+    {
+        return suffix._str.size() <= _str.size() &&
+               _str.compare(_str.size() - suffix._str.size(), suffix._str.size(), suffix._str) == 0;
+    }
+
+    bool operator==(const String &rhs) const { return equals(rhs); }
+    bool operator==(const char *cstr) const { return equals(cstr); }
+    bool operator!=(const String &rhs) const { return !equals(rhs); }
+    bool operator!=(const char *cstr) const { return !equals(cstr); }
+    bool operator<(const String &rhs) const { return compareTo(rhs) < 0; }
+    bool operator>(const String &rhs) const { return compareTo(rhs) > 0; }
+    bool operator<=(const String &rhs) const { return compareTo(rhs) <= 0; }
+    bool operator>=(const String &rhs) const { return compareTo(rhs) >= 0; }
+
+    // Search
+    int indexOf(char ch, unsigned int fromIndex = 0) const { return toIndex(_str.find(ch, fromIndex)); }
+    int indexOf(const String &str, unsigned int fromIndex = 0) const { return toIndex(_str.find(str._str, fromIndex)); }
+    int lastIndexOf(char ch) const { return toIndex(_str.rfind(ch)); }
+    int lastIndexOf(char ch, unsigned int fromIndex) const { return toIndex(_str.rfind(ch, fromIndex)); }
+    int lastIndexOf(const String &str) const { return toIndex(_str.rfind(str._str)); }
+    int lastIndexOf(const String &str, unsigned int fromIndex) const { return toIndex(_str.rfind(str._str, fromIndex)); }
+    String substring(unsigned int beginIndex) const
+    {
+        return beginIndex < _str.size() ? String(_str.substr(beginIndex)) : String();
+    }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    // Modification
+    void replace(char find, char replace);
+    void replace(const String &find, const String &replace);
+    void remove(unsigned int index)
+    {
+        if (index < _str.size())
+            _str.erase(index);
+    }
+    void remove(unsigned int index, unsigned int count)
+    {
+        if (index < _str.size())
+            _str.erase(index, count);
+    }
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    // Conversion
+    long toInt() const;
+    float toFloat() const { return static_cast<float>(toDouble()); }
+    double toDouble() const;
+
+    const std::string &str() const { return _str; }
+
+private:
+    static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+    std::string _str;
+};
+
+inline String operator+(const String &lhs, const String &rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const String &lhs, const char *rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const char *lhs, const String &rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(const String &lhs, char rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+inline String operator+(char lhs, const String &rhs)
+{
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+inline String operator+(const String &lhs, T rhs)
+{
+    String result(lhs);
+    result.concat(String(rhs));
+    return result;
+}
+inline bool operator==(const char *lhs, const String &rhs) { return rhs.equals(lhs); }
+inline bool operator!=(const char *lhs, const String &rhs) { return !rhs.equals(lhs); }
+
+#endif // NATIVE_HAL_WSTRING_H
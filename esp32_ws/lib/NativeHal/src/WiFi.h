@@ -0,0 +1,139 @@
+/**
+ * @file WiFi.h
+ * @brief Host implementation of the ESP32 WiFi API
+ *
+ * Station mode connects immediately to a loopback "network"; scans find
+ * nothing. This keeps Network's state machine on its happy path.
+ */
+
+#ifndef NATIVE_HAL_WIFI_H
+#define NATIVE_HAL_WIFI_H
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+typedef enum
+{
+    WIFI_MODE_NULL = 0,
+    WIFI_OFF = 0,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA
+} wifi_mode_t;
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_SCAN_COMPLETED = 2,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum
+{
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK
+} wifi_auth_mode_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED (-2)
+
+class WiFiClass
+{
+public:
+    bool mode(wifi_mode_t mode)
+    {
+        _mode = mode;
+        return true;
+    }
+    wifi_mode_t getMode() const { return _mode; }
+
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr)
+    {
+        (void)passphrase;
+        _ssid = ssid ? ssid : "";
+        _status = WL_CONNECTED;
+        return _status;
+    }
+    bool disconnect(bool wifiOff = false, bool eraseAp = false)
+    {
+        (void)wifiOff;
+        (void)eraseAp;
+        _status = WL_DISCONNECTED;
+        return true;
+    }
+    wl_status_t status() const { return _status; }
+    String SSID() const { return _ssid; }
+    int8_t RSSI() const { return _status == WL_CONNECTED ? -40 : 0; }
+    IPAddress localIP() const { return _status == WL_CONNECTED ? IPAddress(127, 0, 0, 1) : IPAddress(); }
+
+    bool softAP(const char *ssid, const char *passphrase = nullptr)
+    {
+        (void)passphrase;
+        _apSsid = ssid ? ssid : "";
+        return true;
+    }
+    bool softAPdisconnect(bool wifiOff = false)
+    {
+        (void)wifiOff;
+        _apSsid = "";
+        return true;
+    }
+    IPAddress softAPIP() const { return IPAddress(192, 168, 4, 1); }
+    String softAPSSID() const { return _apSsid; }
+    uint8_t softAPgetStationNum() const { return 0; }
+
+    int16_t scanNetworks(bool async = false, bool showHidden = false)
+    {
+        (void)showHidden;
+        _scanDone = true;
+        return async ? WIFI_SCAN_RUNNING : 0;
+    }
+    int16_t scanComplete() const { return _scanDone ? 0 : WIFI_SCAN_RUNNING; }
+    void scanDelete() { _scanDone = false; }
+    String SSID(uint8_t index) const
+    {
+        (void)index;
+        return String();
+    }
+    int32_t RSSI(uint8_t index) const
+    {
+        (void)index;
+        return 0;
+    }
+    wifi_auth_mode_t encryptionType(uint8_t index) const
+    {
+        (void)index;
+        return WIFI_AUTH_OPEN;
+    }
+    int32_t channel(uint8_t index) const
+    {
+        (void)index;
+        return 0;
+    }
+    String BSSIDstr(uint8_t index) const
+    {
+        (void)index;
+        return String();
+    }
+
+private:
+    wifi_mode_t _mode = WIFI_OFF;
+    wl_status_t _status = WL_IDLE_STATUS;
+    String _ssid;
+    String _apSsid;
+    bool _scanDone = false;
+};
+
+extern WiFiClass WiFi;
+
+#endif // NATIVE_HAL_WIFI_H
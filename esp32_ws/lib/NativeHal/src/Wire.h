@@ -0,0 +1,66 @@
+/**
+ * @file Wire.h
+ * @brief Host implementation of the Arduino I2C API
+ *
+ * The simulated bus is empty: every address NACKs and reads return nothing.
+ */
+
+#ifndef NATIVE_HAL_WIRE_H
+#define NATIVE_HAL_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire : public Stream
+{
+public:
+    explicit TwoWire(uint8_t busNum) : _busNum(busNum) {}
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0)
+    {
+        (void)sda;
+        (void)scl;
+        (void)frequency;
+        return true;
+    }
+    bool end() { return true; }
+
+    void beginTransmission(uint8_t address) { _address = address; }
+    void beginTransmission(int address) { beginTransmission(static_cast<uint8_t>(address)); }
+    uint8_t endTransmission(bool sendStop = true)
+    {
+        (void)sendStop;
+        return 2; // address NACK
+    }
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true)
+    {
+        (void)address;
+        (void)quantity;
+        (void)sendStop;
+        return 0;
+    }
+
+    size_t write(uint8_t data) override
+    {
+        (void)data;
+        return 1;
+    }
+    size_t write(const uint8_t *data, size_t quantity) override
+    {
+        (void)data;
+        return quantity;
+    }
+    size_t write(int data) { return write(static_cast<uint8_t>(data)); }
+    size_t write(unsigned int data) { return write(static_cast<uint8_t>(data)); }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    uint8_t _busNum;
+    uint8_t _address = 0;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif // NATIVE_HAL_WIRE_H
@@ -0,0 +1,77 @@
+/**
+ * @file mcpwm.h
+ * @brief Host implementation of the ESP-IDF legacy MCPWM driver
+ *
+ * Duty cycles are recorded so simulations can read back the servo output.
+ */
+
+#ifndef NATIVE_HAL_DRIVER_MCPWM_H
+#define NATIVE_HAL_DRIVER_MCPWM_H
+
+#include <cstdint>
+#include "esp_err.h"
+
+typedef enum
+{
+    MCPWM0A = 0,
+    MCPWM0B,
+    MCPWM1A,
+    MCPWM1B,
+    MCPWM2A,
+    MCPWM2B
+} mcpwm_io_signals_t;
+
+typedef enum
+{
+    MCPWM_UNIT_0 = 0,
+    MCPWM_UNIT_1,
+    MCPWM_UNIT_MAX
+} mcpwm_unit_t;
+
+typedef enum
+{
+    MCPWM_TIMER_0 = 0,
+    MCPWM_TIMER_1,
+    MCPWM_TIMER_2,
+    MCPWM_TIMER_MAX
+} mcpwm_timer_t;
+
+typedef enum
+{
+    MCPWM_OPR_A = 0,
+    MCPWM_OPR_B,
+    MCPWM_OPR_MAX
+} mcpwm_operator_t;
+
+typedef enum
+{
+    MCPWM_DUTY_MODE_0 = 0,
+    MCPWM_DUTY_MODE_1,
+    MCPWM_DUTY_MODE_MAX
+} mcpwm_duty_type_t;
+
+typedef enum
+{
+    MCPWM_FREEZE_COUNTER,
+    MCPWM_UP_COUNTER,
+    MCPWM_DOWN_COUNTER,
+    MCPWM_UP_DOWN_COUNTER,
+    MCPWM_COUNTER_MAX
+} mcpwm_counter_type_t;
+
+typedef struct
+{
+    uint32_t frequency;
+    float cmpr_a;
+    float cmpr_b;
+    mcpwm_duty_type_t duty_mode;
+    mcpwm_counter_type_t counter_mode;
+} mcpwm_config_t;
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t unit, mcpwm_io_signals_t signal, int gpio);
+esp_err_t mcpwm_init(mcpwm_unit_t unit, mcpwm_timer_t timer, const mcpwm_config_t *config);
+esp_err_t mcpwm_set_duty(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_operator_t op, float duty);
+esp_err_t mcpwm_set_duty_type(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_operator_t op, mcpwm_duty_type_t dutyType);
+float mcpwm_get_duty(mcpwm_unit_t unit, mcpwm_timer_t timer, mcpwm_operator_t op);
+
+#endif // NATIVE_HAL_DRIVER_MCPWM_H
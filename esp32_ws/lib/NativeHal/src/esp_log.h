@@ -0,0 +1,25 @@
+/**
+ * @file esp_log.h
+ * @brief Host implementation of the ESP-IDF log level API (no-op)
+ */
+
+#ifndef NATIVE_HAL_ESP_LOG_H
+#define NATIVE_HAL_ESP_LOG_H
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+inline void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    (void)level;
+}
+
+#endif // NATIVE_HAL_ESP_LOG_H
@@ -0,0 +1,560 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "queue.h"
+#include "../NativeHal.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+unsigned long millis();
+
+struct NativeTask
+{
+    std::string name;
+    TaskFunction_t code = nullptr;
+    void *parameters = nullptr;
+    uint32_t stackDepth = 0;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifyValue = 0;
+    bool deleteRequested = false;
+    bool suspended = false;
+    bool finished = false;
+};
+
+struct NativeSemaphore
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    UBaseType_t count = 0;
+    UBaseType_t maxCount = 1;
+};
+
+struct NativeQueue
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length = 0;
+    UBaseType_t itemSize = 0;
+};
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Blocking calls wake up at least this often to honour vTaskDelete() from other tasks
+    constexpr auto kCancelPollInterval = std::chrono::milliseconds(10);
+    constexpr auto kDeleteJoinTimeout = std::chrono::seconds(2);
+
+    std::mutex gTasksMutex;
+    std::map<NativeTask *, std::shared_ptr<NativeTask>> gTasks;
+    thread_local NativeTask *tCurrentTask = nullptr;
+    std::recursive_mutex gCriticalMutex;
+
+    std::shared_ptr<NativeTask> findTask(NativeTask *task)
+    {
+        std::lock_guard<std::mutex> lock(gTasksMutex);
+        auto it = gTasks.find(task);
+        return it != gTasks.end() ? it->second : nullptr;
+    }
+
+    NativeTask *currentTask()
+    {
+        if (tCurrentTask == nullptr)
+        {
+            // Threads not created through xTaskCreate (main loop, host tools) behave like the Arduino loop task
+            auto task = std::make_shared<NativeTask>();
+            task->name = "loopTask";
+            std::lock_guard<std::mutex> lock(gTasksMutex);
+            gTasks[task.get()] = task;
+            tCurrentTask = task.get();
+        }
+        return tCurrentTask;
+    }
+
+    Clock::time_point deadlineFor(TickType_t ticks)
+    {
+        if (ticks == portMAX_DELAY)
+        {
+            return Clock::time_point::max();
+        }
+        // Ticks are simulated time; see nativehal::setTimeScale()
+        const double realUs = static_cast<double>(ticks) * portTICK_PERIOD_MS * 1000 / nativehal::getTimeScale();
+        return Clock::now() + std::chrono::microseconds(static_cast<int64_t>(realUs));
+    }
+
+    [[noreturn]] void exitCurrentTask()
+    {
+        pthread_exit(nullptr);
+    }
+
+    // Called by every blocking primitive; terminates the calling task when another task deleted it
+    void checkDeleted(NativeTask *task)
+    {
+        bool exitNow = false;
+        {
+            std::unique_lock<std::mutex> lock(task->mutex);
+            task->cv.wait(lock, [task]
+                          { return !task->suspended || task->deleteRequested; });
+            exitNow = task->deleteRequested;
+        }
+        if (exitNow)
+        {
+            exitCurrentTask();
+        }
+    }
+
+    // Wait on cv until pred() is true or the deadline passes, waking periodically to check for deletion
+    template <typename Pred>
+    bool waitWithCancel(std::unique_lock<std::mutex> &lock, std::condition_variable &cv, Clock::time_point deadline, Pred pred)
+    {
+        NativeTask *self = currentTask();
+        while (!pred())
+        {
+            const auto now = Clock::now();
+            if (now >= deadline)
+            {
+                return false;
+            }
+            const auto slice = (deadline - now) < kCancelPollInterval ? (deadline - now) : Clock::duration(kCancelPollInterval);
+            cv.wait_for(lock, slice);
+
+            bool deleted;
+            {
+                std::lock_guard<std::mutex> taskLock(self->mutex);
+                deleted = self->deleteRequested;
+            }
+            if (deleted)
+            {
+                lock.unlock();
+                exitCurrentTask();
+            }
+        }
+        return true;
+    }
+
+    struct TaskExitGuard
+    {
+        std::shared_ptr<NativeTask> task;
+        ~TaskExitGuard()
+        {
+            {
+                std::lock_guard<std::mutex> lock(task->mutex);
+                task->finished = true;
+            }
+            task->cv.notify_all();
+            std::lock_guard<std::mutex> lock(gTasksMutex);
+            gTasks.erase(task.get());
+        }
+    };
+
+    void *taskEntry(void *arg)
+    {
+        std::shared_ptr<NativeTask> *holder = static_cast<std::shared_ptr<NativeTask> *>(arg);
+        TaskExitGuard guard{*holder};
+        delete holder;
+
+        tCurrentTask = guard.task.get();
+        checkDeleted(guard.task.get());
+        guard.task->code(guard.task->parameters);
+        return nullptr;
+    }
+
+    BaseType_t queueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait, bool toFront)
+    {
+        if (queue == nullptr)
+            return pdFAIL;
+
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        if (!waitWithCancel(lock, queue->cv, deadlineFor(ticksToWait), [queue]
+                            { return queue->items.size() < queue->length; }))
+        {
+            return errQUEUE_FULL;
+        }
+
+        const uint8_t *bytes = static_cast<const uint8_t *>(item);
+        std::vector<uint8_t> copy(bytes, bytes + queue->itemSize);
+        if (toFront)
+            queue->items.push_front(std::move(copy));
+        else
+            queue->items.push_back(std::move(copy));
+        queue->cv.notify_all();
+        return pdPASS;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Tasks
+// ----------------------------------------------------------------------------
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t taskCode, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *createdTask,
+                                   BaseType_t coreId)
+{
+    (void)priority;
+    (void)coreId;
+
+    auto task = std::make_shared<NativeTask>();
+    task->name = name ? name : "";
+    task->code = taskCode;
+    task->parameters = parameters;
+    task->stackDepth = stackDepth;
+
+    {
+        std::lock_guard<std::mutex> lock(gTasksMutex);
+        gTasks[task.get()] = task;
+    }
+    if (createdTask)
+    {
+        *createdTask = task.get();
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    pthread_t thread;
+    auto *holder = new std::shared_ptr<NativeTask>(task);
+    const int err = pthread_create(&thread, &attr, taskEntry, holder);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0)
+    {
+        delete holder;
+        std::lock_guard<std::mutex> lock(gTasksMutex);
+        gTasks.erase(task.get());
+        if (createdTask)
+        {
+            *createdTask = nullptr;
+        }
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t taskCode, const char *name, uint32_t stackDepth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *createdTask)
+{
+    return xTaskCreatePinnedToCore(taskCode, name, stackDepth, parameters, priority, createdTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == tCurrentTask)
+    {
+        exitCurrentTask();
+    }
+
+    std::shared_ptr<NativeTask> target = findTask(task);
+    if (!target)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(target->mutex);
+    target->deleteRequested = true;
+    target->cv.notify_all();
+    if (!target->cv.wait_for(lock, kDeleteJoinTimeout, [&target]
+                             { return target->finished; }))
+    {
+        fprintf(stderr, "[native] task '%s' did not exit after vTaskDelete\n", target->name.c_str());
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    NativeTask *self = currentTask();
+    {
+        std::unique_lock<std::mutex> lock(self->mutex);
+        self->cv.wait_until(lock, deadlineFor(ticks), [self]
+                            { return self->deleteRequested; });
+    }
+    checkDeleted(self);
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t timeIncrement)
+{
+    const TickType_t wakeTime = *previousWakeTime + timeIncrement;
+    const TickType_t now = xTaskGetTickCount();
+    *previousWakeTime = wakeTime;
+    vTaskDelay(static_cast<int32_t>(wakeTime - now) > 0 ? wakeTime - now : 0);
+}
+
+void vTaskSuspend(TaskHandle_t task)
+{
+    NativeTask *self = currentTask();
+    if (task == nullptr || task == self)
+    {
+        {
+            std::lock_guard<std::mutex> lock(self->mutex);
+            self->suspended = true;
+        }
+        checkDeleted(self);
+        return;
+    }
+
+    std::shared_ptr<NativeTask> target = findTask(task);
+    if (target)
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        target->suspended = true;
+    }
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+    std::shared_ptr<NativeTask> target = findTask(task);
+    if (target)
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        target->suspended = false;
+        target->cv.notify_all();
+    }
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return static_cast<TickType_t>(millis() / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return currentTask();
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    NativeTask *target = task ? task : currentTask();
+    return const_cast<char *>(target->name.c_str());
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    NativeTask *target = task ? task : currentTask();
+    return target->stackDepth;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::shared_ptr<NativeTask> target = findTask(task);
+    if (target)
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        target->notifyValue++;
+        target->cv.notify_all();
+    }
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait)
+{
+    NativeTask *self = currentTask();
+    uint32_t value = 0;
+    {
+        std::unique_lock<std::mutex> lock(self->mutex);
+        self->cv.wait_until(lock, deadlineFor(ticksToWait), [self]
+                            { return self->notifyValue > 0 || self->deleteRequested; });
+        value = self->notifyValue;
+        if (value > 0)
+        {
+            self->notifyValue = clearCountOnExit ? 0 : value - 1;
+        }
+    }
+    checkDeleted(self);
+    return value;
+}
+
+void taskYIELD()
+{
+    sched_yield();
+}
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    gCriticalMutex.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    gCriticalMutex.unlock();
+}
+
+// ----------------------------------------------------------------------------
+// Semaphores
+// ----------------------------------------------------------------------------
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    auto *semaphore = new NativeSemaphore();
+    semaphore->maxCount = maxCount;
+    semaphore->count = initialCount;
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+    if (semaphore == nullptr)
+        return pdFALSE;
+
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    if (!waitWithCancel(lock, semaphore->cv, deadlineFor(ticksToWait), [semaphore]
+                        { return semaphore->count > 0; }))
+    {
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    if (semaphore == nullptr)
+        return pdFALSE;
+
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    if (semaphore->count >= semaphore->maxCount)
+    {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->cv.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *higherPriorityTaskWoken)
+{
+    if (higherPriorityTaskWoken)
+        *higherPriorityTaskWoken = pdFALSE;
+    return xSemaphoreGive(semaphore);
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    if (semaphore == nullptr)
+        return 0;
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+    return semaphore->count;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
+
+// ----------------------------------------------------------------------------
+// Queues
+// ----------------------------------------------------------------------------
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    if (length == 0)
+        return nullptr;
+    auto *queue = new NativeQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+    return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+    return queueSend(queue, item, ticksToWait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticksToWait)
+{
+    return queueSend(queue, item, ticksToWait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait)
+{
+    if (queue == nullptr)
+        return pdFAIL;
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitWithCancel(lock, queue->cv, deadlineFor(ticksToWait), [queue]
+                        { return !queue->items.empty(); }))
+    {
+        return errQUEUE_EMPTY;
+    }
+    memcpy(buffer, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticksToWait)
+{
+    if (queue == nullptr)
+        return pdFAIL;
+
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!waitWithCancel(lock, queue->cv, deadlineFor(ticksToWait), [queue]
+                        { return !queue->items.empty(); }))
+    {
+        return errQUEUE_EMPTY;
+    }
+    memcpy(buffer, queue->items.front().data(), queue->itemSize);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    if (queue == nullptr)
+        return 0;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return static_cast<UBaseType_t>(queue->items.size());
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    if (queue == nullptr)
+        return 0;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->length - static_cast<UBaseType_t>(queue->items.size());
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    if (queue == nullptr)
+        return pdFAIL;
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    queue->items.clear();
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
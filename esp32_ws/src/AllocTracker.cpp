@@ -0,0 +1,456 @@
+#include "AllocTracker.h"
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#ifdef MARBLE_NATIVE
+#include <malloc.h>
+#include <pthread.h>
+#else
+#include <esp_heap_caps.h>
+#endif
+
+namespace
+{
+    // Tasks that can have a scope open at the same time (main loop, async_tcp, device tasks)
+    constexpr int8_t MAX_TRACKED_TASKS = 8;
+
+    struct TaskSlot
+    {
+        std::atomic<uintptr_t> task{0}; // Owning task, 0 when free
+        uint8_t depth = 0;              // Open scopes of the owning task
+        AllocCounters counters;         // Only written by the owning task
+    };
+
+    TaskSlot taskSlots[MAX_TRACKED_TASKS];
+
+    std::atomic<uint64_t> totalAllocations{0};
+    std::atomic<uint64_t> totalFrees{0};
+    std::atomic<uint64_t> totalBytes{0};
+
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+    uintptr_t currentTaskKey()
+    {
+#ifdef MARBLE_NATIVE
+        return static_cast<uintptr_t>(pthread_self());
+#else
+        // Allocations made before the scheduler runs cannot be attributed to a task
+        if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+        {
+            return 0;
+        }
+        return reinterpret_cast<uintptr_t>(xTaskGetCurrentTaskHandle());
+#endif
+    }
+
+    // Usable size of a heap block, so allocations and frees of the same block cancel out
+    size_t blockSize(void *ptr)
+    {
+#ifdef MARBLE_NATIVE
+        return malloc_usable_size(ptr);
+#else
+        return heap_caps_get_allocated_size(ptr);
+#endif
+    }
+
+    TaskSlot *findTaskSlot(uintptr_t key)
+    {
+        if (key == 0)
+        {
+            return nullptr;
+        }
+        for (int8_t i = 0; i < MAX_TRACKED_TASKS; i++)
+        {
+            if (taskSlots[i].task.load(std::memory_order_relaxed) == key)
+            {
+                return &taskSlots[i];
+            }
+        }
+        return nullptr;
+    }
+}
+
+// Initialize static members
+AllocTracker::SubsystemStats AllocTracker::subsystems[static_cast<uint8_t>(AllocSubsystem::Count)];
+AllocTracker::HeapSample AllocTracker::samples[SAMPLE_COUNT];
+uint8_t AllocTracker::sampleCount = 0;
+uint8_t AllocTracker::sampleHead = 0;
+unsigned long AllocTracker::lastSampleMs = 0;
+uint64_t AllocTracker::totalAllocationsAtLastSample = 0;
+float AllocTracker::totalAllocationsPerSec = 0;
+
+AllocTracker::Scope::Scope(AllocSubsystem subsystem) : _subsystem(subsystem), _slot(-1)
+{
+    const uintptr_t key = currentTaskKey();
+    if (key == 0)
+    {
+        return;
+    }
+
+    TaskSlot *slot = findTaskSlot(key);
+    if (!slot)
+    {
+        for (int8_t i = 0; i < MAX_TRACKED_TASKS; i++)
+        {
+            uintptr_t expected = 0;
+            if (taskSlots[i].task.compare_exchange_strong(expected, key))
+            {
+                slot = &taskSlots[i];
+                slot->depth = 0;
+                slot->counters = AllocCounters();
+                break;
+            }
+        }
+    }
+    if (!slot)
+    {
+        // All slots taken: this scope is not counted
+        return;
+    }
+
+    _slot = static_cast<int8_t>(slot - taskSlots);
+    slot->depth++;
+    _start = slot->counters;
+}
+
+int32_t AllocTracker::Scope::getRetainedBytes() const
+{
+    if (_slot < 0)
+    {
+        return 0;
+    }
+    return static_cast<int32_t>(taskSlots[_slot].counters.liveBytes - _start.liveBytes);
+}
+
+AllocTracker::Scope::~Scope()
+{
+    if (_slot < 0)
+    {
+        return;
+    }
+
+    TaskSlot &slot = taskSlots[_slot];
+    const uint64_t allocations = slot.counters.allocations - _start.allocations;
+    const uint64_t bytes = slot.counters.bytes - _start.bytes;
+
+    // Scopes of different tasks can close at the same time
+    portENTER_CRITICAL(&statsMux);
+    SubsystemStats &stats = subsystems[static_cast<uint8_t>(_subsystem)];
+    stats.calls++;
+    stats.allocations += allocations;
+    stats.bytes += bytes;
+    if (allocations > stats.maxAllocationsPerCall)
+    {
+        stats.maxAllocationsPerCall = static_cast<uint32_t>(allocations);
+    }
+    portEXIT_CRITICAL(&statsMux);
+
+    if (--slot.depth == 0)
+    {
+        slot.task.store(0);
+    }
+}
+
+void AllocTracker::onAllocate(size_t size, void *ptr)
+{
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalBytes.fetch_add(size, std::memory_order_relaxed);
+
+    TaskSlot *slot = findTaskSlot(currentTaskKey());
+    if (slot)
+    {
+        slot->counters.allocations++;
+        slot->counters.bytes += size;
+        if (ptr)
+        {
+            slot->counters.liveBytes += blockSize(ptr);
+        }
+    }
+}
+
+void AllocTracker::onFree(size_t blockBytes)
+{
+    totalFrees.fetch_add(1, std::memory_order_relaxed);
+
+    TaskSlot *slot = findTaskSlot(currentTaskKey());
+    if (slot)
+    {
+        slot->counters.frees++;
+        slot->counters.liveBytes -= blockBytes;
+    }
+}
+
+void AllocTracker::loop()
+{
+    const unsigned long now = millis();
+    if (sampleCount == 0 || now - lastSampleMs >= SAMPLE_INTERVAL_MS)
+    {
+        takeSample();
+    }
+}
+
+void AllocTracker::takeSample()
+{
+    const unsigned long now = millis();
+
+    // The first sample after boot (or a reset) only sets the baseline for the rates
+    const bool hasBaseline = sampleCount > 0;
+
+    HeapSample &sample = samples[sampleHead];
+    sample.uptimeSec = now / 1000;
+    sample.freeHeap = ESP.getFreeHeap();
+    sample.largestFreeBlock = ESP.getMaxAllocHeap();
+    sample.freePsram = ESP.getFreePsram();
+    sample.largestFreePsramBlock = ESP.getMaxAllocPsram();
+    sampleHead = (sampleHead + 1) % SAMPLE_COUNT;
+    if (sampleCount < SAMPLE_COUNT)
+    {
+        sampleCount++;
+    }
+
+    const float elapsedSec = (now - lastSampleMs) / 1000.0f;
+    const bool updateRates = hasBaseline && elapsedSec > 0;
+    const uint64_t allocations = totalAllocations.load(std::memory_order_relaxed);
+    if (updateRates)
+    {
+        totalAllocationsPerSec = (allocations - totalAllocationsAtLastSample) / elapsedSec;
+    }
+    totalAllocationsAtLastSample = allocations;
+
+    portENTER_CRITICAL(&statsMux);
+    for (SubsystemStats &stats : subsystems)
+    {
+        if (updateRates)
+        {
+            stats.allocationsPerSec = (stats.allocations - stats.allocationsAtLastSample) / elapsedSec;
+        }
+        stats.allocationsAtLastSample = stats.allocations;
+    }
+    portEXIT_CRITICAL(&statsMux);
+    lastSampleMs = now;
+}
+
+AllocCounters AllocTracker::getTotals()
+{
+    AllocCounters totals;
+    totals.allocations = totalAllocations.load(std::memory_order_relaxed);
+    totals.frees = totalFrees.load(std::memory_order_relaxed);
+    totals.bytes = totalBytes.load(std::memory_order_relaxed);
+    return totals;
+}
+
+AllocTracker::SubsystemStats AllocTracker::getSubsystemStats(AllocSubsystem subsystem)
+{
+    portENTER_CRITICAL(&statsMux);
+    SubsystemStats stats = subsystems[static_cast<uint8_t>(subsystem)];
+    portEXIT_CRITICAL(&statsMux);
+    return stats;
+}
+
+const char *AllocTracker::getSubsystemName(AllocSubsystem subsystem)
+{
+    switch (subsystem)
+    {
+    case AllocSubsystem::MainLoop:
+        return "loop";
+    case AllocSubsystem::WebSocket:
+        return "websocket";
+    case AllocSubsystem::StateChange:
+        return "state-change";
+    case AllocSubsystem::DeviceSetup:
+        return "device-setup";
+    default:
+        return "unknown";
+    }
+}
+
+uint8_t AllocTracker::getFragmentation(uint32_t freeBytes, uint32_t largestFreeBlock)
+{
+    if (freeBytes == 0 || largestFreeBlock >= freeBytes)
+    {
+        return 0;
+    }
+    return static_cast<uint8_t>(100 - (static_cast<uint64_t>(largestFreeBlock) * 100) / freeBytes);
+}
+
+void AllocTracker::toJson(JsonObject obj)
+{
+    obj["uptimeSec"] = millis() / 1000;
+    obj["sampleIntervalSec"] = SAMPLE_INTERVAL_MS / 1000;
+
+    const AllocCounters totals = getTotals();
+    JsonObject totalsObj = obj["totals"].to<JsonObject>();
+    totalsObj["allocations"] = totals.allocations;
+    totalsObj["frees"] = totals.frees;
+    totalsObj["bytes"] = totals.bytes;
+    totalsObj["allocationsPerSec"] = totalAllocationsPerSec;
+
+    JsonArray subsystemsArr = obj["subsystems"].to<JsonArray>();
+    for (uint8_t i = 0; i < static_cast<uint8_t>(AllocSubsystem::Count); i++)
+    {
+        const AllocSubsystem subsystem = static_cast<AllocSubsystem>(i);
+        const SubsystemStats stats = getSubsystemStats(subsystem);
+        JsonObject subsystemObj = subsystemsArr.add<JsonObject>();
+        subsystemObj["name"] = getSubsystemName(subsystem);
+        subsystemObj["calls"] = stats.calls;
+        subsystemObj["allocations"] = stats.allocations;
+        subsystemObj["bytes"] = stats.bytes;
+        subsystemObj["avgAllocationsPerCall"] = stats.calls ? static_cast<float>(stats.allocations) / stats.calls : 0.0f;
+        subsystemObj["maxAllocationsPerCall"] = stats.maxAllocationsPerCall;
+        subsystemObj["allocationsPerSec"] = stats.allocationsPerSec;
+    }
+
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    const uint32_t largestFreeBlock = ESP.getMaxAllocHeap();
+    const uint32_t freePsram = ESP.getFreePsram();
+    const uint32_t largestFreePsramBlock = ESP.getMaxAllocPsram();
+    JsonObject heapObj = obj["heap"].to<JsonObject>();
+    heapObj["free"] = freeHeap;
+    heapObj["minFree"] = ESP.getMinFreeHeap();
+    heapObj["largestFreeBlock"] = largestFreeBlock;
+    heapObj["fragmentation"] = getFragmentation(freeHeap, largestFreeBlock);
+    heapObj["freePsram"] = freePsram;
+    heapObj["largestFreePsramBlock"] = largestFreePsramBlock;
+    heapObj["psramFragmentation"] = getFragmentation(freePsram, largestFreePsramBlock);
+
+    // Oldest sample first
+    JsonArray samplesArr = obj["samples"].to<JsonArray>();
+    const uint8_t first = (sampleHead + SAMPLE_COUNT - sampleCount) % SAMPLE_COUNT;
+    for (uint8_t i = 0; i < sampleCount; i++)
+    {
+        const HeapSample &sample = samples[(first + i) % SAMPLE_COUNT];
+        JsonObject sampleObj = samplesArr.add<JsonObject>();
+        sampleObj["t"] = sample.uptimeSec;
+        sampleObj["free"] = sample.freeHeap;
+        sampleObj["largest"] = sample.largestFreeBlock;
+        sampleObj["fragmentation"] = getFragmentation(sample.freeHeap, sample.largestFreeBlock);
+        sampleObj["freePsram"] = sample.freePsram;
+        sampleObj["largestPsram"] = sample.largestFreePsramBlock;
+    }
+}
+
+void AllocTracker::reset()
+{
+    totalAllocations.store(0);
+    totalFrees.store(0);
+    totalBytes.store(0);
+
+    portENTER_CRITICAL(&statsMux);
+    for (SubsystemStats &stats : subsystems)
+    {
+        stats = SubsystemStats();
+    }
+    portEXIT_CRITICAL(&statsMux);
+
+    sampleCount = 0;
+    sampleHead = 0;
+    lastSampleMs = millis();
+    totalAllocationsAtLastSample = 0;
+    totalAllocationsPerSec = 0;
+}
+
+// Allocator hooks
+#ifndef MARBLE_NATIVE
+
+// The ESP32 build links with -Wl,--wrap=<fn> so every call lands here first
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+    void __real_free(void *ptr);
+
+    void *__wrap_malloc(size_t size)
+    {
+        void *ptr = __real_malloc(size);
+        AllocTracker::onAllocate(size, ptr);
+        return ptr;
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        void *ptr = __real_calloc(count, size);
+        AllocTracker::onAllocate(count * size, ptr);
+        return ptr;
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        // The old block's size has to be read while it is still allocated
+        const size_t freedBytes = ptr ? blockSize(ptr) : 0;
+        void *moved = __real_realloc(ptr, size);
+        // A failed realloc leaves ptr allocated; realloc(ptr, 0) frees it and returns NULL
+        if (ptr && (moved || size == 0))
+        {
+            AllocTracker::onFree(freedBytes);
+        }
+        if (moved)
+        {
+            AllocTracker::onAllocate(size, moved);
+        }
+        return moved;
+    }
+
+    void __wrap_free(void *ptr)
+    {
+        if (ptr)
+        {
+            AllocTracker::onFree(blockSize(ptr));
+        }
+        __real_free(ptr);
+    }
+}
+
+#elif defined(__GLIBC__)
+
+// Native build: interpose the libc allocator and forward to its internal entry points
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t count, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+    void __libc_free(void *ptr);
+
+    void *malloc(size_t size)
+    {
+        void *ptr = __libc_malloc(size);
+        AllocTracker::onAllocate(size, ptr);
+        return ptr;
+    }
+
+    void *calloc(size_t count, size_t size)
+    {
+        void *ptr = __libc_calloc(count, size);
+        AllocTracker::onAllocate(count * size, ptr);
+        return ptr;
+    }
+
+    void *realloc(void *ptr, size_t size)
+    {
+        // The old block's size has to be read while it is still allocated
+        const size_t freedBytes = ptr ? blockSize(ptr) : 0;
+        void *moved = __libc_realloc(ptr, size);
+        // A failed realloc leaves ptr allocated; realloc(ptr, 0) frees it and returns NULL
+        if (ptr && (moved || size == 0))
+        {
+            AllocTracker::onFree(freedBytes);
+        }
+        if (moved)
+        {
+            AllocTracker::onAllocate(size, moved);
+        }
+        return moved;
+    }
+
+    void free(void *ptr)
+    {
+        if (ptr)
+        {
+            AllocTracker::onFree(blockSize(ptr));
+        }
+        __libc_free(ptr);
+    }
+}
+
+#endif
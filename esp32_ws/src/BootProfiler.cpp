@@ -0,0 +1,110 @@
+#include "BootProfiler.h"
+
+#ifndef MARBLE_NATIVE
+#include <esp_system.h>
+#endif
+
+// Initialize static members
+BootProfiler::PhaseRecord BootProfiler::phases[BootProfiler::MAX_PHASES];
+uint8_t BootProfiler::phaseCount = 0;
+uint8_t BootProfiler::depth = 0;
+uint32_t BootProfiler::totalUs = 0;
+uint32_t BootProfiler::droppedCount = 0;
+bool BootProfiler::finished = false;
+
+BootProfiler::Phase::Phase(const char *name, const String &detail) : _index(-1)
+{
+    if (finished)
+    {
+        return;
+    }
+    if (phaseCount >= MAX_PHASES)
+    {
+        droppedCount++;
+        return;
+    }
+
+    _index = phaseCount++;
+    PhaseRecord &record = phases[_index];
+    record.name = name;
+    record.detail = detail;
+    record.depth = depth++;
+    record.startUs = micros();
+}
+
+BootProfiler::Phase::~Phase()
+{
+    if (_index < 0)
+    {
+        return;
+    }
+    PhaseRecord &record = phases[_index];
+    record.durationUs = micros() - record.startUs;
+    depth--;
+}
+
+void BootProfiler::finish()
+{
+    if (finished)
+    {
+        return;
+    }
+    totalUs = micros();
+    finished = true;
+}
+
+const char *BootProfiler::getResetReason()
+{
+#ifdef MARBLE_NATIVE
+    return "power-on";
+#else
+    switch (esp_reset_reason())
+    {
+    case ESP_RST_POWERON:
+        return "power-on";
+    case ESP_RST_EXT:
+        return "external";
+    case ESP_RST_SW:
+        return "software";
+    case ESP_RST_PANIC:
+        return "panic";
+    case ESP_RST_INT_WDT:
+        return "interrupt-watchdog";
+    case ESP_RST_TASK_WDT:
+        return "task-watchdog";
+    case ESP_RST_WDT:
+        return "watchdog";
+    case ESP_RST_DEEPSLEEP:
+        return "deep-sleep";
+    case ESP_RST_BROWNOUT:
+        return "brownout";
+    case ESP_RST_SDIO:
+        return "sdio";
+    default:
+        return "unknown";
+    }
+#endif
+}
+
+void BootProfiler::toJson(JsonObject obj)
+{
+    obj["resetReason"] = getResetReason();
+    obj["finished"] = finished;
+    obj["totalUs"] = totalUs;
+    obj["dropped"] = droppedCount;
+
+    JsonArray phasesArr = obj["phases"].to<JsonArray>();
+    for (uint8_t i = 0; i < phaseCount; i++)
+    {
+        const PhaseRecord &record = phases[i];
+        JsonObject phaseObj = phasesArr.add<JsonObject>();
+        phaseObj["name"] = record.name;
+        if (record.detail.length() > 0)
+        {
+            phaseObj["detail"] = record.detail;
+        }
+        phaseObj["depth"] = record.depth;
+        phaseObj["startUs"] = record.startUs;
+        phaseObj["durationUs"] = record.durationUs;
+    }
+}
@@ -4,6 +4,8 @@
 #include <functional>
 #include "LittleFS.h"
 #include "Logging.h"
+#include "AllocTracker.h"
+#include "BootProfiler.h"
 #include "DeviceManager.h"
 #include "devices/Led.h"
 #include "devices/Button.h"
@@ -186,12 +188,16 @@ void DeviceManager::loadDevicesFromJsonFile()
     {
         const String id = deviceObj["id"] | "";
         const String type = deviceObj["type"] | "";
+
+        // Heap kept by the device and its children once created and configured
+        AllocTracker::Scope allocScope(AllocSubsystem::DeviceSetup);
         Device *newDevice = createDevice(id, type);
         if (newDevice)
         {
             // Disable this if esp32 keeps rebooting due to config error
             loadDeviceConfigFromJson(newDevice, deviceObj);
             addDevice(newDevice);
+            newDevice->addHeapBytes(allocScope.getRetainedBytes());
             roots++;
         }
     }
@@ -214,6 +220,9 @@ void DeviceManager::loadDevicesFromJsonFile()
  */
 void DeviceManager::saveDevicesToJsonFile()
 {
+    // Saving follows every config change
+    devicesVersion++;
+
     // First, read the existing configuration to preserve other properties
     // like network settings
     JsonDocument doc;
@@ -546,6 +555,7 @@ bool DeviceManager::addDevice(Device *device)
     {
         devices[devicesCount] = device;
         devicesCount++;
+        devicesVersion++;
         MLOG_DEBUG("Added device: %s", device->toString().c_str());
         return true;
     }
@@ -575,6 +585,7 @@ bool DeviceManager::addDevice(const String &deviceType, const String &deviceId,
         return false;
     }
 
+    AllocTracker::Scope allocScope(AllocSubsystem::DeviceSetup);
     Device *newDevice = createDevice(deviceId, deviceType);
 
     if (!newDevice)
@@ -597,6 +608,7 @@ bool DeviceManager::addDevice(const String &deviceType, const String &deviceId,
         }
     }
 
+    newDevice->addHeapBytes(allocScope.getRetainedBytes());
     devices[devicesCount] = newDevice;
     devicesCount++;
 
@@ -624,13 +636,23 @@ void DeviceManager::setup()
     {
         if (devices[i])
         {
-            devices[i]->setup();
+            setupDevice(devices[i]);
         }
     }
     MLOG_DEBUG("DeviceManager setup ended");
     MLOG_DEBUG("-----------------------");
 }
 
+void DeviceManager::setupDevice(Device *device)
+{
+    BootProfiler::Phase bootPhase("device", device->getId());
+
+    // Includes the stacks of tasks the device starts
+    AllocTracker::Scope allocScope(AllocSubsystem::DeviceSetup);
+    device->setup();
+    device->setSetupHeapBytes(allocScope.getRetainedBytes());
+}
+
 void DeviceManager::teardown()
 {
     for (int i = devicesCount - 1; i >= 0; i--)
@@ -648,11 +670,20 @@ void DeviceManager::loop()
     {
         if (devices[i] != nullptr)
         {
-            devices[i]->loop();
+            devices[i]->runLoop();
         }
     }
 }
 
+void DeviceManager::resetLoopStats()
+{
+    for (Device *device : getAllDevices())
+    {
+        device->resetLoopStats();
+    }
+    LoopProfiler::reset();
+}
+
 Device *DeviceManager::getDeviceById(const String &deviceId) const
 {
     for (int i = 0; i < devicesCount; i++)
@@ -667,6 +698,18 @@ Device *DeviceManager::getDeviceById(const String &deviceId) const
     return nullptr;
 }
 
+Device *DeviceManager::getRootDeviceOf(const String &deviceId) const
+{
+    for (int i = 0; i < devicesCount; i++)
+    {
+        if (devices[i] != nullptr && findDeviceRecursiveById(devices[i], deviceId))
+        {
+            return devices[i];
+        }
+    }
+    return nullptr;
+}
+
 Device *DeviceManager::findDeviceRecursiveById(Device *root, const String &deviceId) const
 {
     if (!root)
@@ -727,6 +770,7 @@ bool DeviceManager::removeDevice(const String &deviceId)
             }
             devices[devicesCount - 1] = nullptr;
             devicesCount--;
+            devicesVersion++;
 
             return true;
         }
@@ -793,6 +837,7 @@ bool DeviceManager::reorderDevices(const std::vector<String> &deviceIds)
     {
         devices[i] = reordered[i];
     }
+    devicesVersion++;
 
     MLOG_INFO("Devices reordered successfully");
     return true;
@@ -0,0 +1,94 @@
+#include "LoopStats.h"
+
+// Initialize static members
+LoopStats LoopProfiler::mainLoopPeriod;
+LoopStats LoopProfiler::mainLoopDuration;
+uint32_t LoopProfiler::loopStartUs = 0;
+bool LoopProfiler::hasPreviousStart = false;
+
+void LoopStats::record(uint32_t durationUs)
+{
+    _count++;
+    _total += durationUs;
+    if (durationUs < _min)
+    {
+        _min = durationUs;
+    }
+    if (durationUs > _max)
+    {
+        _max = durationUs;
+    }
+
+    uint8_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && durationUs >= (1UL << bucket))
+    {
+        bucket++;
+    }
+    _buckets[bucket]++;
+}
+
+void LoopStats::reset()
+{
+    *this = LoopStats();
+}
+
+uint32_t LoopStats::getPercentile(uint8_t percent) const
+{
+    if (_count == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the sample we are looking for (1-based, rounded up)
+    const uint64_t rank = (static_cast<uint64_t>(_count) * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (uint8_t bucket = 0; bucket < BUCKET_COUNT; bucket++)
+    {
+        seen += _buckets[bucket];
+        if (seen >= rank && seen > 0)
+        {
+            if (bucket == BUCKET_COUNT - 1)
+            {
+                return _max;
+            }
+            const uint32_t upperBound = (1UL << bucket) - 1;
+            return upperBound < _max ? upperBound : _max;
+        }
+    }
+    return _max;
+}
+
+void LoopStats::toJson(JsonObject obj) const
+{
+    obj["count"] = _count;
+    obj["min"] = getMin();
+    obj["avg"] = getAverage();
+    obj["max"] = _max;
+    obj["p99"] = getPercentile(99);
+}
+
+void LoopProfiler::beginMainLoop()
+{
+    const uint32_t now = micros();
+    if (hasPreviousStart)
+    {
+        mainLoopPeriod.record(now - loopStartUs);
+    }
+    loopStartUs = now;
+    hasPreviousStart = true;
+}
+
+void LoopProfiler::endMainLoop()
+{
+    if (hasPreviousStart)
+    {
+        mainLoopDuration.record(micros() - loopStartUs);
+    }
+}
+
+void LoopProfiler::reset()
+{
+    mainLoopPeriod.reset();
+    mainLoopDuration.reset();
+    hasPreviousStart = false;
+}
@@ -100,6 +100,7 @@ bool Network::startAccessPoint()
 
 void Network::setupMDNS()
 {
+#ifdef ESP32
     // Start mDNS responder for marble-track.local using ESP-IDF mDNS
     if (mdns_init() == ESP_OK)
     {
@@ -127,6 +128,7 @@ void Network::setupMDNS()
     {
         MLOG_ERROR("mDNS: initialization failed");
     }
+#endif
 }
 
 String Network::getConnectionInfo() const
@@ -161,47 +163,41 @@ IPAddress Network::getIPAddress() const
     }
 }
 
-String Network::getStatusJSON() const
+void Network::addStatusToJson(JsonObject obj) const
 {
-    JsonDocument doc;
-
     // Mode information
     switch (_currentMode)
     {
     case NetworkMode::WIFI_CLIENT:
     {
-        doc["mode"] = "client";
-        doc["connected"] = true;
-        doc["ssid"] = _wifi_ssid;
-        doc["ip"] = WiFi.localIP().toString();
+        obj["mode"] = "client";
+        obj["connected"] = true;
+        obj["ssid"] = _wifi_ssid;
+        obj["ip"] = WiFi.localIP().toString();
         const int rssi = WiFi.RSSI();
-        doc["rssi"] = rssi;
+        obj["rssi"] = rssi;
         break;
     }
 
     case NetworkMode::ACCESS_POINT:
     {
-        doc["mode"] = "ap";
-        doc["connected"] = true;
-        doc["ssid"] = AP_SSID;
-        doc["ip"] = WiFi.softAPIP().toString();
+        obj["mode"] = "ap";
+        obj["connected"] = true;
+        obj["ssid"] = AP_SSID;
+        obj["ip"] = WiFi.softAPIP().toString();
         const int clients = WiFi.softAPgetStationNum();
-        doc["clients"] = clients;
+        obj["clients"] = clients;
         break;
     }
 
     case NetworkMode::DISCONNECTED:
     default:
-        doc["mode"] = "disconnected";
-        doc["connected"] = false;
-        doc["ssid"] = "";
-        doc["ip"] = "0.0.0.0";
+        obj["mode"] = "disconnected";
+        obj["connected"] = false;
+        obj["ssid"] = "";
+        obj["ip"] = "0.0.0.0";
         break;
     }
-
-    String json;
-    serializeJson(doc, json);
-    return json;
 }void Network::processCaptivePortal()
 {
     if (_currentMode == NetworkMode::ACCESS_POINT && _dnsServer != nullptr)
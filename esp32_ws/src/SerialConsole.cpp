@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <map>
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 
@@ -9,6 +10,10 @@
 #include "Network.h"
 #include "WebSocketManager.h"
 #include "Logging.h"
+#include "AllocTracker.h"
+#include "BootProfiler.h"
+#include "LoopStats.h"
+#include "WsCapture.h"
 #include "devices/Device.h"
 
 SerialConsole::SerialConsole(DeviceManager &deviceManager, Network *&networkRef, WebSocketManager *wsManager)
@@ -79,7 +84,7 @@ void SerialConsole::loop()
 
             if (input.length() == 0)
             {
-                Serial.println("💡 Commands: 'devices', 'network', 'memory', 'config', 'version', 'logging', 'restart', 'test-pin'");
+                Serial.println("💡 Commands: 'devices', 'network', 'memory', 'config', 'version', 'logging', 'loop-stats', 'alloc-stats', 'boot-stats', 'ws-capture', 'restart', 'test-pin'");
                 Serial.println();
                 continue;
             }
@@ -203,6 +208,85 @@ void SerialConsole::handleCommand(const String &input)
         return;
     }
 
+    if (input.equalsIgnoreCase("loop-stats"))
+    {
+        logLoopStats();
+        Serial.println("  • Type 'loop-stats-reset' to start a new measurement window.");
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("loop-stats-reset"))
+    {
+        m_deviceManager.resetLoopStats();
+        Serial.println("⏱️  Loop stats reset.");
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("boot-stats"))
+    {
+        logBootStats();
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("alloc-stats"))
+    {
+        logAllocStats();
+        Serial.println("  • Type 'alloc-stats-reset' to start a new measurement window.");
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("alloc-stats-reset"))
+    {
+        AllocTracker::reset();
+        Serial.println("🧮 Allocation stats reset.");
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("ws-capture"))
+    {
+        if (WsCapture::isActive())
+        {
+            Serial.printf("🎙️  Capturing WebSocket traffic to %s: %u records, %u dropped\n", WsCapture::getPath().c_str(),
+                          WsCapture::getRecordedCount(), WsCapture::getDroppedCount());
+            Serial.println("  • Type 'ws-capture-stop' to finish the capture.");
+        }
+        else
+        {
+            Serial.println("🎙️  WebSocket capture is off.");
+            Serial.printf("  • Type 'ws-capture-start' to record inbound traffic to %s.\n", WsCapture::DEFAULT_PATH);
+        }
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("ws-capture-start"))
+    {
+        if (WsCapture::start())
+        {
+            Serial.printf("🎙️  Capturing WebSocket traffic to %s.\n", WsCapture::getPath().c_str());
+        }
+        else
+        {
+            Serial.println("❌ Could not create the capture file.");
+        }
+        Serial.println();
+        return;
+    }
+
+    if (input.equalsIgnoreCase("ws-capture-stop"))
+    {
+        WsCapture::stop();
+        Serial.printf("🎙️  Capture stopped: %u records in %s, %u dropped.\n", WsCapture::getRecordedCount(),
+                      WsCapture::getPath().c_str(), WsCapture::getDroppedCount());
+        Serial.println();
+        return;
+    }
+
     if (input.equalsIgnoreCase("version"))
     {
         Serial.println("🏗️  Build Information:");
@@ -531,6 +615,123 @@ void SerialConsole::logNetworkInfo()
     Serial.println();
 }
 
+void SerialConsole::logLoopStats()
+{
+    const LoopStats &period = LoopProfiler::getMainLoopPeriod();
+    const LoopStats &duration = LoopProfiler::getMainLoopDuration();
+
+    Serial.println("⏱️  Loop Timing (µs):");
+    Serial.printf("   🔁 Main loop period:   avg %u | p99 %u | max %u (%u iterations)\n",
+                  period.getAverage(), period.getPercentile(99), period.getMax(), period.getCount());
+    Serial.printf("   ⚙️  Main loop duration: avg %u | p99 %u | max %u\n",
+                  duration.getAverage(), duration.getPercentile(99), duration.getMax());
+    Serial.println();
+
+    std::vector<Device *> allDevices = m_deviceManager.getAllDevices();
+    if (allDevices.empty())
+    {
+        Serial.println("  No devices found");
+        return;
+    }
+
+    Serial.printf("   %-28s %8s %8s %8s   %8s %8s %8s\n", "Device", "self avg", "self p99", "self max", "tot avg", "tot p99", "tot max");
+
+    // getAllDevices() is depth-first, so a parent is always listed before its children
+    std::map<Device *, int> depth;
+    for (Device *device : allDevices)
+    {
+        const int level = depth[device];
+        for (Device *child : device->getChildren())
+        {
+            depth[child] = level + 1;
+        }
+
+        String label;
+        for (int i = 0; i < level; i++)
+        {
+            label += "  ";
+        }
+        label += device->getId();
+
+        const LoopStats &self = device->getSelfLoopStats();
+        const LoopStats &total = device->getLoopStats();
+        Serial.printf("   %-28s %8u %8u %8u   %8u %8u %8u\n", label.c_str(),
+                      self.getAverage(), self.getPercentile(99), self.getMax(),
+                      total.getAverage(), total.getPercentile(99), total.getMax());
+    }
+}
+
+void SerialConsole::logBootStats()
+{
+    Serial.printf("🚀 Boot Timing (reset reason: %s):\n", BootProfiler::getResetReason());
+    if (!BootProfiler::isFinished())
+    {
+        Serial.println("   Boot still in progress");
+        return;
+    }
+
+    Serial.printf("   %-36s %10s %10s\n", "Phase", "start ms", "took ms");
+    for (uint8_t i = 0; i < BootProfiler::getPhaseCount(); i++)
+    {
+        const BootProfiler::PhaseRecord &phase = BootProfiler::getPhase(i);
+        String label;
+        for (uint8_t level = 0; level < phase.depth; level++)
+        {
+            label += "  ";
+        }
+        label += phase.name;
+        if (phase.detail.length() > 0)
+        {
+            label += " ";
+            label += phase.detail;
+        }
+        Serial.printf("   %-36s %10.1f %10.1f\n", label.c_str(), phase.startUs / 1000.0f, phase.durationUs / 1000.0f);
+    }
+    if (BootProfiler::getDroppedCount() > 0)
+    {
+        Serial.printf("   (%u phases not recorded)\n", BootProfiler::getDroppedCount());
+    }
+    Serial.printf("   ✅ setup() done after %.1f ms\n", BootProfiler::getTotalUs() / 1000.0f);
+}
+
+void SerialConsole::logAllocStats()
+{
+    const AllocCounters totals = AllocTracker::getTotals();
+    Serial.println("🧮 Heap Allocations:");
+    Serial.printf("   📦 Total: %llu allocs | %llu frees | %llu bytes\n",
+                  static_cast<unsigned long long>(totals.allocations), static_cast<unsigned long long>(totals.frees),
+                  static_cast<unsigned long long>(totals.bytes));
+    Serial.printf("   %-14s %10s %12s %14s %10s %10s\n", "Subsystem", "calls", "allocs", "bytes", "avg/call", "allocs/s");
+    for (uint8_t i = 0; i < static_cast<uint8_t>(AllocSubsystem::Count); i++)
+    {
+        const AllocSubsystem subsystem = static_cast<AllocSubsystem>(i);
+        const AllocTracker::SubsystemStats stats = AllocTracker::getSubsystemStats(subsystem);
+        Serial.printf("   %-14s %10u %12llu %14llu %10.1f %10.1f\n", AllocTracker::getSubsystemName(subsystem),
+                      stats.calls, static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.bytes),
+                      stats.calls ? static_cast<float>(stats.allocations) / stats.calls : 0.0f, stats.allocationsPerSec);
+    }
+    Serial.println();
+
+    const uint32_t freeHeap = ESP.getFreeHeap();
+    const uint32_t largestBlock = ESP.getMaxAllocHeap();
+    const uint32_t freePsram = ESP.getFreePsram();
+    const uint32_t largestPsramBlock = ESP.getMaxAllocPsram();
+    Serial.printf("   🧩 Heap:  %u free | largest block %u | fragmentation %u%%\n",
+                  freeHeap, largestBlock, AllocTracker::getFragmentation(freeHeap, largestBlock));
+    Serial.printf("   🧩 PSRAM: %u free | largest block %u | fragmentation %u%%\n",
+                  freePsram, largestPsramBlock, AllocTracker::getFragmentation(freePsram, largestPsramBlock));
+    Serial.println();
+
+    Device *roots[DeviceManager::MAX_DEVICES];
+    int count = 0;
+    m_deviceManager.getDevices(roots, count, DeviceManager::MAX_DEVICES);
+    Serial.println("   Heap per device (kept since creation and setup, children included):");
+    for (int i = 0; i < count; i++)
+    {
+        Serial.printf("   %-28s %-18s %8d bytes\n", roots[i]->getId().c_str(), roots[i]->getType().c_str(), roots[i]->getHeapBytes());
+    }
+}
+
 void SerialConsole::startSetNetworkFlow()
 {
     m_session.reset();
@@ -717,9 +918,9 @@ void SerialConsole::saveAndApplyNetworkSettings()
 
 void SerialConsole::startDeleteDeviceFlow()
 {
-    Device *deviceList[20];
+    Device *deviceList[DeviceManager::MAX_DEVICES];
     int deviceCount = 0;
-    m_deviceManager.getDevices(deviceList, deviceCount, 20);
+    m_deviceManager.getDevices(deviceList, deviceCount, DeviceManager::MAX_DEVICES);
 
     Serial.println();
 
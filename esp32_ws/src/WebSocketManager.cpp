@@ -1,6 +1,13 @@
+#include "AllocTracker.h"
 #include "Logging.h"
+#include "LoopStats.h"
+#include "BootProfiler.h"
 #include <LittleFS.h>
+#include <algorithm>
 #include "WebSocketManager.h"
+#include "WsCapture.h"
+#include "WsMessageRegistry.h"
+#include "devices/mixins/ControllableMixin.h"
 #include "devices/mixins/IControllable.h"
 #include "devices/mixins/SerializableMixin.h"
 #include "devices/Led.h"
@@ -17,20 +24,249 @@ static WebSocketManager *instance = nullptr;
 namespace
 {
     constexpr size_t kMaxQueuedBatchMessages = 64;
+    constexpr uint32_t kMaxTelemetryHz = 50;
+
+    // Per-client outbound queue, on top of the socket's own queue
+    constexpr size_t kMaxOutboxFrames = 32;
+    constexpr size_t kMaxOutboxBytes = 16 * 1024;
+
+    // Largest inbound message; a set-devices-config upload of config.json is ~7 KB
+    constexpr size_t kMaxMessageBytes = 32 * 1024;
+
+    // Inbound messages waiting for the command task; the stack matches the async_tcp task handlers used to run on
+    constexpr UBaseType_t kCommandQueueLength = 16;
+    constexpr uint32_t kCommandTaskStack = 8192;
+
+    // How long a new client that sends nothing gets to resume before it is sent the snapshot
+    constexpr uint32_t kSnapshotWaitMs = 500;
+
+    void encodeMsgPack(const JsonDocument &doc, std::vector<uint8_t> &out)
+    {
+        out.resize(measureMsgPack(doc));
+        serializeMsgPack(doc, out.data(), out.size());
+    }
+
+    /**
+     * @brief Print that appends to a byte vector
+     */
+    class VectorPrint : public Print
+    {
+    public:
+        explicit VectorPrint(std::vector<uint8_t> &out) : _out(out) {}
+
+        size_t write(uint8_t c) override
+        {
+            _out.push_back(c);
+            return 1;
+        }
+
+        size_t write(const uint8_t *buffer, size_t size) override
+        {
+            _out.insert(_out.end(), buffer, buffer + size);
+            return size;
+        }
+
+    private:
+        std::vector<uint8_t> &_out;
+    };
+
+    /**
+     * @brief Write value as a quoted, escaped JSON string
+     */
+    void writeJsonString(Print &out, const String &value)
+    {
+        out.print('"');
+        for (size_t i = 0; i < value.length(); i++)
+        {
+            const char c = value[i];
+            if (c == '"' || c == '\\')
+            {
+                out.print('\\');
+                out.print(c);
+            }
+            else if (static_cast<uint8_t>(c) < 0x20)
+            {
+                char escaped[7];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                out.print(escaped);
+            }
+            else
+            {
+                out.print(c);
+            }
+        }
+        out.print('"');
+    }
+
+    void writeJsonStrings(Print &out, const std::vector<String> &values)
+    {
+        out.print('[');
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            if (i > 0)
+            {
+                out.print(',');
+            }
+            writeJsonString(out, values[i]);
+        }
+        out.print(']');
+    }
+
+    /**
+     * @brief {"seq":N followed by the members of json, a serialized object
+     */
+    String stampSeq(const String &json, uint32_t seq)
+    {
+        char prefix[WsHistory::kSeqPrefixSize];
+        const size_t prefixLength = WsHistory::formatSeqPrefix(prefix, seq);
+        String stamped;
+        stamped.reserve(prefixLength + json.length());
+        stamped += prefix;
+        if (json.length() > 2)
+        {
+            stamped += ',';
+        }
+        stamped += json.c_str() + 1;
+        return stamped;
+    }
+
+    void appendMsgPackMapHeader(std::vector<uint8_t> &out, size_t count)
+    {
+        if (count < 16)
+        {
+            out.push_back(static_cast<uint8_t>(0x80 | count)); // fixmap
+        }
+        else if (count <= 0xFFFF)
+        {
+            out.push_back(0xDE); // map 16
+            out.push_back(static_cast<uint8_t>(count >> 8));
+            out.push_back(static_cast<uint8_t>(count));
+        }
+        else
+        {
+            out.push_back(0xDF); // map 32
+            for (int shift = 24; shift >= 0; shift -= 8)
+            {
+                out.push_back(static_cast<uint8_t>(count >> shift));
+            }
+        }
+    }
+
+    /**
+     * @brief Put "seq" in front of the members of an encoded MessagePack map
+     */
+    void stampMsgPackSeq(std::vector<uint8_t> &msgpack, uint32_t seq)
+    {
+        size_t count;
+        size_t headerLength;
+        if ((msgpack[0] & 0xF0) == 0x80)
+        {
+            count = msgpack[0] & 0x0F;
+            headerLength = 1;
+        }
+        else if (msgpack[0] == 0xDE)
+        {
+            count = (msgpack[1] << 8) | msgpack[2];
+            headerLength = 3;
+        }
+        else if (msgpack[0] == 0xDF)
+        {
+            count = (static_cast<size_t>(msgpack[1]) << 24) | (msgpack[2] << 16) | (msgpack[3] << 8) | msgpack[4];
+            headerLength = 5;
+        }
+        else
+        {
+            return;
+        }
+
+        std::vector<uint8_t> stamped;
+        stamped.reserve(msgpack.size() + 13);
+        appendMsgPackMapHeader(stamped, count + 1);
+        stamped.insert(stamped.end(), {0xA3, 's', 'e', 'q', 0xCE}); // fixstr "seq", uint 32
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            stamped.push_back(static_cast<uint8_t>(seq >> shift));
+        }
+        stamped.insert(stamped.end(), msgpack.begin() + headerLength, msgpack.end());
+        msgpack.swap(stamped);
+    }
+
+    void appendMsgPackArrayHeader(std::vector<uint8_t> &out, size_t count)
+    {
+        if (count < 16)
+        {
+            out.push_back(static_cast<uint8_t>(0x90 | count)); // fixarray
+        }
+        else if (count <= 0xFFFF)
+        {
+            out.push_back(0xDC); // array 16
+            out.push_back(static_cast<uint8_t>(count >> 8));
+            out.push_back(static_cast<uint8_t>(count));
+        }
+        else
+        {
+            out.push_back(0xDD); // array 32
+            for (int shift = 24; shift >= 0; shift -= 8)
+            {
+                out.push_back(static_cast<uint8_t>(count >> shift));
+            }
+        }
+    }
+
+    /**
+     * @brief What clients see of a device: its pins (in devices-list), config and state
+     */
+    struct DeviceOutput
+    {
+        Device *device;
+        std::vector<String> pins;
+        String config;
+        JsonDocument state;
+    };
+
+    DeviceOutput captureOutput(Device *device)
+    {
+        DeviceOutput output;
+        output.device = device;
+        output.pins = device->getPins();
+        ISerializable *serializable = mixins::SerializableRegistry::get(device->getId());
+        if (serializable)
+        {
+            JsonDocument config;
+            serializable->configToJson(config);
+            serializeJson(config, output.config);
+        }
+        IControllable *ctrl = mixins::ControllableRegistry::get(device->getId());
+        if (ctrl)
+        {
+            ctrl->addStateToJson(output.state);
+        }
+        return output;
+    }
+
+    void captureOutputs(Device *device, std::vector<DeviceOutput> &outputs)
+    {
+        outputs.push_back(captureOutput(device));
+        for (Device *child : device->getChildren())
+        {
+            if (child)
+            {
+                captureOutputs(child, outputs);
+            }
+        }
+    }
 }
 
-String createJsonResponse(bool success, const String &message, const String &data, const String &requestId, const String &type = "", const String &deviceId = "")
+/**
+ * @brief Build a {success, message, type, deviceId} reply; handlers may add fields before sending it
+ */
+JsonDocument createJsonResponse(bool success, const String &message, const char *type = "", const String &deviceId = "")
 {
     JsonDocument response;
     response["success"] = success;
     response["message"] = message;
 
-    if (requestId.length() > 0)
-    {
-        response["requestId"] = requestId;
-    }
-
-    if (type.length() > 0)
+    if (*type != '\0')
     {
         response["type"] = type;
     }
@@ -40,19 +276,10 @@ String createJsonResponse(bool success, const String &message, const String &dat
         response["deviceId"] = deviceId;
     }
 
-    if (data.length() > 0)
-    {
-        JsonDocument dataDoc;
-        deserializeJson(dataDoc, data);
-        response["data"] = dataDoc;
-    }
-
-    String jsonString;
-    serializeJson(response, jsonString);
-    return jsonString;
+    return response;
 }
 
-void WebSocketManager::handleGetExpanderAddresses(JsonDocument &doc)
+void WebSocketManager::handleGetExpanderAddresses(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -65,9 +292,7 @@ void WebSocketManager::handleGetExpanderAddresses(JsonDocument &doc)
     if (i2cDeviceId.isEmpty())
     {
         response["error"] = "No I2C device ID specified";
-        String message;
-        serializeJson(response, message);
-        notifyClients(message);
+        reply(request, response);
         return;
     }
 
@@ -81,9 +306,7 @@ void WebSocketManager::handleGetExpanderAddresses(JsonDocument &doc)
     if (!i2cDevice)
     {
         response["error"] = "I2C device not found: " + i2cDeviceId;
-        String message;
-        serializeJson(response, message);
-        notifyClients(message);
+        reply(request, response);
         return;
     }
 
@@ -92,9 +315,7 @@ void WebSocketManager::handleGetExpanderAddresses(JsonDocument &doc)
     if (i2cPins.size() < 2)
     {
         response["error"] = "I2C device not properly configured";
-        String message;
-        serializeJson(response, message);
-        notifyClients(message);
+        reply(request, response);
         return;
     }
 
@@ -122,223 +343,502 @@ void WebSocketManager::handleGetExpanderAddresses(JsonDocument &doc)
         }
     }
 
-    String message;
-    serializeJson(response, message);
     MLOG_INFO("Found %d I2C devices on bus '%s' (SDA=%d, SCL=%d)", deviceCount, i2cDeviceId.c_str(), sdaPin, sclPin);
-    notifyClients(message);
+    reply(request, response);
 }
 
-void WebSocketManager::handleGetDevices(JsonDocument &doc)
+void WebSocketManager::handleGetDevices(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
+    {
+        if (request.clientId == 0)
+        {
+            history.skip();
+        }
         return;
-
-    StaticJsonDocument<8192> response; // Allocate 8KB for device list
-    response["type"] = "devices-list";
+    }
 
     if (!deviceManager)
     {
+        JsonDocument response;
+        response["type"] = "devices-list";
         response["error"] = "DeviceManager not available";
+        reply(request, response);
+        return;
     }
-    else
-    {
-        // Get devices from DeviceManager
-        Device *deviceList[20];
-        int count;
-        deviceManager->getDevices(deviceList, count, 20);
-
-        // Create devices array in JSON
-        JsonArray devicesArray = response["devices"].to<JsonArray>();
-
-        for (int i = 0; i < count; i++)
-        {
-            if (deviceList[i] != nullptr)
-            {
-                // Skip devices that are single children (have exactly one child with no children)
-                auto children = deviceList[i]->getChildren();
-                bool isSingleChildDevice = (children.size() == 1) && (children[0]->getChildren().empty());
-                if (isSingleChildDevice)
-                {
-                    continue; // Skip this device, it will be included as a child of its parent
-                }
 
-                // Recursively serialize this device and its children
-                serializeDeviceToJson(deviceList[i], devicesArray.add<JsonObject>());
-            }
-        }
+    // Written once, straight from the device tree; no document holds the whole list
+    std::vector<uint8_t> json;
+    json.reserve(devicesListReserve);
+    VectorPrint writer(json);
+    writeDevicesList(writer, request.requestId);
+    const size_t length = json.size();
+    devicesListReserve = std::max(devicesListReserve, length);
+
+    if (request.clientId == 0 && !batchingActive && !hasMsgPackClients() && !hasAwaitingClients() && queuedFrameCount == 0 && ws.availableForWriteAll())
+    {
+        // Numbered like notifyClients() does: the list's opening brace becomes the comma after the seq prefix
+        const uint32_t seq = history.takeSeq();
+        char prefix[WsHistory::kSeqPrefixSize];
+        const size_t prefixLength = WsHistory::formatSeqPrefix(prefix, seq);
+        AsyncWebSocketMessageBuffer *buffer = ws.makeBuffer(prefixLength + length + 2);
+        uint8_t *out = buffer->get();
+        out[0] = '[';
+        memcpy(out + 1, prefix, prefixLength);
+        out[1 + prefixLength] = ',';
+        memcpy(out + 2 + prefixLength, json.data() + 1, length - 1);
+        out[prefixLength + length + 1] = ']';
+        history.append(seq, reinterpret_cast<const char *>(out + 1), prefixLength + length);
+        MLOG_WS_SEND("%.*s", static_cast<int>(prefixLength + length + 2), reinterpret_cast<const char *>(out));
+        ws.textAll(buffer);
+        return;
     }
 
-    String message;
-    serializeJson(response, message);
-
-    notifyClients(message);
+    if (request.clientId != 0)
+    {
+        sendToClient(request.clientId, reinterpret_cast<const char *>(json.data()), length);
+        return;
+    }
+    QueuedMessage message;
+    message.json = String(reinterpret_cast<const char *>(json.data()), length);
+    queueOrSend(std::move(message));
 }
 
 /**
- * @brief Recursively serialize a device and its children to JSON
- * @param device The device to serialize
- * @param deviceObj The JSON object to populate
+ * @brief Write {"type":"devices-list","requestId":...,"devices":[...]} with every root device and its children
  */
-void WebSocketManager::serializeDeviceToJson(Device *device, JsonObject deviceObj)
+void WebSocketManager::writeDevicesList(Print &out, const String &requestId)
 {
-    if (!device)
-        return;
-
-    deviceObj["id"] = device->getId();
-    deviceObj["type"] = device->getType();
+    out.print("{\"type\":\"devices-list\",");
+    if (!requestId.isEmpty())
+    {
+        out.print("\"requestId\":");
+        writeJsonString(out, requestId);
+        out.print(',');
+    }
+    out.print("\"devices\":[");
+
+    bool first = true;
+    deviceManager->forEachRootDevice([&](Device *root)
+                                     {
+        // Skip devices that are single children (have exactly one child with no children)
+        const auto &children = root->getChildren();
+        bool isSingleChildDevice = (children.size() == 1) && (children[0]->getChildren().empty());
+        if (isSingleChildDevice)
+        {
+            return; // Skip this device, it will be included as a child of its parent
+        }
 
-    // Ensure devices-list stays lean; config/state are delivered via device-config/device-state
-    deviceObj.remove("config");
-    deviceObj.remove("state");
+        if (!first)
+        {
+            out.print(',');
+        }
+        first = false;
+        writeDeviceJson(root, out); });
 
-    // Add pins array
-    std::vector<String> pins = device->getPins();
-    JsonArray pinsArr = deviceObj["pins"].to<JsonArray>();
-    for (String pin : pins)
-    {
-        pinsArr.add(pin);
-    }
+    out.print("]}");
+}
 
+/**
+ * @brief Recursively write a device and its children as JSON
+ *
+ * Config and state are left out; they are delivered via device-config/device-state.
+ */
+void WebSocketManager::writeDeviceJson(Device *device, Print &out)
+{
+    out.print("{\"id\":");
+    writeJsonString(out, device->getId());
+    out.print(",\"type\":");
+    writeJsonString(out, device->getType());
+    out.print(",\"pins\":");
+    writeJsonStrings(out, device->getPins());
     // Generic features: mirror mixins as an array
+    out.print(",\"features\":");
+    writeJsonStrings(out, device->getMixins());
+
+    out.print(",\"children\":[");
+    bool first = true;
+    for (Device *child : device->getChildren())
     {
-        const auto &mixins = device->getMixins();
-        JsonArray featuresArr = deviceObj["features"].to<JsonArray>();
-        for (const auto &mx : mixins)
+        if (!child)
+        {
+            continue;
+        }
+        if (!first)
         {
-            featuresArr.add(mx);
+            out.print(',');
         }
+        first = false;
+        writeDeviceJson(child, out);
     }
+    out.print("]}");
+}
 
-    // Add children array recursively
-    JsonArray childrenArr = deviceObj["children"].to<JsonArray>();
-    for (Device *child : device->getChildren())
+/**
+ * @brief Sum of the state versions of all controllable devices; grows with every device-state sent
+ */
+uint32_t WebSocketManager::sumStateVersions()
+{
+    uint32_t sum = 0;
+    for (Device *device : deviceManager->getAllDevices())
     {
-        if (child)
+        IControllable *ctrl = device->hasMixin("controllable") ? mixins::ControllableRegistry::get(device->getId()) : nullptr;
+        if (ctrl)
         {
-            JsonObject childObj = childrenArr.add<JsonObject>();
-            serializeDeviceToJson(child, childObj);
+            sum += ctrl->getStateVersion();
         }
     }
+    return sum;
 }
 
 /**
- * @brief Parse and handle incoming WebSocket messages
+ * @brief Serialize devices-list, then device-config and device-state of every device, into one frame
+ *
+ * States are the ones clients last got, with their versions, so the
+ * deltas that follow apply. Devices that never sent a state get a first
+ * snapshot here.
  */
-void WebSocketManager::parseMessage(String message)
-
+void WebSocketManager::buildSnapshot()
 {
-    MLOG_WS_RECEIVE("%s", message.c_str());
-
-    // Parse as JSON
-    JsonDocument doc; // Dynamic sizing for large messages
-    if (deserializeJson(doc, message))
+    JsonDocument messages;
+    const std::vector<Device *> allDevices = deviceManager->getAllDevices();
+    for (Device *device : allDevices)
+    {
+        JsonObject message = messages.add<JsonObject>();
+        message["type"] = "device-config";
+        message["triggerBy"] = "get";
+        message["deviceId"] = device->getId();
+        ISerializable *serializable = device->hasMixin("serializable") ? mixins::SerializableRegistry::get(device->getId()) : nullptr;
+        if (serializable)
+        {
+            JsonDocument configDoc;
+            serializable->configToJson(configDoc);
+            message["config"] = configDoc;
+        }
+        else
+        {
+            message["config"] = nullptr;
+        }
+    }
+    for (Device *device : allDevices)
     {
-        if (hasClients())
+        JsonDocument stateDoc;
+        stateDoc["type"] = "device-state";
+        stateDoc["success"] = true;
+        stateDoc["deviceId"] = device->getId();
+        IControllable *ctrl = device->hasMixin("controllable") ? mixins::ControllableRegistry::get(device->getId()) : nullptr;
+        if (!ctrl)
         {
-            String errorResponse = createJsonResponse(false, "Invalid JSON format", "", "");
-            notifyClients(errorResponse);
+            stateDoc["state"] = nullptr;
         }
-        return;
+        else if (!ctrl->addLastStateToJson(stateDoc))
+        {
+            ctrl->addStateSnapshotToJson(stateDoc);
+        }
+        messages.add(stateDoc);
+    }
+
+    // [devices-list, ...messages]: the list is streamed in, the rest serialized behind it
+    const size_t restLength = measureJson(messages); // Including its own brackets
+    auto frame = std::make_shared<std::vector<uint8_t>>();
+    frame->reserve(1 + devicesListReserve + restLength + 1); // + terminator
+    frame->push_back('[');
+    VectorPrint writer(*frame);
+    writeDevicesList(writer, String());
+    const size_t listLength = frame->size() - 1;
+    devicesListReserve = std::max(devicesListReserve, listLength);
+    frame->resize(1 + listLength + restLength + 1);
+    char *rest = reinterpret_cast<char *>(frame->data() + 1 + listLength);
+    serializeJson(messages, rest, restLength + 1);
+    if (messages.size() > 0)
+    {
+        rest[0] = ','; // Replaces the array's opening bracket; its closing one ends the frame
+        frame->resize(1 + listLength + restLength);
     }
-
-    // Extract type (check both root and data field)
-    String type = doc["type"] | "";
-    if (type.isEmpty() && doc["data"].is<JsonObject>())
+    else
     {
-        type = doc["data"]["type"] | "";
+        rest[0] = ']';
+        frame->resize(1 + listLength + 1);
     }
 
-    // Handle special type
-    if (type == "restart")
+    snapshot.json = frame;
+    snapshot.msgpack.reset();
+    snapshot.devicesVersion = deviceManager->getDevicesVersion();
+    snapshot.stateVersions = sumStateVersions();
+    snapshot.builds++;
+    MLOG_DEBUG("Device snapshot rebuilt: %u bytes", static_cast<unsigned>(frame->size()));
+}
+
+/**
+ * @brief Bring clients that connected up to date: the broadcasts they missed, or the snapshot
+ *
+ * A new client is served once it sent its first message (a resume, if it
+ * has a seq from an earlier connection) or after kSnapshotWaitMs. A resume
+ * gets the held broadcasts after its seq; when those are gone, or too big
+ * for the client's outbox, it gets the snapshot instead. A sync message
+ * with the current seq follows either way. A reconnect storm costs one
+ * snapshot build and a copy into each socket. Called from loop(), where
+ * devices are not being changed by commands.
+ */
+void WebSocketManager::sendSnapshots()
+{
+    if (!snapshotPending.exchange(false) || !deviceManager)
     {
-        handleRestart();
         return;
     }
-    if (type == "device-fn")
+
+    const uint32_t now = millis();
+    bool anyDue = false;
+    bool needSnapshot = false;
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    for (auto &entry : clients)
     {
-        handleDeviceFunction(doc);
-        return;
+        ClientInfo &client = entry.second;
+        if (!client.awaitingSnapshot)
+        {
+            continue;
+        }
+        if (!client.snapshotDue && now - client.connectedMs >= kSnapshotWaitMs)
+        {
+            client.snapshotDue = true;
+        }
+        if (!client.snapshotDue)
+        {
+            snapshotPending = true;
+            continue;
+        }
+        anyDue = true;
+        needSnapshot = needSnapshot || !client.resume || !history.canResume(client.resumeSeq, kMaxOutboxBytes);
     }
-    if (type == "device-state")
+    xSemaphoreGive(clientsMutex);
+    if (!anyDue)
     {
-        handleDeviceGetState(doc);
         return;
     }
 
-    if (type == "devices-list")
+    if (needSnapshot && (!snapshot.json || snapshot.devicesVersion != deviceManager->getDevicesVersion() || snapshot.stateVersions != sumStateVersions()))
     {
-        handleGetDevices(doc);
-        return;
+        buildSnapshot();
     }
 
-    // Handler for replacing config.json via websocket upload
-    if (type == "set-devices-config")
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    for (auto &entry : clients)
     {
-        handleSetDevicesConfig(doc);
-        return;
+        ClientInfo &client = entry.second;
+        if (!client.awaitingSnapshot || !client.snapshotDue)
+        {
+            continue;
+        }
+
+        OutgoingFrame frame;
+        frame.priority = Priority::State;
+        frame.binary = client.encoding == Encoding::MsgPack;
+        std::vector<uint8_t> missed;
+        const bool resumed = client.resume && history.writeSince(client.resumeSeq, missed, kMaxOutboxBytes);
+        if (resumed)
+        {
+            resumes++;
+            if (missed.size() > 2)
+            {
+                if (frame.binary)
+                {
+                    JsonDocument doc;
+                    deserializeJson(doc, reinterpret_cast<const char *>(missed.data()), missed.size());
+                    frame = encodeFrame(doc, Encoding::MsgPack, Priority::State);
+                }
+                else
+                {
+                    frame.data = std::make_shared<std::vector<uint8_t>>(std::move(missed));
+                }
+            }
+        }
+        else
+        {
+            if (!needSnapshot)
+            {
+                // Its missed broadcasts were still held in the first pass; serve it next loop
+                snapshotPending = true;
+                continue;
+            }
+            if (client.resume)
+            {
+                resumesRefused++;
+            }
+            if (frame.binary)
+            {
+                if (!snapshot.msgpack)
+                {
+                    JsonDocument doc;
+                    deserializeJson(doc, reinterpret_cast<const char *>(snapshot.json->data()), snapshot.json->size());
+                    auto packed = std::make_shared<std::vector<uint8_t>>();
+                    encodeMsgPack(doc, *packed);
+                    snapshot.msgpack = packed;
+                }
+                frame.data = snapshot.msgpack;
+            }
+            else
+            {
+                frame.data = snapshot.json;
+            }
+            snapshot.sent++;
+        }
+
+        client.awaitingSnapshot = false;
+        client.resume = false;
+        if (frame.data)
+        {
+            enqueueFrame(entry.first, client, std::move(frame));
+        }
+        enqueueFrame(entry.first, client, makeSyncFrame(client.encoding, resumed));
     }
+    updateClientCounts();
+    xSemaphoreGive(clientsMutex);
+}
 
-    // New handler for downloading devices.json config
-    if (type == "devices-config")
+/**
+ * @brief {type: "sync", epoch, seq, resumed}: the client has every broadcast up to seq
+ */
+WebSocketManager::OutgoingFrame WebSocketManager::makeSyncFrame(Encoding encoding, bool resumed) const
+{
+    JsonDocument frame;
+    JsonObject sync = frame.add<JsonObject>();
+    sync["type"] = "sync";
+    sync["epoch"] = epoch;
+    sync["seq"] = history.getLastSeq();
+    sync["resumed"] = resumed;
+    return encodeFrame(frame, encoding, Priority::State);
+}
+
+/**
+ * @brief Let a new client's snapshot go out now that it sent its first message
+ */
+void WebSocketManager::releaseSnapshot(uint32_t clientId)
+{
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it != clients.end() && it->second.awaitingSnapshot)
     {
-        handleGetDevicesConfig(doc);
-        return;
+        it->second.snapshotDue = true;
     }
+    xSemaphoreGive(clientsMutex);
+}
+
+/**
+ * @brief Ask, right after connecting, for the broadcasts after lastSeq instead of the snapshot
+ *
+ * epoch and lastSeq come from the last sync or numbered message of the
+ * previous connection; a different epoch means the board restarted.
+ * Without them the client just gets the snapshot without waiting.
+ */
+void WebSocketManager::handleResume(const WsRequest &request, JsonDocument &doc)
+{
+    const bool hasSeq = doc["lastSeq"].is<uint32_t>();
+    const bool sameEpoch = (doc["epoch"] | 0u) == epoch;
 
-    if (type == "device-save-config")
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(request.clientId);
+    const bool awaiting = it != clients.end() && it->second.awaitingSnapshot;
+    if (awaiting && hasSeq && sameEpoch)
     {
-        handleDeviceSaveConfig(doc);
-        return;
+        it->second.resume = true;
+        it->second.resumeSeq = doc["lastSeq"];
     }
-    if (type == "device-read-config")
+    xSemaphoreGive(clientsMutex);
+
+    if (!awaiting)
     {
-        handleDeviceReadConfig(doc);
-        return;
+        reply(request, createJsonResponse(false, "Resume is only possible right after connecting", "resume"));
     }
-    if (type == "add-device")
+    else if (hasSeq && !sameEpoch)
     {
-        handleAddDevice(doc);
-        return;
+        resumesRefused++;
     }
-    if (type == "remove-device")
+}
+
+/**
+ * @brief Parse and handle incoming WebSocket messages
+ */
+void WebSocketManager::parseMessage(const char *message, size_t length, uint32_t clientId)
+{
+    AllocTracker::Scope allocScope(AllocSubsystem::WebSocket);
+
+    MLOG_WS_RECEIVE("%.*s", static_cast<int>(length), message);
+
+    // Parse as JSON
+    WsRequest request;
+    request.clientId = clientId;
+
+    JsonDocument doc; // Dynamic sizing for large messages
+    if (deserializeJson(doc, message, length))
     {
-        handleRemoveDevice(doc);
+        if (hasClients())
+        {
+            reply(request, createJsonResponse(false, "Invalid JSON format"));
+        }
         return;
     }
-    if (type == "reorder-devices")
+
+    // Extract type and requestId (check both root and data field)
+    const char *type = doc["type"] | "";
+    request.requestId = doc["requestId"] | "";
+    if (*type == '\0' && doc["data"].is<JsonObject>())
     {
-        handleReorderDevices(doc);
-        return;
+        type = doc["data"]["type"] | "";
+        if (request.requestId.isEmpty())
+        {
+            request.requestId = doc["data"]["requestId"] | "";
+        }
     }
-    if (type == "network-config")
+
+    const WsMessageRegistry::Handler *handler = WsMessageRegistry::find(type);
+    if (!handler)
     {
-        handleGetNetworkConfig(doc);
-        return;
-    }
-    if (type == "set-network-config")
-    {
-        handleSetNetworkConfig(doc);
-        return;
-    }
-    if (type == "networks")
-    {
-        handleGetNetworks(doc);
-        return;
-    }
-    if (type == "network-status")
-    {
-        handleGetNetworkStatus(doc);
-        return;
-    }
-    if (type == "expander-addresses")
-    {
-        handleGetExpanderAddresses(doc);
+        MLOG_DEBUG("No handler for WebSocket message type '%s'", type);
         return;
     }
+    (*handler)(request, doc);
+}
+
+void WebSocketManager::registerHandlers()
+{
+    const std::pair<const char *, void (WebSocketManager::*)(const WsRequest &, JsonDocument &)> handlers[] = {
+        {"device-fn", &WebSocketManager::handleDeviceFunction},
+        {"device-state", &WebSocketManager::handleDeviceGetState},
+        {"devices-list", &WebSocketManager::handleGetDevices},
+        {"set-devices-config", &WebSocketManager::handleSetDevicesConfig}, // Replace config.json via websocket upload
+        {"devices-config", &WebSocketManager::handleGetDevicesConfig},     // Download config.json
+        {"device-save-config", &WebSocketManager::handleDeviceSaveConfig},
+        {"device-read-config", &WebSocketManager::handleDeviceReadConfig},
+        {"add-device", &WebSocketManager::handleAddDevice},
+        {"remove-device", &WebSocketManager::handleRemoveDevice},
+        {"reorder-devices", &WebSocketManager::handleReorderDevices},
+        {"network-config", &WebSocketManager::handleGetNetworkConfig},
+        {"set-network-config", &WebSocketManager::handleSetNetworkConfig},
+        {"networks", &WebSocketManager::handleGetNetworks},
+        {"network-status", &WebSocketManager::handleGetNetworkStatus},
+        {"expander-addresses", &WebSocketManager::handleGetExpanderAddresses},
+        {"loop-stats", &WebSocketManager::handleGetLoopStats},
+        {"alloc-stats", &WebSocketManager::handleGetAllocStats},
+        {"boot-stats", &WebSocketManager::handleGetBootStats},
+        {"set-encoding", &WebSocketManager::handleSetEncoding},
+        {"subscribe", &WebSocketManager::handleSubscribe},
+        {"unsubscribe", &WebSocketManager::handleUnsubscribe},
+        {"telemetry", &WebSocketManager::handleTelemetry},
+        {"client-stats", &WebSocketManager::handleGetClientStats},
+        {"resume", &WebSocketManager::handleResume},
+    };
+    for (const auto &entry : handlers)
+    {
+        auto method = entry.second;
+        WsMessageRegistry::registerHandler(entry.first, [this, method](const WsRequest &request, JsonDocument &doc)
+                                           { (this->*method)(request, doc); });
+    }
+    WsMessageRegistry::registerHandler("restart", [this](const WsRequest &request, JsonDocument &)
+                                       { handleRestart(request); });
 }
 
 // Save config from client for a device
-void WebSocketManager::handleDeviceSaveConfig(JsonDocument &doc)
+void WebSocketManager::handleDeviceSaveConfig(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -346,7 +846,7 @@ void WebSocketManager::handleDeviceSaveConfig(JsonDocument &doc)
     const String deviceId = doc["deviceId"] | "";
     if (!deviceManager)
     {
-        notifyClients(createJsonResponse(false, "DeviceManager not available", "", "", "device-save-config", deviceId));
+        reply(request, createJsonResponse(false, "DeviceManager not available", "device-save-config", deviceId));
         return;
     }
 
@@ -356,7 +856,7 @@ void WebSocketManager::handleDeviceSaveConfig(JsonDocument &doc)
     {
         if (!doc["config"].is<JsonObject>())
         {
-            notifyClients(createJsonResponse(false, "No config provided", "", "", "device-save-config", deviceId));
+            reply(request, createJsonResponse(false, "No config provided", "device-save-config", deviceId));
             return;
         }
 
@@ -366,78 +866,139 @@ void WebSocketManager::handleDeviceSaveConfig(JsonDocument &doc)
             ISerializable *serializable = mixins::SerializableRegistry::get(deviceId);
             if (serializable)
             {
-                deviceManager->teardown();
+                Device *root = deviceManager->getRootDeviceOf(deviceId);
+                if (!root)
+                {
+                    reply(request, createJsonResponse(false, "Device is not in the device tree: " + deviceId, "device-save-config", deviceId));
+                    return;
+                }
+
+                // Devices others look up by id (the bus of an expander, the expander of a pin) restart everything
+                const bool isShared = device->getType() == "i2c" || device->getType() == "ioexpander";
+                std::vector<DeviceOutput> before;
+                if (isShared)
+                {
+                    for (Device *dev : deviceManager->getAllDevices())
+                    {
+                        before.push_back(captureOutput(dev));
+                    }
+                }
+                else
+                {
+                    captureOutputs(root, before);
+                }
+                const auto self = std::find_if(before.begin(), before.end(), [device](const DeviceOutput &output)
+                                               { return output.device == device; });
+                if (self == before.end())
+                {
+                    reply(request, createJsonResponse(false, "Device is not in the device tree: " + deviceId, "device-save-config", deviceId));
+                    return;
+                }
+
+                // Setup reports state changes; collect them so each device is sent once
+                beginBatch();
 
-                // Apply the incoming config to the device
                 JsonObject configObj = doc["config"];
-                serializable->jsonToConfig(configObj);
+                Device *setupRoot = device;
+                if (isShared)
+                {
+                    deviceManager->teardown();
+                    serializable->jsonToConfig(configObj);
+                    deviceManager->saveDevicesToJsonFile();
+                    deviceManager->setup();
+                }
+                else
+                {
+                    device->teardown();
+                    serializable->jsonToConfig(configObj);
+                    deviceManager->saveDevicesToJsonFile();
+                    deviceManager->setupDevice(device);
 
-                deviceManager->saveDevicesToJsonFile();
+                    // Pins are known once set up; parents check the pins of their children in their own setup
+                    if (root != device && device->getPins() != self->pins)
+                    {
+                        root->teardown();
+                        deviceManager->setupDevice(root);
+                        setupRoot = root;
+                    }
+                }
 
-                // Build device-config response after save
+                // Build device-config response after save and setup
                 JsonDocument response;
                 response["type"] = "device-config";
                 response["triggerBy"] = "set";
                 response["deviceId"] = deviceId;
 
-                DynamicJsonDocument savedConfig(2048);
+                JsonDocument savedConfig;
                 serializable->configToJson(savedConfig);
                 if (savedConfig.overflowed())
                 {
                     MLOG_ERROR("device-save-config: config JSON overflowed for %s", deviceId.c_str());
                 }
-                // Note: Re-setup all root devices after config change
-                deviceManager->setup();
-
                 response["config"] = savedConfig;
 
-                String respStr;
-                serializeJson(response, respStr);
-                notifyClients(respStr);
+                // The new config is a change every open config panel needs
+                broadcast(request, response);
 
                 deviceManager->notifyDevicesChanged();
 
-                // Send updated device information after config change and setup
-                beginBatch();
-
-                // Send updated devices list
-                JsonDocument emptyDoc;
-                handleGetDevices(emptyDoc);
-
-                std::vector<Device *> allDevices = deviceManager->getAllDevices();
+                // Only what clients see differently is sent: the list has the pins, the rest config and state
+                std::vector<DeviceOutput> after;
+                bool pinsChanged = false;
+                for (const DeviceOutput &old : before)
+                {
+                    after.push_back(captureOutput(old.device));
+                    pinsChanged = pinsChanged || after.back().pins != old.pins;
+                }
 
-                // Send config for all devices
-                for (Device *dev : allDevices)
+                if (pinsChanged)
                 {
-                    JsonDocument configDoc;
-                    configDoc["deviceId"] = dev->getId();
-                    handleDeviceReadConfig(configDoc);
+                    JsonDocument emptyDoc;
+                    handleGetDevices(WsRequest(), emptyDoc);
                 }
 
-                // Send state for all devices
-                for (Device *dev : allDevices)
+                for (size_t i = 0; i < before.size(); i++)
                 {
-                    JsonDocument stateDoc;
-                    stateDoc["deviceId"] = dev->getId();
-                    handleDeviceGetState(stateDoc);
+                    const String &id = before[i].device->getId();
+                    if (before[i].device != device && after[i].config != before[i].config)
+                    {
+                        JsonDocument configDoc;
+                        configDoc["deviceId"] = id;
+                        handleDeviceReadConfig(WsRequest(), configDoc);
+                    }
+
+                    // A device that reported changes during setup but ended where it was is not sent
+                    auto dirty = std::find(dirtyStates.begin(), dirtyStates.end(), id);
+                    if (after[i].state != before[i].state)
+                    {
+                        if (dirty == dirtyStates.end())
+                        {
+                            dirtyStates.push_back(id);
+                        }
+                    }
+                    else if (dirty != dirtyStates.end())
+                    {
+                        dirtyStates.erase(dirty);
+                    }
                 }
 
                 endBatch();
 
+                MLOG_INFO("device-save-config: set up %s again", isShared ? "all devices" : setupRoot->getId().c_str());
                 return;
             }
         }
 
         // Device exists but doesn't support serializable
-        notifyClients(createJsonResponse(false, "Device does not support config: " + device->getType(), "", "", "device-save-config", deviceId));
+        reply(request, createJsonResponse(false, "Device does not support config: " + device->getType(), "device-save-config", deviceId));
         return;
     }
 
-    notifyClients(createJsonResponse(false, "Device not found: " + deviceId, "", "", "device-save-config", deviceId));
+    reply(request, createJsonResponse(false, "Device not found: " + deviceId, "device-save-config", deviceId));
 }
 
 // Read config for a device and send to client
-void WebSocketManager::handleDeviceReadConfig(JsonDocument &doc)
+void WebSocketManager::handleDeviceReadConfig(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -446,8 +1007,7 @@ void WebSocketManager::handleDeviceReadConfig(JsonDocument &doc)
 
     if (!deviceManager)
     {
-        String response = createJsonResponse(false, "DeviceManager not available", "", "", "device-read-config", deviceId);
-        notifyClients(response);
+        reply(request, createJsonResponse(false, "DeviceManager not available", "device-read-config", deviceId));
         return;
     }
 
@@ -485,18 +1045,15 @@ void WebSocketManager::handleDeviceReadConfig(JsonDocument &doc)
             response["config"] = nullptr;
         }
 
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
     MLOG_ERROR("Device not found for config read request: %s", deviceId.c_str());
-    String response = createJsonResponse(false, "Device not found: " + deviceId, "", "", "device-read-config", deviceId);
-    notifyClients(response);
+    reply(request, createJsonResponse(false, "Device not found: " + deviceId, "device-read-config", deviceId));
 }
 
-void WebSocketManager::handleSetDevicesConfig(JsonDocument &doc)
+void WebSocketManager::handleSetDevicesConfig(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -532,18 +1089,16 @@ void WebSocketManager::handleSetDevicesConfig(JsonDocument &doc)
                 deviceManager->loadDevicesFromJsonFile();
                 // Broadcast updated device list to all clients
                 // JsonDocument emptyDoc;
-                // handleGetDevices(emptyDoc);
+                // handleGetDevices(WsRequest(), emptyDoc);
 
                 deviceManager->notifyDevicesChanged();
             }
         }
     }
-    String respStr;
-    serializeJson(response, respStr);
-    notifyClients(respStr);
+    reply(request, response);
 }
 
-void WebSocketManager::handleGetDevicesConfig(JsonDocument &doc)
+void WebSocketManager::handleGetDevicesConfig(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -563,246 +1118,1302 @@ void WebSocketManager::handleGetDevicesConfig(JsonDocument &doc)
         response["config"] = configDoc;
     }
 
-    if (response.overflowed())
+    if (response.overflowed())
+    {
+        MLOG_ERROR("devices-config JSON overflowed!");
+    }
+
+    MLOG_DEBUG("devices-config serialized: %u bytes", static_cast<unsigned>(measureJson(response)));
+    reply(request, response);
+}
+
+void WebSocketManager::onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+    switch (type)
+    {
+    case WS_EVT_CONNECT:
+    {
+        MLOG_INFO("WebSocket client #%u connected from %s", client->id(), client->remoteIP().toString().c_str());
+        WsCapture::record(client->id(), WsCapture::Event::Connect);
+
+        // Device state follows from the main loop: the broadcasts it missed if it resumes, else the cached snapshot
+        xSemaphoreTake(clientsMutex, portMAX_DELAY);
+        ClientInfo &info = clients[client->id()];
+        info = ClientInfo();
+        info.awaitingSnapshot = deviceManager != nullptr;
+        info.connectedMs = millis();
+        updateClientCounts();
+        xSemaphoreGive(clientsMutex);
+        if (deviceManager)
+        {
+            snapshotPending = true;
+        }
+
+        // Send welcome message with connection info
+        String welcome = "{\"type\":\"connection\",\"message\":\"WebSocket connected\",\"clientId\":" + String(client->id()) + "}";
+        client->text(welcome);
+        break;
+    }
+
+    case WS_EVT_DISCONNECT:
+    {
+        MLOG_INFO("WebSocket client #%u disconnected", client->id());
+        WsCapture::record(client->id(), WsCapture::Event::Disconnect);
+
+        xSemaphoreTake(clientsMutex, portMAX_DELAY);
+        auto it = clients.find(client->id());
+        if (it != clients.end())
+        {
+            queuedFrameCount -= it->second.outbox.size();
+            clients.erase(it);
+        }
+        updateClientCounts();
+        xSemaphoreGive(clientsMutex);
+        break;
+    }
+
+    case WS_EVT_DATA:
+        receiveData(client, *(AwsFrameInfo *)arg, data, len);
+        break;
+
+    case WS_EVT_PONG:
+        MLOG_INFO("WebSocket client #%u pong", client->id());
+        break;
+
+    case WS_EVT_ERROR:
+        MLOG_ERROR("WebSocket client #%u ERROR occurred", client->id());
+        break;
+    }
+}
+
+void WebSocketManager::receiveData(AsyncWebSocketClient *client, const AwsFrameInfo &info, uint8_t *data, size_t len)
+{
+    if (info.message_opcode != WS_TEXT)
+        return;
+
+    const uint32_t clientId = client->id();
+
+    // Single frame message: the receive buffer goes away after this callback, so copy it once
+    if (info.final && info.num == 0 && info.index == 0 && info.len == len)
+    {
+        if (len > kMaxMessageBytes)
+        {
+            MLOG_WARN("WebSocket client #%u message of %u bytes exceeds %u", clientId, static_cast<unsigned>(len), static_cast<unsigned>(kMaxMessageBytes));
+            sendToClient(clientId, createJsonResponse(false, "Message too large"));
+            return;
+        }
+        auto *message = new std::vector<char>(reinterpret_cast<const char *>(data), reinterpret_cast<const char *>(data) + len);
+        message->push_back('\0');
+        queueCommand(clientId, message);
+        return;
+    }
+
+    // Multi-frame message: collect it in the client's session, sized from the frame length up front
+    std::vector<char> *message = nullptr;
+    bool tooLarge = false;
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it != clients.end())
+    {
+        ClientInfo &session = it->second;
+        if (info.num == 0 && info.index == 0)
+        {
+            // A new message replaces whatever was left of an unfinished one
+            session.inbox.clear();
+            session.inboxDiscarding = false;
+        }
+        else if (session.inbox.empty() && !session.inboxDiscarding)
+        {
+            // Middle of a message whose start was not seen
+            session.inboxDiscarding = true;
+        }
+
+        if (!session.inboxDiscarding && info.index == 0)
+        {
+            const size_t needed = session.inbox.size() + info.len;
+            if (needed > kMaxMessageBytes)
+            {
+                MLOG_WARN("WebSocket client #%u message exceeds %u bytes", clientId, static_cast<unsigned>(kMaxMessageBytes));
+                std::vector<char>().swap(session.inbox);
+                session.inboxDiscarding = true;
+                tooLarge = true;
+            }
+            else
+            {
+                session.inbox.reserve(needed + 1); // + terminator
+            }
+        }
+
+        if (!session.inboxDiscarding)
+        {
+            session.inbox.insert(session.inbox.end(), data, data + len);
+        }
+
+        if (info.final && info.index + len == info.len)
+        {
+            if (!session.inboxDiscarding)
+            {
+                session.inbox.push_back('\0');
+                message = new std::vector<char>(std::move(session.inbox));
+                session.inbox = std::vector<char>();
+            }
+            session.inboxDiscarding = false;
+        }
+    }
+    xSemaphoreGive(clientsMutex);
+
+    if (tooLarge)
+    {
+        sendToClient(clientId, createJsonResponse(false, "Message too large"));
+    }
+    if (message)
+    {
+        queueCommand(clientId, message);
+    }
+}
+
+void WebSocketManager::queueCommand(uint32_t clientId, std::vector<char> *message)
+{
+    if (WsCapture::isActive())
+    {
+        WsCapture::record(clientId, WsCapture::Event::Message, String(message->data(), message->size() - 1));
+    }
+
+    Command command = {clientId, message};
+    if (xQueueSend(commandQueue, &command, 0) != pdTRUE)
+    {
+        delete message;
+        commandQueueFullCount.fetch_add(1, std::memory_order_relaxed);
+        MLOG_WARN("WebSocket command queue full, dropped message from client #%u", clientId);
+        sendToClient(clientId, createJsonResponse(false, "Too many pending commands"));
+    }
+}
+
+void WebSocketManager::commandTask(void *arg)
+{
+    auto *self = static_cast<WebSocketManager *>(arg);
+    Command command;
+    while (true)
+    {
+        if (xQueueReceive(self->commandQueue, &command, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        self->commandWaiting = true;
+        xSemaphoreTake(self->commandMutex, portMAX_DELAY);
+        self->commandWaiting = false;
+
+        self->parseMessage(command.message->data(), command.message->size() - 1, command.clientId);
+        self->releaseSnapshot(command.clientId);
+        xSemaphoreGive(self->commandMutex);
+
+        delete command.message;
+    }
+}
+
+WebSocketManager::CommandPause::CommandPause(WebSocketManager &manager) : _manager(manager)
+{
+    if (_manager.commandMutex)
+    {
+        xSemaphoreTake(_manager.commandMutex, portMAX_DELAY);
+    }
+}
+
+WebSocketManager::CommandPause::~CommandPause()
+{
+    if (!_manager.commandMutex)
+        return;
+
+    xSemaphoreGive(_manager.commandMutex);
+    if (_manager.commandWaiting)
+    {
+        // A command task on the other core would lose the mutex to the next iteration; let it run first
+        vTaskDelay(1);
+    }
+}
+
+WebSocketManager::WebSocketManager(DeviceManager *deviceManager, Network *network, const char *path)
+    : ws(path), deviceManager(deviceManager), network(network), batchingActive(false)
+{
+    instance = this;
+    registerHandlers();
+
+    // Coalesce state changes per device within a batch (last writer wins) and filter them per client
+    ControllableMixinBase::setDeferStateChange([this](const String &deviceId)
+                                               { return deferStateChange(deviceId); });
+}
+
+void WebSocketManager::setup(AsyncWebServer &server)
+{
+    clientsMutex = xSemaphoreCreateMutex();
+    commandMutex = xSemaphoreCreateMutex();
+    history.begin();
+    epoch = static_cast<uint32_t>(random(1, INT32_MAX));
+    commandQueue = xQueueCreate(kCommandQueueLength, sizeof(Command));
+    // The command task reads the registry without a lock; no handler may come or go after this
+    WsMessageRegistry::seal();
+    xTaskCreatePinnedToCore(commandTask, "ws_commands", kCommandTaskStack, this, WS_COMMAND_TASK_PRIORITY, nullptr, WS_COMMAND_TASK_CORE);
+    ws.onEvent([](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+               {
+        if (instance) {
+            instance->onEvent(server, client, type, arg, data, len);
+        } });
+
+    server.addHandler(&ws);
+    MLOG_INFO("WebSocket manager: OK");
+    MLOG_INFO("WebSocket path: /ws");
+    MLOG_INFO("WebSocket server ready to accept connections");
+}
+
+void WebSocketManager::loop()
+{
+    ws.cleanupClients();
+    WsCapture::loop();
+    drainOutboxes();
+    sendSnapshots();
+    sendTelemetry();
+
+    // Check if async WiFi scan is complete
+    if (scanInProgress)
+    {
+        int16_t numNetworks = WiFi.scanComplete();
+        if (numNetworks >= 0)
+        {
+            scanInProgress = false;
+            std::vector<WsRequest> requests;
+            requests.swap(scanRequests);
+
+            if (!hasClients())
+                return;
+
+            JsonDocument response;
+            response["type"] = "networks";
+
+            if (numNetworks == WIFI_SCAN_FAILED)
+            {
+                response["error"] = "WiFi scan failed";
+            }
+            else
+            {
+                JsonArray networksArray = response["networks"].to<JsonArray>();
+
+                for (int i = 0; i < numNetworks; i++)
+                {
+                    JsonObject networkObj = networksArray.add<JsonObject>();
+                    networkObj["ssid"] = WiFi.SSID(i);
+                    networkObj["rssi"] = WiFi.RSSI(i);
+                    networkObj["encryption"] = WiFi.encryptionType(i);
+                    networkObj["channel"] = WiFi.channel(i);
+                    networkObj["bssid"] = WiFi.BSSIDstr(i);
+                    networkObj["hidden"] = WiFi.SSID(i).isEmpty();
+                }
+
+                response["count"] = numNetworks;
+                MLOG_INFO("Found %d WiFi networks", numNetworks);
+            }
+
+            for (const WsRequest &request : requests)
+            {
+                reply(request, JsonDocument(response));
+            }
+        }
+    }
+}
+
+String WebSocketManager::getStatus() const
+{
+    return "{\"connectedClients\":" + String(ws.count()) + ",\"path\":\"/ws\"}";
+}
+
+uint32_t WebSocketManager::getClientCount() const
+{
+    return ws.count();
+}
+
+void WebSocketManager::notifyClients(const String &state)
+{
+    if (!hasClients())
+    {
+        history.skip();
+        return;
+    }
+
+    QueuedMessage message;
+    message.json = state;
+    queueOrSend(std::move(message));
+}
+
+void WebSocketManager::notifyClients(const JsonDocument &doc)
+{
+    if (!hasClients())
+    {
+        history.skip();
+        return;
+    }
+
+    if (!batchingActive && !hasMsgPackClients() && !hasAwaitingClients() && queuedFrameCount == 0 && doc.size() > 0 && ws.availableForWriteAll())
+    {
+        // Serialize straight into the outgoing buffer, wrapped in an array and numbered:
+        // the object's opening brace becomes the comma after the seq prefix
+        const uint32_t seq = history.takeSeq();
+        char prefix[WsHistory::kSeqPrefixSize];
+        const size_t prefixLength = WsHistory::formatSeqPrefix(prefix, seq);
+        const size_t length = prefixLength + measureJson(doc);
+        AsyncWebSocketMessageBuffer *buffer = ws.makeBuffer(length + 2);
+        char *out = reinterpret_cast<char *>(buffer->get());
+        out[0] = '[';
+        memcpy(out + 1, prefix, prefixLength);
+        serializeJson(doc, out + 1 + prefixLength, length - prefixLength + 1);
+        out[1 + prefixLength] = ',';
+        out[length + 1] = ']';
+        history.append(seq, out + 1, length);
+        MLOG_WS_SEND("%.*s", static_cast<int>(length + 2), out);
+        ws.textAll(buffer);
+        return;
+    }
+
+    // Both encodings come from the document, nothing is parsed again
+    QueuedMessage message;
+    serializeJson(doc, message.json);
+    if (hasMsgPackClients())
+    {
+        encodeMsgPack(doc, message.msgpack);
+    }
+    queueOrSend(std::move(message));
+}
+
+void WebSocketManager::queueOrSend(QueuedMessage &&message)
+{
+    if (batchingActive)
+    {
+        // Queue message for batch sending
+        if (messageQueue.size() >= kMaxQueuedBatchMessages)
+        {
+            MLOG_WARN("WebSocket batch queue full (%u). Dropping message.", static_cast<unsigned>(kMaxQueuedBatchMessages));
+            batchQueueFullCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        messageQueue.push_back(std::move(message));
+        return;
+    }
+
+    // Send immediately as array
+    std::vector<QueuedMessage> single;
+    single.push_back(std::move(message));
+    sendMessages(single);
+}
+
+bool WebSocketManager::ClientInfo::wants(const QueuedMessage &message) const
+{
+    if (awaitingSnapshot)
+    {
+        // Sent with the missed broadcasts, or the snapshot carries the state they lead to
+        return false;
+    }
+    if (message.deviceId.isEmpty() || !filtered)
+    {
+        return true;
+    }
+    return deviceIds.count(message.deviceId) > 0 || (!message.deviceType.isEmpty() && deviceTypes.count(message.deviceType) > 0);
+}
+
+size_t WebSocketManager::writeJsonFrame(const std::vector<QueuedMessage> &messages, const ClientInfo *client, char *out)
+{
+    // Measures only when out is null; "[]" (2) means the client wants none of the messages
+    size_t pos = 0;
+    if (out)
+    {
+        out[pos] = '[';
+    }
+    pos++;
+
+    bool firstMessage = true;
+    for (const QueuedMessage &message : messages)
+    {
+        // Skip empty messages to prevent double commas
+        if (message.json.isEmpty() || (client && !client->wants(message)))
+        {
+            continue;
+        }
+
+        if (!firstMessage)
+        {
+            if (out)
+            {
+                out[pos] = ',';
+            }
+            pos++;
+        }
+        firstMessage = false;
+
+        if (out)
+        {
+            memcpy(out + pos, message.json.c_str(), message.json.length());
+        }
+        pos += message.json.length();
+    }
+
+    if (out)
+    {
+        out[pos] = ']';
+    }
+    return pos + 1;
+}
+
+size_t WebSocketManager::writeMsgPackFrame(const std::vector<QueuedMessage> &messages, const ClientInfo *client, std::vector<uint8_t> &out)
+{
+    size_t count = 0;
+    for (const QueuedMessage &message : messages)
+    {
+        if (!message.json.isEmpty() && (!client || client->wants(message)))
+        {
+            count++;
+        }
+    }
+
+    out.clear();
+    appendMsgPackArrayHeader(out, count);
+    for (const QueuedMessage &message : messages)
+    {
+        if (!message.json.isEmpty() && (!client || client->wants(message)))
+        {
+            out.insert(out.end(), message.msgpack.begin(), message.msgpack.end());
+        }
+    }
+    return count;
+}
+
+WebSocketManager::Priority WebSocketManager::framePriority(const std::vector<QueuedMessage> &messages, const ClientInfo *client)
+{
+    Priority priority = Priority::Telemetry;
+    for (const QueuedMessage &message : messages)
+    {
+        if (!message.json.isEmpty() && (!client || client->wants(message)) && message.priority > priority)
+        {
+            priority = message.priority;
+        }
+    }
+    return priority;
+}
+
+/**
+ * @brief Number the messages of a broadcast and keep them for clients that resume
+ */
+void WebSocketManager::stampMessages(std::vector<QueuedMessage> &messages)
+{
+    for (QueuedMessage &message : messages)
+    {
+        if (message.json.length() < 2 || message.json[0] != '{')
+        {
+            continue;
+        }
+        const uint32_t seq = history.takeSeq();
+        message.json = stampSeq(message.json, seq);
+        if (!message.msgpack.empty())
+        {
+            stampMsgPackSeq(message.msgpack, seq);
+        }
+        history.append(seq, message.json.c_str(), message.json.length());
+    }
+}
+
+void WebSocketManager::sendMessages(std::vector<QueuedMessage> &messages)
+{
+    stampMessages(messages);
+    for (const QueuedMessage &message : messages)
+    {
+        if (!message.json.isEmpty())
+        {
+            MLOG_WS_SEND("%s", message.json.c_str());
+        }
+    }
+
+    // Always send as array, even for single messages; sized up front and copied once into the socket buffer
+    if (!hasMsgPackClients() && !hasFilteredClients() && queuedFrameCount == 0 && ws.availableForWriteAll())
+    {
+        // Every client takes the same frame right away
+        const size_t length = writeJsonFrame(messages, nullptr, nullptr);
+        AsyncWebSocketMessageBuffer *buffer = ws.makeBuffer(length);
+        writeJsonFrame(messages, nullptr, reinterpret_cast<char *>(buffer->get()));
+        ws.textAll(buffer);
+        return;
+    }
+
+    if (hasMsgPackClients())
+    {
+        // Messages queued before the first MessagePack client connected are converted here
+        for (QueuedMessage &message : messages)
+        {
+            if (message.json.isEmpty() || !message.msgpack.empty())
+            {
+                continue;
+            }
+            JsonDocument doc;
+            if (deserializeJson(doc, message.json))
+            {
+                doc.clear();
+            }
+            encodeMsgPack(doc, message.msgpack);
+        }
+    }
+
+    // Frames per client, each into its own queue so a slow client only holds up itself;
+    // clients without subscriptions share the full frame of their encoding
+    const Priority priority = framePriority(messages, nullptr);
+    std::shared_ptr<std::vector<uint8_t>> json;
+    std::shared_ptr<std::vector<uint8_t>> packed;
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    for (auto &entry : clients)
+    {
+        ClientInfo &client = entry.second;
+        OutgoingFrame frame;
+        frame.binary = client.encoding == Encoding::MsgPack;
+        frame.priority = priority;
+        if (client.filtered || client.awaitingSnapshot)
+        {
+            auto own = std::make_shared<std::vector<uint8_t>>();
+            if (frame.binary)
+            {
+                if (writeMsgPackFrame(messages, &client, *own) == 0)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                const size_t ownLength = writeJsonFrame(messages, &client, nullptr);
+                if (ownLength <= 2)
+                {
+                    continue;
+                }
+                own->resize(ownLength);
+                writeJsonFrame(messages, &client, reinterpret_cast<char *>(own->data()));
+            }
+            frame.data = own;
+            frame.priority = framePriority(messages, &client);
+        }
+        else if (frame.binary)
+        {
+            if (!packed)
+            {
+                packed = std::make_shared<std::vector<uint8_t>>();
+                writeMsgPackFrame(messages, nullptr, *packed);
+            }
+            frame.data = packed;
+        }
+        else
+        {
+            if (!json)
+            {
+                json = std::make_shared<std::vector<uint8_t>>(writeJsonFrame(messages, nullptr, nullptr));
+                writeJsonFrame(messages, nullptr, reinterpret_cast<char *>(json->data()));
+            }
+            frame.data = json;
+        }
+        enqueueFrame(entry.first, client, std::move(frame));
+    }
+    xSemaphoreGive(clientsMutex);
+}
+
+void WebSocketManager::updateClientCounts()
+{
+    uint32_t msgpack = 0;
+    uint32_t filtered = 0;
+    uint32_t awaiting = 0;
+    uint32_t streams = 0;
+    for (const auto &entry : clients)
+    {
+        if (entry.second.encoding == Encoding::MsgPack)
+        {
+            msgpack++;
+        }
+        if (entry.second.filtered || entry.second.awaitingSnapshot)
+        {
+            filtered++;
+        }
+        if (entry.second.awaitingSnapshot)
+        {
+            awaiting++;
+        }
+        streams += entry.second.telemetry.size();
+    }
+    msgpackClientCount = msgpack;
+    filteredClientCount = filtered;
+    awaitingClientCount = awaiting;
+    telemetryStreamCount = streams;
+}
+
+void WebSocketManager::sendToClient(uint32_t clientId, const JsonDocument &doc)
+{
+    JsonDocument frame;
+    frame.add(doc);
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it != clients.end())
+    {
+        enqueueFrame(clientId, it->second, encodeFrame(frame, it->second.encoding, Priority::Response));
+    }
+    xSemaphoreGive(clientsMutex);
+}
+
+void WebSocketManager::sendToClient(uint32_t clientId, const char *json, size_t length)
+{
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it != clients.end())
+    {
+        OutgoingFrame frame;
+        frame.priority = Priority::Response;
+        if (it->second.encoding == Encoding::MsgPack)
+        {
+            JsonDocument doc;
+            deserializeJson(doc, json, length);
+            JsonDocument array;
+            array.add(doc);
+            frame = encodeFrame(array, Encoding::MsgPack, Priority::Response);
+        }
+        else
+        {
+            // Wrapped in an array like every other frame
+            auto data = std::make_shared<std::vector<uint8_t>>(length + 2);
+            (*data)[0] = '[';
+            memcpy(data->data() + 1, json, length);
+            (*data)[length + 1] = ']';
+            frame.data = data;
+        }
+        enqueueFrame(clientId, it->second, std::move(frame));
+    }
+    xSemaphoreGive(clientsMutex);
+}
+
+void WebSocketManager::reply(const WsRequest &request, JsonDocument &response)
+{
+    if (!request.requestId.isEmpty())
+    {
+        response["requestId"] = request.requestId;
+    }
+
+    if (request.clientId == 0)
+    {
+        notifyClients(response);
+        return;
+    }
+    sendToClient(request.clientId, response);
+}
+
+void WebSocketManager::broadcast(const WsRequest &request, JsonDocument &response)
+{
+    if (!request.requestId.isEmpty())
+    {
+        response["requestId"] = request.requestId;
+    }
+    notifyClients(response);
+
+    // Broadcasts skip a client until its snapshot is out; the requester still gets its answer
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(request.clientId);
+    const bool requesterAwaiting = it != clients.end() && it->second.awaitingSnapshot;
+    xSemaphoreGive(clientsMutex);
+    if (requesterAwaiting)
+    {
+        sendToClient(request.clientId, response);
+    }
+}
+
+WebSocketManager::OutgoingFrame WebSocketManager::encodeFrame(const JsonDocument &frame, Encoding encoding, Priority priority)
+{
+    auto data = std::make_shared<std::vector<uint8_t>>();
+    if (encoding == Encoding::MsgPack)
+    {
+        encodeMsgPack(frame, *data);
+    }
+    else
+    {
+        // Room for the terminator serializeJson() writes, which is not sent
+        const size_t length = measureJson(frame);
+        data->resize(length + 1);
+        serializeJson(frame, reinterpret_cast<char *>(data->data()), data->size());
+        data->resize(length);
+    }
+
+    OutgoingFrame outgoing;
+    outgoing.data = data;
+    outgoing.binary = encoding == Encoding::MsgPack;
+    outgoing.priority = priority;
+    return outgoing;
+}
+
+/**
+ * @brief Send a frame to one client, or queue it while the client's socket is busy
+ *
+ * A newer telemetry sample replaces the queued one of the same device. When
+ * the queue is full, queued telemetry makes room for responses and state;
+ * otherwise the new frame is dropped and counted for this client only.
+ */
+void WebSocketManager::enqueueFrame(uint32_t clientId, ClientInfo &client, OutgoingFrame &&frame)
+{
+    if (client.outbox.empty() && ws.availableForWrite(clientId))
+    {
+        writeFrame(clientId, frame);
+        return;
+    }
+
+    auto remove = [&](std::deque<OutgoingFrame>::iterator it)
+    {
+        client.outboxBytes -= it->data->size();
+        client.outbox.erase(it);
+        queuedFrameCount--;
+    };
+
+    if (!frame.telemetryDeviceId.isEmpty())
+    {
+        auto superseded = std::find_if(client.outbox.begin(), client.outbox.end(), [&](const OutgoingFrame &queued)
+                                       { return queued.telemetryDeviceId == frame.telemetryDeviceId; });
+        if (superseded != client.outbox.end())
+        {
+            remove(superseded);
+            client.drops.telemetrySuperseded++;
+        }
+    }
+
+    const size_t size = frame.data->size();
+    auto full = [&]()
+    {
+        return client.outbox.size() >= kMaxOutboxFrames || client.outboxBytes + size > kMaxOutboxBytes;
+    };
+    while (full() && frame.priority > Priority::Telemetry)
+    {
+        auto oldest = std::find_if(client.outbox.begin(), client.outbox.end(), [](const OutgoingFrame &queued)
+                                   { return queued.priority == Priority::Telemetry; });
+        if (oldest == client.outbox.end())
+        {
+            break;
+        }
+        remove(oldest);
+        dropFrame(client, Priority::Telemetry);
+    }
+    if (full())
+    {
+        MLOG_WARN("WebSocket client #%u queue full. Dropping message.", clientId);
+        dropFrame(client, frame.priority);
+        return;
+    }
+
+    client.outboxBytes += size;
+    client.outbox.push_back(std::move(frame));
+    queuedFrameCount++;
+}
+
+void WebSocketManager::writeFrame(uint32_t clientId, const OutgoingFrame &frame)
+{
+    const char *data = reinterpret_cast<const char *>(frame.data->data());
+    if (frame.binary)
+    {
+        ws.binary(clientId, data, frame.data->size());
+    }
+    else
+    {
+        ws.text(clientId, data, frame.data->size());
+    }
+}
+
+void WebSocketManager::dropFrame(ClientInfo &client, Priority priority)
+{
+    switch (priority)
+    {
+    case Priority::Response:
+        client.drops.responses++;
+        break;
+    case Priority::State:
+        client.drops.states++;
+        break;
+    case Priority::Telemetry:
+        client.drops.telemetry++;
+        break;
+    }
+    sendBufferFullCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Hand queued frames to the sockets that have room again; responses and state before telemetry
+ */
+void WebSocketManager::drainOutboxes()
+{
+    if (queuedFrameCount == 0)
+    {
+        return;
+    }
+
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    for (auto &entry : clients)
+    {
+        ClientInfo &client = entry.second;
+        while (!client.outbox.empty() && ws.availableForWrite(entry.first))
+        {
+            auto next = std::find_if(client.outbox.begin(), client.outbox.end(), [](const OutgoingFrame &queued)
+                                     { return queued.priority != Priority::Telemetry; });
+            if (next == client.outbox.end())
+            {
+                next = client.outbox.begin();
+            }
+            writeFrame(entry.first, *next);
+            client.outboxBytes -= next->data->size();
+            client.outbox.erase(next);
+            queuedFrameCount--;
+        }
+    }
+    xSemaphoreGive(clientsMutex);
+}
+
+void WebSocketManager::beginBatch()
+{
+    batchingActive = true;
+    messageQueue.clear();
+}
+
+bool WebSocketManager::deferStateChange(const String &deviceId)
+{
+    if (!hasClients())
+    {
+        // Nobody gets the change, but its state and version are what the next snapshot and deltas build on
+        IControllable *ctrl = mixins::ControllableRegistry::get(deviceId);
+        JsonDocument doc;
+        if (ctrl && ctrl->addStateChangeToJson(doc))
+        {
+            history.skip();
+        }
+        return true;
+    }
+    if (batchingActive)
+    {
+        if (std::find(dirtyStates.begin(), dirtyStates.end(), deviceId) == dirtyStates.end())
+        {
+            dirtyStates.push_back(deviceId);
+        }
+        return true;
+    }
+
+    // Outside a batch send right away, tagged with the device so subscriptions apply
+    AllocTracker::Scope allocScope(AllocSubsystem::StateChange);
+    QueuedMessage message;
+    if (buildStateChange(deviceId, message))
+    {
+        queueOrSend(std::move(message));
+    }
+    return true;
+}
+
+bool WebSocketManager::buildStateChange(const String &deviceId, QueuedMessage &message)
+{
+    IControllable *ctrl = mixins::ControllableRegistry::get(deviceId);
+    if (!ctrl)
+    {
+        return false;
+    }
+    JsonDocument doc;
+    if (!ctrl->addStateChangeToJson(doc))
+    {
+        return false;
+    }
+    message = makeDeviceMessage(doc, deviceId);
+    return true;
+}
+
+WebSocketManager::QueuedMessage WebSocketManager::makeDeviceMessage(const JsonDocument &doc, const String &deviceId)
+{
+    QueuedMessage message;
+    serializeJson(doc, message.json);
+    if (hasMsgPackClients())
+    {
+        encodeMsgPack(doc, message.msgpack);
+    }
+    message.deviceId = deviceId;
+    message.priority = Priority::State;
+    Device *device = deviceManager ? deviceManager->getDeviceById(deviceId) : nullptr;
+    if (device)
+    {
+        message.deviceType = device->getType();
+    }
+    return message;
+}
+
+void WebSocketManager::flushDirtyStates()
+{
+    if (dirtyStates.empty())
+    {
+        return;
+    }
+
+    AllocTracker::Scope allocScope(AllocSubsystem::StateChange);
+    for (const String &deviceId : dirtyStates)
+    {
+        // Bounded by the number of devices, so not counted against kMaxQueuedBatchMessages
+        QueuedMessage message;
+        if (buildStateChange(deviceId, message))
+        {
+            messageQueue.push_back(std::move(message));
+        }
+    }
+    dirtyStates.clear();
+}
+
+void WebSocketManager::endBatch()
+{
+    batchingActive = false;
+    flushDirtyStates();
+
+    if (!hasClients() || messageQueue.empty())
+    {
+        if (!messageQueue.empty())
+        {
+            history.skip();
+        }
+        messageQueue.clear();
+        return;
+    }
+
+    sendMessages(messageQueue);
+    messageQueue.clear();
+}
+
+WebSocketManager::Encoding WebSocketManager::getClientEncoding(uint32_t clientId)
+{
+    if (!clientsMutex)
     {
-        MLOG_ERROR("devices-config JSON overflowed!");
+        return Encoding::Json;
     }
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    const Encoding encoding = it != clients.end() ? it->second.encoding : Encoding::Json;
+    xSemaphoreGive(clientsMutex);
+    return encoding;
+}
 
-    String respStr;
-    serializeJson(response, respStr);
-    MLOG_DEBUG("devices-config serialized: %d bytes", respStr.length());
-    notifyClients(respStr);
+WebSocketManager::DropStats WebSocketManager::getDropStats() const
+{
+    DropStats drops;
+    drops.batchQueueFull = batchQueueFullCount.load(std::memory_order_relaxed);
+    drops.sendBufferFull = sendBufferFullCount.load(std::memory_order_relaxed);
+    drops.commandQueueFull = commandQueueFullCount.load(std::memory_order_relaxed);
+    return drops;
 }
 
-void WebSocketManager::onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+WebSocketManager::ClientDropStats WebSocketManager::getClientDropStats(uint32_t clientId)
 {
-    switch (type)
-    {
-    case WS_EVT_CONNECT:
+    if (!clientsMutex)
     {
-        MLOG_INFO("WebSocket client #%u connected from %s", client->id(), client->remoteIP().toString().c_str());
-
-        // Send welcome message with connection info
-        String welcome = "{\"type\":\"connection\",\"message\":\"WebSocket connected\",\"clientId\":" + String(client->id()) + "}";
-        client->text(welcome);
-        break;
+        return ClientDropStats();
     }
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    const ClientDropStats drops = it != clients.end() ? it->second.drops : ClientDropStats();
+    xSemaphoreGive(clientsMutex);
+    return drops;
+}
 
-    case WS_EVT_DISCONNECT:
-        MLOG_INFO("WebSocket client #%u disconnected", client->id());
-        break;
+void WebSocketManager::handleGetClientStats(const WsRequest &request, JsonDocument &doc)
+{
+    if (!hasClients())
+        return;
 
-    case WS_EVT_DATA:
+    JsonDocument response;
+    response["type"] = "client-stats";
+    const DropStats serverDrops = getDropStats();
+    response["batchQueueFull"] = serverDrops.batchQueueFull;
+    response["commandQueueFull"] = serverDrops.commandQueueFull;
+    JsonObject snapshotObj = response["snapshot"].to<JsonObject>();
+    snapshotObj["bytes"] = snapshot.json ? snapshot.json->size() : 0;
+    snapshotObj["builds"] = snapshot.builds;
+    snapshotObj["sent"] = snapshot.sent;
+    JsonObject historyObj = response["history"].to<JsonObject>();
+    historyObj["seq"] = history.getLastSeq();
+    historyObj["oldestSeq"] = history.getOldestSeq();
+    historyObj["messages"] = history.getMessageCount();
+    historyObj["bytes"] = history.getUsedBytes();
+    historyObj["capacity"] = history.getCapacity();
+    historyObj["psram"] = history.isInPsram();
+    historyObj["resumes"] = resumes;
+    historyObj["resumesRefused"] = resumesRefused;
+    JsonArray clientsArray = response["clients"].to<JsonArray>();
+
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    for (const auto &entry : clients)
+    {
+        const ClientInfo &client = entry.second;
+        JsonObject clientObj = clientsArray.add<JsonObject>();
+        clientObj["id"] = entry.first;
+        clientObj["encoding"] = client.encoding == Encoding::MsgPack ? "msgpack" : "json";
+        clientObj["filtered"] = client.filtered;
+        clientObj["telemetryStreams"] = client.telemetry.size();
+        clientObj["queuedFrames"] = client.outbox.size();
+        clientObj["queuedBytes"] = client.outboxBytes;
+        JsonObject drops = clientObj["drops"].to<JsonObject>();
+        drops["responses"] = client.drops.responses;
+        drops["states"] = client.drops.states;
+        drops["telemetry"] = client.drops.telemetry;
+        drops["telemetrySuperseded"] = client.drops.telemetrySuperseded;
+    }
+    xSemaphoreGive(clientsMutex);
+
+    reply(request, response);
+}
+
+void WebSocketManager::handleSetEncoding(const WsRequest &request, JsonDocument &doc)
+{
+    const uint32_t clientId = request.clientId;
+    const String name = doc["encoding"] | "json";
+    if (clientId == 0 || (name != "json" && name != "msgpack"))
     {
-        AwsFrameInfo *info = (AwsFrameInfo *)arg;
-        if (info->opcode == WS_TEXT)
-        {
-            if (info->final && info->index == 0 && info->len == len)
-            {
-                // Single frame message
-                data[len] = 0;
-                String message = (char *)data;
-                parseMessage(message);
-            }
-            else
-            {
-                // Multi-frame message
-                if (info->index == 0)
-                {
-                    messageBuffers[client->id()] = String((char *)data, len);
-                }
-                else
-                {
-                    auto it = messageBuffers.find(client->id());
-                    if (it != messageBuffers.end())
-                    {
-                        it->second += String((char *)data, len);
-                    }
-                }
-                if (info->final)
-                {
-                    auto it = messageBuffers.find(client->id());
-                    if (it != messageBuffers.end())
-                    {
-                        String message = it->second;
-                        messageBuffers.erase(it);
-                        parseMessage(message);
-                    }
-                }
-            }
-        }
-        break;
+        reply(request, createJsonResponse(false, "Unknown encoding: " + name, "set-encoding"));
+        return;
     }
+    const Encoding encoding = name == "msgpack" ? Encoding::MsgPack : Encoding::Json;
 
-    case WS_EVT_PONG:
-        MLOG_INFO("WebSocket client #%u pong", client->id());
-        break;
-
-    case WS_EVT_ERROR:
-        MLOG_ERROR("WebSocket client #%u ERROR occurred", client->id());
-        break;
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it != clients.end())
+    {
+        it->second.encoding = encoding;
+        updateClientCounts();
     }
+    xSemaphoreGive(clientsMutex);
+    MLOG_INFO("WebSocket client #%u uses %s", clientId, name.c_str());
+
+    // Confirm to this client only, already in the new encoding
+    JsonDocument response = createJsonResponse(true, "Encoding set", "set-encoding");
+    response["encoding"] = name;
+    reply(request, response);
 }
 
-WebSocketManager::WebSocketManager(DeviceManager *deviceManager, Network *network, const char *path)
-    : ws(path), deviceManager(deviceManager), network(network), batchingActive(false)
+void WebSocketManager::handleSubscribe(const WsRequest &request, JsonDocument &doc)
 {
-    instance = this;
+    updateSubscription(request, doc, true);
 }
 
-void WebSocketManager::setup(AsyncWebServer &server)
+void WebSocketManager::handleUnsubscribe(const WsRequest &request, JsonDocument &doc)
 {
-    ws.onEvent([](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
-               {
-        if (instance) {
-            instance->onEvent(server, client, type, arg, data, len);
-        } });
-
-    server.addHandler(&ws);
-    MLOG_INFO("WebSocket manager: OK");
-    MLOG_INFO("WebSocket path: /ws");
-    MLOG_INFO("WebSocket server ready to accept connections");
+    updateSubscription(request, doc, false);
 }
 
-void WebSocketManager::loop()
+/**
+ * @brief Add or remove device ids/types from the requesting client's device-state subscriptions
+ *
+ * The first subscribe narrows the client from every device to the listed
+ * ones; {"all": true} on subscribe goes back to every device, on
+ * unsubscribe to none. The reply lists the resulting subscriptions.
+ */
+void WebSocketManager::updateSubscription(const WsRequest &request, JsonDocument &doc, bool subscribe)
 {
-    ws.cleanupClients();
-
-    // Check if async WiFi scan is complete
-    if (scanInProgress)
+    const char *type = subscribe ? "subscribe" : "unsubscribe";
+    const uint32_t clientId = request.clientId;
+    if (clientId == 0)
     {
-        int16_t numNetworks = WiFi.scanComplete();
-        if (numNetworks >= 0)
-        {
-            scanInProgress = false;
+        reply(request, createJsonResponse(false, "Subscriptions need a WebSocket client", type));
+        return;
+    }
 
-            if (!hasClients())
-                return;
+    JsonDocument response = createJsonResponse(true, subscribe ? "Subscribed" : "Unsubscribed", type);
+    const bool all = doc["all"] | false;
 
-            JsonDocument response;
-            response["type"] = "networks";
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it == clients.end())
+    {
+        xSemaphoreGive(clientsMutex);
+        return;
+    }
 
-            if (numNetworks == WIFI_SCAN_FAILED)
-            {
-                response["error"] = "WiFi scan failed";
-            }
-            else
+    ClientInfo &client = it->second;
+    if (all)
+    {
+        client.filtered = !subscribe;
+        client.deviceIds.clear();
+        client.deviceTypes.clear();
+    }
+    else
+    {
+        // Unsubscribing from single devices keeps a client that gets everything unchanged
+        client.filtered = client.filtered || subscribe;
+        const std::pair<const char *, std::set<String> *> lists[] = {
+            {"deviceIds", &client.deviceIds},
+            {"deviceTypes", &client.deviceTypes},
+        };
+        for (const auto &list : lists)
+        {
+            for (JsonVariant value : doc[list.first].as<JsonArray>())
             {
-                JsonArray networksArray = response["networks"].to<JsonArray>();
-
-                for (int i = 0; i < numNetworks; i++)
+                if (!value.is<const char *>())
                 {
-                    JsonObject networkObj = networksArray.add<JsonObject>();
-                    networkObj["ssid"] = WiFi.SSID(i);
-                    networkObj["rssi"] = WiFi.RSSI(i);
-                    networkObj["encryption"] = WiFi.encryptionType(i);
-                    networkObj["channel"] = WiFi.channel(i);
-                    networkObj["bssid"] = WiFi.BSSIDstr(i);
-                    networkObj["hidden"] = WiFi.SSID(i).isEmpty();
+                    continue;
+                }
+                if (subscribe)
+                {
+                    list.second->insert(value.as<String>());
+                }
+                else
+                {
+                    list.second->erase(value.as<String>());
                 }
-
-                response["count"] = numNetworks;
-                MLOG_INFO("Found %d WiFi networks", numNetworks);
             }
-
-            String respStr;
-            serializeJson(response, respStr);
-            notifyClients(respStr);
         }
     }
-}
 
-String WebSocketManager::getStatus() const
-{
-    return "{\"connectedClients\":" + String(ws.count()) + ",\"path\":\"/ws\"}";
-}
+    response["all"] = !client.filtered;
+    JsonArray deviceIds = response["deviceIds"].to<JsonArray>();
+    for (const String &id : client.deviceIds)
+    {
+        deviceIds.add(id);
+    }
+    JsonArray deviceTypes = response["deviceTypes"].to<JsonArray>();
+    for (const String &deviceType : client.deviceTypes)
+    {
+        deviceTypes.add(deviceType);
+    }
+    const bool filtered = client.filtered;
+    updateClientCounts();
+    xSemaphoreGive(clientsMutex);
 
-uint32_t WebSocketManager::getClientCount() const
-{
-    return ws.count();
+    MLOG_INFO("WebSocket client #%u subscriptions: %s, %u ids, %u types", clientId, filtered ? "filtered" : "all",
+              static_cast<unsigned>(deviceIds.size()), static_cast<unsigned>(deviceTypes.size()));
+    reply(request, response);
 }
 
-void WebSocketManager::notifyClients(String state)
+/**
+ * @brief Start, change or stop ({"rateHz": 0}) the telemetry stream of a device for the requesting client
+ */
+void WebSocketManager::handleTelemetry(const WsRequest &request, JsonDocument &doc)
 {
-    if (!hasClients())
+    const uint32_t clientId = request.clientId;
+    const String deviceId = doc["deviceId"] | "";
+    const int rateHz = doc["rateHz"] | 0;
+    if (clientId == 0)
+    {
+        reply(request, createJsonResponse(false, "Telemetry needs a WebSocket client", "telemetry", deviceId));
         return;
+    }
 
-    if (batchingActive)
+    if (rateHz > 0)
     {
-        // Queue message for batch sending
-        if (messageQueue.size() >= kMaxQueuedBatchMessages)
+        // Only devices that implement addTelemetryToJson() can stream
+        IControllable *ctrl = mixins::ControllableRegistry::get(deviceId);
+        JsonDocument probe;
+        if (!ctrl || !ctrl->addTelemetryToJson(probe.to<JsonObject>()))
         {
-            MLOG_WARN("WebSocket batch queue full (%u). Dropping message.", static_cast<unsigned>(kMaxQueuedBatchMessages));
+            reply(request, createJsonResponse(false, "Device has no telemetry: " + deviceId, "telemetry", deviceId));
             return;
         }
-
-        messageQueue.push_back(state);
     }
-    else
+
+    const uint32_t appliedHz = rateHz > 0 ? std::min(static_cast<uint32_t>(rateHz), kMaxTelemetryHz) : 0;
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    auto it = clients.find(clientId);
+    if (it != clients.end())
     {
-        if (!ws.availableForWriteAll())
+        if (appliedHz == 0)
         {
-            MLOG_WARN("WebSocket send buffer full. Dropping message.");
-            return;
+            it->second.telemetry.erase(deviceId);
         }
-
-        // Send immediately as array
-        String arrayMessage = "[" + state + "]";
-        MLOG_WS_SEND("%s", arrayMessage.c_str());
-        ws.textAll(arrayMessage);
+        else
+        {
+            TelemetryStream &stream = it->second.telemetry[deviceId];
+            stream.periodMs = 1000 / appliedHz;
+            stream.nextMs = millis();
+        }
+        updateClientCounts();
     }
-}
+    xSemaphoreGive(clientsMutex);
+    MLOG_INFO("WebSocket client #%u telemetry of %s at %u Hz", clientId, deviceId.c_str(), static_cast<unsigned>(appliedHz));
 
-void WebSocketManager::beginBatch()
-{
-    batchingActive = true;
-    messageQueue.clear();
+    JsonDocument response = createJsonResponse(true, appliedHz > 0 ? "Telemetry started" : "Telemetry stopped", "telemetry", deviceId);
+    response["rateHz"] = appliedHz;
+    reply(request, response);
 }
 
-void WebSocketManager::endBatch()
+/**
+ * @brief Send the due telemetry samples, one frame per client
+ *
+ * Samples are taken on the stream's own timer, not on state changes, so a
+ * moving device costs the same bandwidth however often it changes. A client
+ * that cannot keep up holds at most the latest sample per device.
+ */
+void WebSocketManager::sendTelemetry()
 {
-    batchingActive = false;
-
-    if (!hasClients() || messageQueue.empty())
+    if (telemetryStreamCount == 0)
     {
-        messageQueue.clear();
         return;
     }
 
-    if (!ws.availableForWriteAll())
+    const uint32_t now = millis();
+    // Sampled once per device and loop, shared by every client streaming it
+    struct Sample
     {
-        MLOG_WARN("WebSocket send buffer full. Dropping %u batched messages.", static_cast<unsigned>(messageQueue.size()));
-        messageQueue.clear();
-        return;
-    }
+        JsonDocument values;
+        String json; // Empty if the device is gone or has no telemetry
+    };
+    std::map<String, Sample> samples;
 
-    // Always send as array, even for single messages
-    String batchMessage = "[";
-
-    bool firstMessage = true;
-    for (size_t i = 0; i < messageQueue.size(); i++)
+    xSemaphoreTake(clientsMutex, portMAX_DELAY);
+    for (auto &entry : clients)
     {
-        // Skip empty messages to prevent double commas
-        if (messageQueue[i].isEmpty())
+        JsonDocument frame;
+        for (auto &streamEntry : entry.second.telemetry)
         {
-            continue;
+            TelemetryStream &stream = streamEntry.second;
+            if (static_cast<int32_t>(now - stream.nextMs) < 0)
+            {
+                continue;
+            }
+            // Keep the cadence; a late loop does not cause a burst of catch-up samples
+            stream.nextMs += stream.periodMs;
+            if (static_cast<int32_t>(now - stream.nextMs) >= 0)
+            {
+                stream.nextMs = now + stream.periodMs;
+            }
+
+            auto sample = samples.find(streamEntry.first);
+            if (sample == samples.end())
+            {
+                sample = samples.emplace(streamEntry.first, Sample()).first;
+                IControllable *ctrl = mixins::ControllableRegistry::get(streamEntry.first);
+                if (ctrl && ctrl->addTelemetryToJson(sample->second.values.to<JsonObject>()))
+                {
+                    serializeJson(sample->second.values, sample->second.json);
+                }
+            }
+            if (sample->second.json.isEmpty() || sample->second.json == stream.lastSample)
+            {
+                continue;
+            }
+
+            JsonObject message = frame.add<JsonObject>();
+            message["type"] = "telemetry";
+            message["deviceId"] = streamEntry.first;
+            message["t"] = now;
+            message["values"] = sample->second.values;
+            stream.lastSample = sample->second.json;
         }
 
-        if (!firstMessage)
+        if (frame.size() == 0)
         {
-            batchMessage += ",";
+            continue;
+        }
+        ClientInfo &client = entry.second;
+        if (client.outbox.empty() && ws.availableForWrite(entry.first))
+        {
+            writeFrame(entry.first, encodeFrame(frame, client.encoding, Priority::Telemetry));
+            continue;
+        }
+        // Backed up: one frame per device, so a newer sample replaces the queued one
+        for (JsonObject message : frame.as<JsonArray>())
+        {
+            JsonDocument single;
+            single.add(message);
+            OutgoingFrame outgoing = encodeFrame(single, client.encoding, Priority::Telemetry);
+            outgoing.telemetryDeviceId = message["deviceId"].as<String>();
+            enqueueFrame(entry.first, client, std::move(outgoing));
         }
-        firstMessage = false;
-
-        MLOG_WS_SEND("%s", messageQueue[i].c_str());
-        batchMessage += messageQueue[i];
     }
-
-    batchMessage += "]";
-
-    ws.textAll(batchMessage);
-
-    messageQueue.clear();
+    xSemaphoreGive(clientsMutex);
 }
 
 void WebSocketManager::setDeviceManager(DeviceManager *deviceManager)
@@ -815,7 +2426,7 @@ void WebSocketManager::setNetwork(Network *network)
     this->network = network;
 }
 
-void WebSocketManager::handleRestart()
+void WebSocketManager::handleRestart(const WsRequest &request)
 {
     if (!hasClients())
     {
@@ -823,14 +2434,14 @@ void WebSocketManager::handleRestart()
         return;
     }
 
-    String response = createJsonResponse(true, "Device restart initiated", "", "");
-    notifyClients(response);
+    JsonDocument response = createJsonResponse(true, "Device restart initiated");
+    broadcast(request, response);
     MLOG_INFO("Restarting device...");
     delay(1000);
     ESP.restart();
 }
 
-void WebSocketManager::handleDeviceFunction(JsonDocument &doc)
+void WebSocketManager::handleDeviceFunction(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -848,8 +2459,7 @@ void WebSocketManager::handleDeviceFunction(JsonDocument &doc)
 
     if (!deviceManager)
     {
-        String response = createJsonResponse(false, "DeviceManager not available", "", "", "device-fn", deviceId);
-        notifyClients(response);
+        reply(request, createJsonResponse(false, "DeviceManager not available", "device-fn", deviceId));
         return;
     }
 
@@ -882,7 +2492,7 @@ void WebSocketManager::handleDeviceFunction(JsonDocument &doc)
     }
 }
 
-void WebSocketManager::handleDeviceGetState(JsonDocument &doc)
+void WebSocketManager::handleDeviceGetState(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -892,9 +2502,7 @@ void WebSocketManager::handleDeviceGetState(JsonDocument &doc)
 
     if (!deviceManager)
     {
-        String response;
-        response = createJsonResponse(false, "No DeviceManager available", "", "device-state", deviceId);
-        notifyClients(response);
+        reply(request, createJsonResponse(false, "No DeviceManager available", "device-state", deviceId));
         return;
     }
 
@@ -908,18 +2516,18 @@ void WebSocketManager::handleDeviceGetState(JsonDocument &doc)
             IControllable *ctrl = mixins::ControllableRegistry::get(deviceId);
             if (ctrl)
             {
-                JsonDocument stateDoc;
-                ctrl->addStateToJson(stateDoc);
+                // Send everyone what is not sent yet, so the reply is a version all clients share and deltas stay valid
+                deferStateChange(deviceId);
 
                 JsonDocument responseDoc;
                 responseDoc["type"] = "device-state";
                 responseDoc["success"] = true;
                 responseDoc["deviceId"] = deviceId;
-                responseDoc["state"] = stateDoc;
-
-                String response;
-                serializeJson(responseDoc, response);
-                notifyClients(response);
+                if (!ctrl->addLastStateToJson(responseDoc))
+                {
+                    ctrl->addStateSnapshotToJson(responseDoc);
+                }
+                reply(request, responseDoc);
                 return;
             }
         }
@@ -929,20 +2537,15 @@ void WebSocketManager::handleDeviceGetState(JsonDocument &doc)
         responseDoc["success"] = true;
         responseDoc["deviceId"] = deviceId;
         responseDoc["state"] = nullptr;
-
-        String response;
-        serializeJson(responseDoc, response);
-        notifyClients(response);
+        reply(request, responseDoc);
         return;
     }
 
     MLOG_ERROR("Device not found for state request: %s", deviceId.c_str());
-    String response;
-    response = createJsonResponse(false, "Device not found or not controllable: " + deviceId, "", "", "device-state", deviceId);
-    notifyClients(response);
+    reply(request, createJsonResponse(false, "Device not found or not controllable: " + deviceId, "device-state", deviceId));
 }
 
-void WebSocketManager::handleAddDevice(JsonDocument &doc)
+void WebSocketManager::handleAddDevice(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -955,18 +2558,14 @@ void WebSocketManager::handleAddDevice(JsonDocument &doc)
     if (deviceType.isEmpty() || deviceId.isEmpty())
     {
         response["error"] = "Missing deviceType or deviceId";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
     if (!deviceManager)
     {
         response["error"] = "DeviceManager not available";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -974,9 +2573,7 @@ void WebSocketManager::handleAddDevice(JsonDocument &doc)
     if (deviceManager->getDeviceById(deviceId) != nullptr)
     {
         response["error"] = "Device with ID '" + deviceId + "' already exists";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -984,9 +2581,7 @@ void WebSocketManager::handleAddDevice(JsonDocument &doc)
     if (!deviceManager->addDevice(deviceType, deviceId, doc["config"]))
     {
         response["error"] = "Failed to create and add device of type '" + deviceType + "' with ID '" + deviceId + "'";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -994,7 +2589,7 @@ void WebSocketManager::handleAddDevice(JsonDocument &doc)
     Device *newDevice = deviceManager->getDeviceById(deviceId);
     if (newDevice != nullptr)
     {
-        newDevice->setup();
+        deviceManager->setupDevice(newDevice);
     }
 
     // Save devices to file
@@ -1002,20 +2597,18 @@ void WebSocketManager::handleAddDevice(JsonDocument &doc)
 
     response["success"] = true;
     response["deviceId"] = deviceId;
-    String respStr;
-    serializeJson(response, respStr);
-    notifyClients(respStr);
+    reply(request, response);
 
     // Broadcast updated device list to all clients
     JsonDocument emptyDoc;
-    handleGetDevices(emptyDoc);
+    handleGetDevices(WsRequest(), emptyDoc);
 
     deviceManager->notifyDevicesChanged();
 
     // MLOG_INFO("Added device: %s (%s)", deviceId.c_str(), deviceType.c_str());
 }
 
-void WebSocketManager::handleRemoveDevice(JsonDocument &doc)
+void WebSocketManager::handleRemoveDevice(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -1027,27 +2620,21 @@ void WebSocketManager::handleRemoveDevice(JsonDocument &doc)
     if (deviceId.isEmpty())
     {
         response["error"] = "Missing deviceId";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
     if (!deviceManager)
     {
         response["error"] = "DeviceManager not available";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
     if (!deviceManager->removeDevice(deviceId))
     {
         response["error"] = "Device not found or failed to remove: " + deviceId;
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -1056,20 +2643,18 @@ void WebSocketManager::handleRemoveDevice(JsonDocument &doc)
 
     response["success"] = true;
     response["deviceId"] = deviceId;
-    String respStr;
-    serializeJson(response, respStr);
-    notifyClients(respStr);
+    reply(request, response);
 
     // Broadcast updated device list to all clients
     JsonDocument emptyDoc;
-    handleGetDevices(emptyDoc);
+    handleGetDevices(WsRequest(), emptyDoc);
 
     deviceManager->notifyDevicesChanged();
 
     MLOG_INFO("Removed device: %s", deviceId.c_str());
 }
 
-void WebSocketManager::handleReorderDevices(JsonDocument &doc)
+void WebSocketManager::handleReorderDevices(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -1080,18 +2665,14 @@ void WebSocketManager::handleReorderDevices(JsonDocument &doc)
     if (!doc["deviceIds"].is<JsonArray>())
     {
         response["error"] = "Missing or invalid deviceIds array";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
     if (!deviceManager)
     {
         response["error"] = "DeviceManager not available";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -1109,9 +2690,7 @@ void WebSocketManager::handleReorderDevices(JsonDocument &doc)
     if (deviceIds.empty())
     {
         response["error"] = "No valid device IDs provided";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -1119,9 +2698,7 @@ void WebSocketManager::handleReorderDevices(JsonDocument &doc)
     if (!deviceManager->reorderDevices(deviceIds))
     {
         response["error"] = "Failed to reorder devices";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -1129,18 +2706,16 @@ void WebSocketManager::handleReorderDevices(JsonDocument &doc)
     deviceManager->saveDevicesToJsonFile();
 
     response["success"] = true;
-    String respStr;
-    serializeJson(response, respStr);
-    notifyClients(respStr);
+    reply(request, response);
 
     // Broadcast updated device list to all clients
     JsonDocument emptyDoc;
-    handleGetDevices(emptyDoc);
+    handleGetDevices(WsRequest(), emptyDoc);
 
     MLOG_INFO("Reordered devices");
 }
 
-void WebSocketManager::handleGetNetworkConfig(JsonDocument &doc)
+void WebSocketManager::handleGetNetworkConfig(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -1151,9 +2726,7 @@ void WebSocketManager::handleGetNetworkConfig(JsonDocument &doc)
     if (!deviceManager)
     {
         response["error"] = "DeviceManager not available";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -1169,14 +2742,12 @@ void WebSocketManager::handleGetNetworkConfig(JsonDocument &doc)
         response["error"] = "No network settings found";
     }
 
-    String respStr;
-    serializeJson(response, respStr);
-    notifyClients(respStr);
+    reply(request, response);
 
     MLOG_INFO("Sent network config to client");
 }
 
-void WebSocketManager::handleSetNetworkConfig(JsonDocument &doc)
+void WebSocketManager::handleSetNetworkConfig(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -1190,18 +2761,14 @@ void WebSocketManager::handleSetNetworkConfig(JsonDocument &doc)
     if (ssid.isEmpty())
     {
         response["error"] = "SSID cannot be empty";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
     if (!network)
     {
         response["error"] = "Network not available";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
         return;
     }
 
@@ -1236,26 +2803,20 @@ void WebSocketManager::handleSetNetworkConfig(JsonDocument &doc)
 
     // Notify clients with updated network config
     JsonDocument emptyDoc;
-    handleGetNetworkConfig(emptyDoc);
+    handleGetNetworkConfig(WsRequest(), emptyDoc);
 
-    String respStr;
-    serializeJson(response, respStr);
-    notifyClients(respStr);
+    reply(request, response);
 }
 
-void WebSocketManager::handleGetNetworks(JsonDocument &doc)
+void WebSocketManager::handleGetNetworks(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
 
+    // Every request made while the scan runs gets its result
+    scanRequests.push_back(request);
     if (scanInProgress)
     {
-        JsonDocument response;
-        response["type"] = "networks";
-        response["error"] = "Scan already in progress";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
         return;
     }
 
@@ -1265,7 +2826,7 @@ void WebSocketManager::handleGetNetworks(JsonDocument &doc)
     WiFi.scanNetworks(true); // Start async scan
 }
 
-void WebSocketManager::handleGetNetworkStatus(JsonDocument &doc)
+void WebSocketManager::handleGetNetworkStatus(const WsRequest &request, JsonDocument &doc)
 {
     if (!hasClients())
         return;
@@ -1276,34 +2837,98 @@ void WebSocketManager::handleGetNetworkStatus(JsonDocument &doc)
     if (!network)
     {
         response["error"] = "Network not available";
-        String respStr;
-        serializeJson(response, respStr);
-        notifyClients(respStr);
+        reply(request, response);
+        return;
+    }
+
+    network->addStatusToJson(response["status"].to<JsonObject>());
+
+    reply(request, response);
+
+    MLOG_INFO("Sent network status to client");
+}
+
+// Types of responses:
+// Info requested
+// Event (Button clicked)
+// State change (Led on/blinking)
+
+void WebSocketManager::handleGetLoopStats(const WsRequest &request, JsonDocument &doc)
+{
+    if (!hasClients())
+        return;
+
+    JsonDocument response;
+    response["type"] = "loop-stats";
+
+    if (!deviceManager)
+    {
+        response["error"] = "DeviceManager not available";
+        reply(request, response);
         return;
     }
 
-    String statusJson = network->getStatusJSON();
+    JsonObject mainLoop = response["mainLoop"].to<JsonObject>();
+    LoopProfiler::getMainLoopPeriod().toJson(mainLoop["period"].to<JsonObject>());
+    LoopProfiler::getMainLoopDuration().toJson(mainLoop["duration"].to<JsonObject>());
 
-    // Parse the status JSON and add it to the response
-    JsonDocument statusDoc;
-    if (deserializeJson(statusDoc, statusJson) == DeserializationError::Ok)
+    JsonArray devicesArray = response["devices"].to<JsonArray>();
+    for (Device *device : deviceManager->getAllDevices())
     {
-        response["status"] = statusDoc.as<JsonObject>();
+        JsonObject deviceObj = devicesArray.add<JsonObject>();
+        deviceObj["id"] = device->getId();
+        deviceObj["type"] = device->getType();
+        device->getLoopStats().toJson(deviceObj["total"].to<JsonObject>());
+        device->getSelfLoopStats().toJson(deviceObj["self"].to<JsonObject>());
     }
-    else
+
+    // Reset after reporting so the next request covers a fresh window
+    if (doc["reset"] | false)
     {
-        response["error"] = "Failed to parse network status";
+        deviceManager->resetLoopStats();
     }
 
-    String respStr;
-    serializeJson(response, respStr);
+    reply(request, response);
+}
+
+void WebSocketManager::handleGetAllocStats(const WsRequest &request, JsonDocument &doc)
+{
+    if (!hasClients())
+        return;
 
-    notifyClients(respStr);
+    JsonDocument response;
+    response["type"] = "alloc-stats";
+    AllocTracker::toJson(response.as<JsonObject>());
 
-    MLOG_INFO("Sent network status to client");
+    // Heap kept per root device, children included
+    if (deviceManager)
+    {
+        JsonArray devicesArr = response["devices"].to<JsonArray>();
+        deviceManager->forEachRootDevice([&](Device *root)
+                                         {
+            JsonObject deviceObj = devicesArr.add<JsonObject>();
+            deviceObj["id"] = root->getId();
+            deviceObj["type"] = root->getType();
+            deviceObj["heapBytes"] = root->getHeapBytes(); });
+    }
+
+    // Reset after reporting so the next request covers a fresh window
+    if (doc["reset"] | false)
+    {
+        AllocTracker::reset();
+    }
+
+    reply(request, response);
 }
 
-// Types of responses:
-// Info requested
-// Event (Button clicked)
-// State change (Led on/blinking)
+void WebSocketManager::handleGetBootStats(const WsRequest &request, JsonDocument &doc)
+{
+    if (!hasClients())
+        return;
+
+    JsonDocument response;
+    response["type"] = "boot-stats";
+    BootProfiler::toJson(response.as<JsonObject>());
+
+    reply(request, response);
+}
@@ -0,0 +1,147 @@
+#include "WsCapture.h"
+#include "Logging.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <atomic>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+String WsCapture::path = WsCapture::DEFAULT_PATH;
+unsigned long WsCapture::startMs = 0;
+uint32_t WsCapture::recordedCount = 0;
+uint32_t WsCapture::droppedCount = 0;
+
+namespace
+{
+    std::atomic<bool> active{false};
+
+    // Guards pendingRecords; records come from async_tcp, the main loop writes them out
+    SemaphoreHandle_t pendingMutex = nullptr;
+    std::vector<String> pendingRecords;
+}
+
+bool WsCapture::start(const String &newPath)
+{
+    if (!pendingMutex)
+    {
+        pendingMutex = xSemaphoreCreateMutex();
+    }
+    if (active)
+    {
+        stop();
+    }
+
+    File file = LittleFS.open(newPath, FILE_WRITE);
+    if (!file)
+    {
+        MLOG_ERROR("WebSocket capture: cannot create %s", newPath.c_str());
+        return false;
+    }
+    file.close();
+
+    path = newPath;
+    startMs = millis();
+    recordedCount = 0;
+    droppedCount = 0;
+    active = true;
+
+    MLOG_INFO("WebSocket capture started: %s", path.c_str());
+    return true;
+}
+
+void WsCapture::stop()
+{
+    if (!active)
+    {
+        return;
+    }
+    active = false;
+    flush();
+
+    MLOG_INFO("WebSocket capture stopped: %u records in %s (%u dropped)", recordedCount, path.c_str(), droppedCount);
+}
+
+bool WsCapture::isActive()
+{
+    return active;
+}
+
+void WsCapture::record(uint32_t clientId, Event event, const String &message)
+{
+    if (!active)
+    {
+        return;
+    }
+
+    JsonDocument doc;
+    doc["t"] = millis() - startMs;
+    doc["client"] = clientId;
+    doc["event"] = getEventName(event);
+    if (event == Event::Message)
+    {
+        doc["data"] = message;
+    }
+    String line;
+    serializeJson(doc, line);
+
+    xSemaphoreTake(pendingMutex, portMAX_DELAY);
+    if (pendingRecords.size() >= MAX_PENDING_RECORDS)
+    {
+        droppedCount++;
+    }
+    else
+    {
+        pendingRecords.push_back(std::move(line));
+        recordedCount++;
+    }
+    xSemaphoreGive(pendingMutex);
+}
+
+void WsCapture::loop()
+{
+    if (active)
+    {
+        flush();
+    }
+}
+
+void WsCapture::flush()
+{
+    std::vector<String> records;
+    xSemaphoreTake(pendingMutex, portMAX_DELAY);
+    records.swap(pendingRecords);
+    xSemaphoreGive(pendingMutex);
+
+    if (records.empty())
+    {
+        return;
+    }
+
+    File file = LittleFS.open(path, FILE_APPEND);
+    if (!file)
+    {
+        MLOG_ERROR("WebSocket capture: cannot append to %s, stopping", path.c_str());
+        active = false;
+        return;
+    }
+    for (const String &record : records)
+    {
+        file.println(record);
+    }
+    file.close();
+}
+
+const char *WsCapture::getEventName(Event event)
+{
+    switch (event)
+    {
+    case Event::Connect:
+        return "connect";
+    case Event::Disconnect:
+        return "disconnect";
+    case Event::Message:
+        return "message";
+    }
+    return "unknown";
+}
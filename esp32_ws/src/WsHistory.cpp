@@ -0,0 +1,143 @@
+#include "WsHistory.h"
+#include "Logging.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef MARBLE_NATIVE
+#include <esp_heap_caps.h>
+#endif
+
+size_t WsHistory::formatSeqPrefix(char (&prefix)[kSeqPrefixSize], uint32_t seq)
+{
+    const int length = snprintf(prefix, sizeof(prefix), "{\"seq\":%u", static_cast<unsigned>(seq));
+    return std::min(static_cast<size_t>(std::max(length, 0)), sizeof(prefix) - 1);
+}
+
+WsHistory::WsHistory(size_t capacity) : capacity(capacity)
+{
+}
+
+WsHistory::~WsHistory()
+{
+#ifdef MARBLE_NATIVE
+    free(buffer);
+#else
+    heap_caps_free(buffer);
+#endif
+}
+
+bool WsHistory::begin()
+{
+    if (buffer)
+    {
+        return true;
+    }
+
+#ifdef MARBLE_NATIVE
+    buffer = static_cast<uint8_t *>(malloc(capacity));
+#else
+    // Bypasses the tracked malloc: a long-lived block that would otherwise dominate the stats
+    buffer = static_cast<uint8_t *>(heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM));
+    inPsram = buffer != nullptr;
+    if (!buffer)
+    {
+        buffer = static_cast<uint8_t *>(heap_caps_malloc(capacity, MALLOC_CAP_8BIT));
+    }
+#endif
+
+    if (!buffer)
+    {
+        MLOG_ERROR("WebSocket history: cannot allocate %u bytes", static_cast<unsigned>(capacity));
+        return false;
+    }
+    MLOG_INFO("WebSocket history: %u bytes in %s", static_cast<unsigned>(capacity), inPsram ? "PSRAM" : "internal RAM");
+    return true;
+}
+
+void WsHistory::append(uint32_t seq, const char *json, size_t length)
+{
+    if (!buffer)
+    {
+        return;
+    }
+    if (length > capacity)
+    {
+        // Cannot be held; everything before it is useless without it
+        entries.clear();
+        usedBytes = 0;
+        return;
+    }
+
+    while (usedBytes + length > capacity)
+    {
+        evictOldest();
+    }
+
+    const size_t first = std::min(length, capacity - head);
+    memcpy(buffer + head, json, first);
+    memcpy(buffer, json + first, length - first);
+
+    entries.push_back({seq, head, length});
+    head = (head + length) % capacity;
+    usedBytes += length;
+}
+
+void WsHistory::evictOldest()
+{
+    usedBytes -= entries.front().length;
+    entries.pop_front();
+}
+
+std::deque<WsHistory::Entry>::const_iterator WsHistory::firstAfter(uint32_t seq) const
+{
+    return std::upper_bound(entries.begin(), entries.end(), seq, [](uint32_t value, const Entry &entry)
+                            { return value < entry.seq; });
+}
+
+size_t WsHistory::frameLength(std::deque<Entry>::const_iterator from) const
+{
+    size_t length = 1; // Brackets, minus the comma the first message does not have
+    for (auto it = from; it != entries.end(); ++it)
+    {
+        length += it->length + 1;
+    }
+    return std::max<size_t>(length, 2);
+}
+
+bool WsHistory::canResume(uint32_t seq, size_t maxLength) const
+{
+    if (seq > lastSeq)
+    {
+        return false;
+    }
+    // Seqs are unique and ascending, so the count only matches if none is missing
+    const auto from = firstAfter(seq);
+    return static_cast<uint32_t>(entries.end() - from) == lastSeq - seq && frameLength(from) <= maxLength;
+}
+
+bool WsHistory::writeSince(uint32_t seq, std::vector<uint8_t> &out, size_t maxLength) const
+{
+    if (!canResume(seq, maxLength))
+    {
+        return false;
+    }
+
+    const auto from = firstAfter(seq);
+    out.clear();
+    out.reserve(frameLength(from));
+    out.push_back('[');
+    for (auto it = from; it != entries.end(); ++it)
+    {
+        if (it != from)
+        {
+            out.push_back(',');
+        }
+        const size_t first = std::min(it->length, capacity - it->offset);
+        out.insert(out.end(), buffer + it->offset, buffer + it->offset + first);
+        out.insert(out.end(), buffer, buffer + (it->length - first));
+    }
+    out.push_back(']');
+    return true;
+}
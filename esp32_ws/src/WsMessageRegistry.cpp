@@ -0,0 +1,74 @@
+#include "WsMessageRegistry.h"
+#include "Logging.h"
+#include <map>
+
+namespace
+{
+    struct Entry
+    {
+        String type;
+        WsMessageRegistry::Handler handler;
+    };
+
+    // Function-local so handlers can be registered from other static initializers
+    std::map<uint32_t, Entry> &registry()
+    {
+        static std::map<uint32_t, Entry> s_registry;
+        return s_registry;
+    }
+
+    // Set once, before the command task that calls find() starts
+    bool s_sealed = false;
+}
+
+bool WsMessageRegistry::registerHandler(const char *type, Handler handler)
+{
+    if (s_sealed)
+    {
+        MLOG_ERROR("WebSocket message type '%s' registered after setup; ignored", type);
+        return false;
+    }
+    const uint32_t key = hash(type);
+    auto it = registry().find(key);
+    if (it != registry().end() && it->second.type != type)
+    {
+        MLOG_ERROR("WebSocket message type '%s' collides with '%s'", type, it->second.type.c_str());
+        return false;
+    }
+    registry()[key] = Entry{String(type), std::move(handler)};
+    return true;
+}
+
+void WsMessageRegistry::unregisterHandler(const char *type)
+{
+    if (s_sealed)
+    {
+        MLOG_ERROR("WebSocket message type '%s' unregistered after setup; ignored", type);
+        return;
+    }
+    auto it = registry().find(hash(type));
+    if (it != registry().end() && it->second.type == type)
+    {
+        registry().erase(it);
+    }
+}
+
+const WsMessageRegistry::Handler *WsMessageRegistry::find(const char *type)
+{
+    auto it = registry().find(hash(type));
+    if (it == registry().end() || it->second.type != type)
+    {
+        return nullptr;
+    }
+    return &it->second.handler;
+}
+
+size_t WsMessageRegistry::getHandlerCount()
+{
+    return registry().size();
+}
+
+void WsMessageRegistry::seal()
+{
+    s_sealed = true;
+}
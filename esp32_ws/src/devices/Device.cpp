@@ -32,6 +32,7 @@ void Device::teardown()
     }
 
     _isInitialized = false;
+    _setupHeapBytes = 0;
 }
 
 void Device::loop()
@@ -45,11 +46,30 @@ void Device::loop()
     {
         if (child)
         {
-            child->loop();
+            _childLoopUs += child->runLoop();
         }
     }
 }
 
+uint32_t Device::runLoop()
+{
+    const uint32_t start = micros();
+    _childLoopUs = 0;
+
+    loop();
+
+    const uint32_t elapsed = micros() - start;
+    _loopStats.record(elapsed);
+    _selfLoopStats.record(elapsed > _childLoopUs ? elapsed - _childLoopUs : 0);
+    return elapsed;
+}
+
+void Device::resetLoopStats()
+{
+    _loopStats.reset();
+    _selfLoopStats.reset();
+}
+
 void Device::addChild(Device *child)
 {
     if (child)
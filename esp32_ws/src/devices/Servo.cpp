@@ -163,6 +163,16 @@ namespace devices
         }
     }
 
+    bool Servo::addTelemetryToJson(JsonObject obj)
+    {
+        // value follows updateAnimation(), which only notifies at the start and end of a move
+        xSemaphoreTake(_stateMutex, portMAX_DELAY);
+        obj["value"] = _state.value;
+        obj["running"] = _state.running;
+        xSemaphoreGive(_stateMutex);
+        return true;
+    }
+
     bool Servo::control(const String &action, JsonObject *args)
     {
         if (action == "setValue")
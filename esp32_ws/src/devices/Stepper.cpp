@@ -374,6 +374,15 @@ namespace devices
         }
     }
 
+    bool Stepper::addTelemetryToJson(JsonObject obj)
+    {
+        xSemaphoreTake(_stateMutex, portMAX_DELAY);
+        obj["currentPosition"] = _state.currentPosition;
+        obj["isMoving"] = _state.isMoving;
+        xSemaphoreGive(_stateMutex);
+        return true;
+    }
+
     bool Stepper::control(const String &action, JsonObject *args)
     {
         if (action == "move")
@@ -458,6 +458,18 @@ namespace devices
         doc["stepsInLastRevolution"] = _state.stepsInLastRevolution;
     }
 
+    bool Wheel::addTelemetryToJson(JsonObject obj)
+    {
+        if (!_stepper)
+        {
+            return false;
+        }
+        // currentAngle in the state is only refreshed on state changes; follow the stepper here
+        obj["currentAngle"] = computeCurrentAngle();
+        obj["isMoving"] = _stepper->getState().isMoving;
+        return true;
+    }
+
     bool Wheel::control(const String &action, JsonObject *args)
     {
         if (action == "next-breakpoint")
@@ -618,22 +630,24 @@ namespace devices
 
     void Wheel::updateCurrentAngle()
     {
-        if (_state.lastZeroPosition != 0 && _config.stepsPerRevolution > 0)
-        {
-            long currentPosition = _stepper->getState().currentPosition;
-            long stepsFromZero = currentPosition - _state.lastZeroPosition;
-            float angle = (stepsFromZero * 360.0f) / _config.stepsPerRevolution;
-            // Normalize angle to 0-360 range
-            while (angle < 0)
-                angle += 360;
-            while (angle >= 360)
-                angle -= 360;
-            _state.currentAngle = angle;
-        }
-        else
+        _state.currentAngle = computeCurrentAngle();
+    }
+
+    float Wheel::computeCurrentAngle() const
+    {
+        if (_state.lastZeroPosition == 0 || _config.stepsPerRevolution <= 0)
         {
-            _state.currentAngle = -1.0f;
+            return -1.0f;
         }
+        long currentPosition = _stepper->getState().currentPosition;
+        long stepsFromZero = currentPosition - _state.lastZeroPosition;
+        float angle = (stepsFromZero * 360.0f) / _config.stepsPerRevolution;
+        // Normalize angle to 0-360 range
+        while (angle < 0)
+            angle += 360;
+        while (angle >= 360)
+            angle -= 360;
+        return angle;
     }
 
 } // namespace devices
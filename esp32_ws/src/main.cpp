@@ -3,8 +3,11 @@
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 #include "pins/Pins.h"
+#include "AllocTracker.h"
+#include "BootProfiler.h"
 #include "Config.h"
 #include "Logging.h"
+#include "LoopStats.h"
 #include "Network.h"
 #include "WebsiteHost.h"
 #include "WebSocketManager.h"
@@ -79,13 +82,23 @@ void setup()
   MLOG_INFO("Build version: %s %s", __DATE__, __TIME__);
 
   // First mount so config file can be loaded
-  littleFSManager.setup();
+  {
+    BootProfiler::Phase phase("littlefs");
+    littleFSManager.setup();
+  }
 
   // Load logging settings from configuration
-  deviceManager.loadLoggingSettings();
+  {
+    BootProfiler::Phase phase("logging-settings");
+    deviceManager.loadLoggingSettings();
+  }
 
   // Load network settings from configuration
-  NetworkSettings networkSettings = deviceManager.loadNetworkSettings();
+  NetworkSettings networkSettings;
+  {
+    BootProfiler::Phase phase("network-settings");
+    networkSettings = deviceManager.loadNetworkSettings();
+  }
 
   // Create network instance with loaded settings
   network = new Network(networkSettings);
@@ -94,7 +107,11 @@ void setup()
   serialConsole = new SerialConsole(deviceManager, network, &wsManager);
 
   // Initialize Network (will try WiFi, fall back to AP if needed)
-  bool networkInitialized = network->setup();
+  bool networkInitialized = false;
+  {
+    BootProfiler::Phase phase("network");
+    networkInitialized = network->setup();
+  }
 
   if (!networkInitialized)
   {
@@ -105,6 +122,7 @@ void setup()
     String hostnameStr = network->getHostname();
     MLOG_INFO("Network ready, hostname: %s.local", hostnameStr.c_str());
 
+    BootProfiler::Phase phase("ota");
     OtaUpload::setup(*network, server);
   }
 
@@ -112,10 +130,16 @@ void setup()
   websiteHost = new WebsiteHost(network);
 
   // Initialize WebsiteHost with the network instance
-  websiteHost->setup(server);
+  {
+    BootProfiler::Phase phase("website");
+    websiteHost->setup(server);
+  }
 
   // Setup WebSocket with message handler
-  wsManager.setup(server);
+  {
+    BootProfiler::Phase phase("websocket");
+    wsManager.setup(server);
+  }
   wsManager.setDeviceManager(&deviceManager);
   wsManager.setNetwork(network);
 
@@ -132,13 +156,22 @@ void setup()
   server.begin();
 
   // Try to load devices from JSON file
-  deviceManager.loadDevicesFromJsonFile();
+  {
+    BootProfiler::Phase phase("load-devices");
+    deviceManager.loadDevicesFromJsonFile();
+  }
 
   // Setup  Devices with callback to enable state change notifications during initialization
-  deviceManager.setup();
+  {
+    BootProfiler::Phase phase("device-setup");
+    deviceManager.setup();
+  }
 
   // Setup pin factory to resolve expander addresses
-  PinFactory::setup();
+  {
+    BootProfiler::Phase phase("pin-factory");
+    PinFactory::setup();
+  }
 
   // Set callback for device changes
   deviceManager.setOnDevicesChanged([]()
@@ -203,12 +236,22 @@ void setup()
 
   // State change broadcasting is now enabled during setup
 
+  BootProfiler::finish();
+  serialConsole->logBootStats();
+
   MLOG_INFO("System initialization complete!");
   MLOG_INFO("--------------------------");
 }
 
 void loop()
 {
+  LoopProfiler::beginMainLoop();
+  AllocTracker::Scope allocScope(AllocSubsystem::MainLoop);
+  AllocTracker::loop();
+
+  // WebSocket commands run on their own task, between iterations of this loop
+  WebSocketManager::CommandPause commandPause(wsManager);
+
   // Begin batching WebSocket messages for this loop iteration
   wsManager.beginBatch();
 
@@ -247,4 +290,6 @@ void loop()
 
   // Send all batched WebSocket messages at once
   wsManager.endBatch();
+
+  LoopProfiler::endMainLoop();
 }
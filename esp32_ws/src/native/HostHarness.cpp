@@ -0,0 +1,60 @@
+#include "HostHarness.h"
+
+#include <LittleFS.h>
+#include <NativeHal.h>
+
+#include <fstream>
+
+#include "devices/Device.h"
+#include "devices/mixins/ControllableMixin.h"
+
+AsyncWebServer server(80);
+WebSocketManager wsManager(nullptr, nullptr, "/ws");
+
+void globalNotifyClientsCallback(const String &message)
+{
+  if (wsManager.hasClients())
+  {
+    wsManager.notifyClients(message);
+  }
+}
+
+DeviceManager deviceManager(globalNotifyClientsCallback);
+
+namespace hostharness
+{
+  namespace
+  {
+    bool copyFile(const char *from, const String &to)
+    {
+      std::ifstream in(from, std::ios::binary);
+      if (!in)
+      {
+        return false;
+      }
+      std::ofstream out(to.c_str(), std::ios::binary | std::ios::trunc);
+      out << in.rdbuf();
+      return static_cast<bool>(out);
+    }
+  }
+
+  bool installConfig(const char *configPath)
+  {
+    LittleFS.begin(true);
+    if (!copyFile(configPath, nativehal::getFsRoot() + "/config.json"))
+    {
+      fprintf(stderr, "Cannot copy %s into %s\n", configPath, nativehal::getFsRoot().c_str());
+      return false;
+    }
+    return true;
+  }
+
+  void setupWebSocket()
+  {
+    wsManager.setup(server);
+    wsManager.setDeviceManager(&deviceManager);
+    deviceManager.setHasClients([]()
+                                { return wsManager.hasClients(); });
+    ControllableMixin<Device>::setNotifyClients(globalNotifyClientsCallback);
+  }
+}
@@ -0,0 +1,40 @@
+/**
+ * @file HostHarness.h
+ * @brief Firmware globals and startup shared by the native programs
+ *
+ * main.cpp defines the web server, the WebSocketManager and the
+ * DeviceManager as globals that firmware code refers to. Every native
+ * program (the host build and the tools in bench/, sim/, replay/, load/)
+ * links this harness instead of defining its own copies.
+ */
+
+#ifndef HOST_HARNESS_H
+#define HOST_HARNESS_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "WebSocketManager.h"
+#include "DeviceManager.h"
+
+extern AsyncWebServer server;
+extern WebSocketManager wsManager;
+extern DeviceManager deviceManager;
+
+void globalNotifyClientsCallback(const String &message);
+
+namespace hostharness
+{
+  /**
+   * @brief Mount the simulated LittleFS and copy configPath into it as /config.json
+   * @return false (after printing why) if the file cannot be copied
+   */
+  bool installConfig(const char *configPath);
+
+  /**
+   * @brief Start the WebSocket endpoint and connect it to the devices, like main.cpp's setup()
+   */
+  void setupWebSocket();
+}
+
+#endif // HOST_HARNESS_H
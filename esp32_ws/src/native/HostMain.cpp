@@ -0,0 +1,232 @@
+/**
+ * @file HostMain.cpp
+ * @brief Entry point for the native (PC) build of the firmware
+ *
+ * Mirrors main.cpp without OTA and the website host, on top of the
+ * simulated HAL in lib/NativeHal. Lines read from stdin starting with
+ * '{' are delivered as WebSocket messages from a synthetic client, all
+ * other lines go to the serial console. Outgoing WebSocket messages are
+ * printed to stdout prefixed with "ws> ", binary (MessagePack) frames as
+ * hex prefixed with "ws bin> ".
+ *
+ * Usage: program [--fs <dir>] [--config <config.json>] [--run-ms <ms>]
+ */
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <LittleFS.h>
+#include <NativeHal.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "pins/Pins.h"
+#include "AllocTracker.h"
+#include "BootProfiler.h"
+#include "Logging.h"
+#include "LoopStats.h"
+#include "Network.h"
+#include "WebSocketManager.h"
+#include "DeviceManager.h"
+#include "LittleFSManager.h"
+#include "SerialConsole.h"
+#include "HostHarness.h"
+
+Network *network = nullptr;
+LittleFSManager littleFSManager;
+SerialConsole *serialConsole = nullptr;
+
+namespace
+{
+  std::mutex inputMutex;
+  std::deque<std::string> inputLines;
+  std::atomic<bool> inputClosed{false};
+
+  void readStdin()
+  {
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+      std::lock_guard<std::mutex> lock(inputMutex);
+      inputLines.push_back(line);
+    }
+    inputClosed = true;
+  }
+}
+
+void setup()
+{
+  MLOG_INFO("Starting Marble Track System (native)");
+
+  {
+    BootProfiler::Phase phase("littlefs");
+    littleFSManager.setup();
+  }
+  {
+    BootProfiler::Phase phase("logging-settings");
+    deviceManager.loadLoggingSettings();
+  }
+
+  NetworkSettings networkSettings;
+  {
+    BootProfiler::Phase phase("network-settings");
+    networkSettings = deviceManager.loadNetworkSettings();
+  }
+  network = new Network(networkSettings);
+  serialConsole = new SerialConsole(deviceManager, network, &wsManager);
+  {
+    BootProfiler::Phase phase("network");
+    network->setup();
+  }
+
+  {
+    BootProfiler::Phase phase("websocket");
+    hostharness::setupWebSocket();
+  }
+  wsManager.setNetwork(network);
+
+  server.begin();
+
+  {
+    BootProfiler::Phase phase("load-devices");
+    deviceManager.loadDevicesFromJsonFile();
+  }
+  {
+    BootProfiler::Phase phase("device-setup");
+    deviceManager.setup();
+  }
+  {
+    BootProfiler::Phase phase("pin-factory");
+    PinFactory::setup();
+  }
+
+  BootProfiler::finish();
+  serialConsole->logBootStats();
+
+  MLOG_INFO("System initialization complete!");
+  MLOG_INFO("--------------------------");
+}
+
+void loop()
+{
+  LoopProfiler::beginMainLoop();
+  AllocTracker::Scope allocScope(AllocSubsystem::MainLoop);
+  AllocTracker::loop();
+  WebSocketManager::CommandPause commandPause(wsManager);
+  wsManager.beginBatch();
+
+  if (serialConsole)
+  {
+    serialConsole->loop();
+  }
+
+  littleFSManager.loop();
+
+  if (network)
+  {
+    network->loop();
+    network->processCaptivePortal();
+  }
+
+  wsManager.loop();
+  deviceManager.loop();
+
+  wsManager.endBatch();
+  LoopProfiler::endMainLoop();
+}
+
+int main(int argc, char **argv)
+{
+  const char *configPath = nullptr;
+  unsigned long runMs = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--fs") == 0 && i + 1 < argc)
+    {
+      nativehal::setFsRoot(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+    {
+      configPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--run-ms") == 0 && i + 1 < argc)
+    {
+      runMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      fprintf(stderr, "Usage: %s [--fs <dir>] [--config <config.json>] [--run-ms <ms>]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  LittleFS.begin(true);
+  if (configPath && !hostharness::installConfig(configPath))
+  {
+    return 1;
+  }
+
+  setup();
+
+  // A single synthetic browser tab; everything it receives is echoed to stdout
+  AsyncWebSocket *ws = server.webSocket("/ws");
+  AsyncWebSocketClient *client = ws->connect([](AsyncWebSocketClient *, const String &data, bool binary)
+                                             {
+                                               if (!binary)
+                                               {
+                                                 printf("ws> %s\n", data.c_str());
+                                                 return;
+                                               }
+                                               printf("ws bin> ");
+                                               for (size_t i = 0; i < data.length(); i++)
+                                               {
+                                                 printf("%02x", static_cast<uint8_t>(data[i]));
+                                               }
+                                               printf("\n"); });
+  const uint32_t clientId = client->id();
+
+  std::thread(readStdin).detach();
+
+  const unsigned long startMs = millis();
+  while (runMs == 0 || millis() - startMs < runMs)
+  {
+    const bool stdinDone = inputClosed;
+    std::deque<std::string> lines;
+    {
+      std::lock_guard<std::mutex> lock(inputMutex);
+      lines.swap(inputLines);
+    }
+    for (const std::string &line : lines)
+    {
+      if (!line.empty() && line[0] == '{')
+      {
+        ws->receive(clientId, String(line.c_str()));
+      }
+      else
+      {
+        nativehal::pushSerialInput(String(line.c_str()) + "\n");
+      }
+    }
+
+    loop();
+
+    if (runMs == 0 && stdinDone && lines.empty())
+    {
+      // Let the last command's effects flush through one more iteration
+      loop();
+      break;
+    }
+    delay(1);
+  }
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(0);
+}
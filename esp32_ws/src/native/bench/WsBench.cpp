@@ -0,0 +1,387 @@
+/**
+ * @file WsBench.cpp
+ * @brief Microbenchmark for the WebSocket command path (native build)
+ *
+ * Loads a device config, connects a number of synthetic WebSocket clients
+ * and feeds messages through WebSocketManager::parseMessage(), the same
+ * entry point used by the WebSocket event handler. For every message type
+ * it reports throughput, p50/p99 latency, heap allocations and bytes per
+ * message, and the bytes sent to each client. The clients resume and are
+ * sent their snapshot before anything is measured, so broadcasts reach them.
+ * Every message is sent as coming from the first client, so replies go to
+ * it only, as they would on the board.
+ *
+ * Messages come from a recording (one JSON message per line, e.g. copied
+ * from the browser devtools) or, by default, are generated from the loaded
+ * config: device-fn, device-state, devices-list, device-save-config and
+ * devices-config.
+ *
+ * Usage: program --config <config.json> [--messages <file>] [--iterations <n>]
+ *                [--warmup <n>] [--clients <n>] [--fs <dir>] [--log]
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <NativeHal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AllocTracker.h"
+#include "Logging.h"
+#include "WebSocketManager.h"
+#include "DeviceManager.h"
+#include "devices/Device.h"
+#include "devices/mixins/SerializableMixin.h"
+#include "../HostHarness.h"
+
+namespace
+{
+  using SteadyClock = std::chrono::steady_clock;
+
+  // A client that resumes is served within a few loop() calls, one that stays silent after 500 ms
+  constexpr unsigned long SNAPSHOT_TIMEOUT_MS = 2000;
+
+  struct Options
+  {
+    const char *configPath = nullptr;
+    const char *messagesPath = nullptr;
+    unsigned long iterations = 1000;
+    unsigned long warmup = 50;
+    unsigned long clients = 3;
+    bool log = false;
+  };
+
+  struct Scenario
+  {
+    String type;
+    std::vector<String> messages;
+  };
+
+  struct Result
+  {
+    std::vector<uint64_t> latenciesNs;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t sentBytes = 0;
+    uint64_t sentMessages = 0;
+  };
+
+  std::atomic<uint64_t> gSentBytes{0};
+  std::atomic<uint64_t> gSentMessages{0};
+
+  void usage(const char *program)
+  {
+    fprintf(stderr, "Usage: %s --config <config.json> [--messages <file>] [--iterations <n>] [--warmup <n>] [--clients <n>] [--fs <dir>] [--log]\n", program);
+  }
+
+  String toJson(JsonDocument &doc)
+  {
+    String out;
+    serializeJson(doc, out);
+    return out;
+  }
+
+  Scenario &scenarioFor(std::vector<Scenario> &scenarios, const String &type)
+  {
+    for (Scenario &scenario : scenarios)
+    {
+      if (scenario.type == type)
+      {
+        return scenario;
+      }
+    }
+    scenarios.push_back({type, {}});
+    return scenarios.back();
+  }
+
+  /**
+   * @brief Load recorded messages, grouped by their "type" field
+   */
+  bool loadRecordedMessages(const char *path, std::vector<Scenario> &scenarios)
+  {
+    std::ifstream in(path);
+    if (!in)
+    {
+      fprintf(stderr, "Cannot open %s\n", path);
+      return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+      if (line.empty() || line[0] != '{')
+      {
+        continue;
+      }
+      JsonDocument doc;
+      if (deserializeJson(doc, line.c_str()))
+      {
+        fprintf(stderr, "Skipping invalid JSON: %s\n", line.c_str());
+        continue;
+      }
+      const String type = doc["type"] | "";
+      scenarioFor(scenarios, type.isEmpty() ? String("(untyped)") : type).messages.push_back(String(line.c_str()));
+    }
+    return true;
+  }
+
+  /**
+   * @brief Build a representative message set from the devices in the loaded config
+   */
+  void generateMessages(std::vector<Scenario> &scenarios)
+  {
+    std::vector<Device *> devices = deviceManager.getAllDevices();
+
+    Scenario &deviceFn = scenarioFor(scenarios, "device-fn");
+    for (Device *device : devices)
+    {
+      if (device->getType() == "led")
+      {
+        // Alternate on/off so a working LED broadcasts a state change on every call
+        for (bool value : {true, false})
+        {
+          JsonDocument doc;
+          doc["type"] = "device-fn";
+          doc["deviceId"] = device->getId();
+          doc["fn"] = "set";
+          doc["args"]["value"] = value;
+          deviceFn.messages.push_back(toJson(doc));
+        }
+        break;
+      }
+    }
+
+    Scenario &deviceState = scenarioFor(scenarios, "device-state");
+    for (Device *device : devices)
+    {
+      JsonDocument doc;
+      doc["type"] = "device-state";
+      doc["deviceId"] = device->getId();
+      deviceState.messages.push_back(toJson(doc));
+    }
+
+    scenarioFor(scenarios, "devices-list").messages.push_back("{\"type\":\"devices-list\"}");
+
+    // Re-save the current config of a leaf device: same payload the UI sends when pressing save
+    Scenario &saveConfig = scenarioFor(scenarios, "device-save-config");
+    for (Device *device : devices)
+    {
+      ISerializable *serializable = device->hasMixin("serializable") ? mixins::SerializableRegistry::get(device->getId()) : nullptr;
+      if (serializable && device->getChildren().empty())
+      {
+        JsonDocument config;
+        serializable->configToJson(config);
+
+        JsonDocument doc;
+        doc["type"] = "device-save-config";
+        doc["deviceId"] = device->getId();
+        doc["config"] = config;
+        saveConfig.messages.push_back(toJson(doc));
+        break;
+      }
+    }
+
+    scenarioFor(scenarios, "devices-config").messages.push_back("{\"type\":\"devices-config\"}");
+
+    scenarios.erase(std::remove_if(scenarios.begin(), scenarios.end(), [](const Scenario &s)
+                                   { return s.messages.empty(); }),
+                    scenarios.end());
+  }
+
+  uint64_t percentile(std::vector<uint64_t> &sorted, double p)
+  {
+    if (sorted.empty())
+    {
+      return 0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+  }
+
+  Result run(const Scenario &scenario, const Options &options, uint32_t clientId)
+  {
+    Result result;
+    result.latenciesNs.reserve(options.iterations);
+
+    for (unsigned long i = 0; i < options.warmup + options.iterations; i++)
+    {
+      const String &message = scenario.messages[i % scenario.messages.size()];
+      const bool measured = i >= options.warmup;
+
+      const uint64_t bytesBefore = gSentBytes;
+      const uint64_t messagesBefore = gSentMessages;
+
+      // parseMessage opens an AllocTracker scope, so only this thread's allocations are counted
+      const AllocTracker::SubsystemStats allocsBefore = AllocTracker::getSubsystemStats(AllocSubsystem::WebSocket);
+      const SteadyClock::time_point start = SteadyClock::now();
+
+      wsManager.parseMessage(message.c_str(), message.length(), clientId);
+
+      const SteadyClock::time_point end = SteadyClock::now();
+      const AllocTracker::SubsystemStats allocsAfter = AllocTracker::getSubsystemStats(AllocSubsystem::WebSocket);
+
+      if (measured)
+      {
+        result.latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        result.allocations += allocsAfter.allocations - allocsBefore.allocations;
+        result.allocatedBytes += allocsAfter.bytes - allocsBefore.bytes;
+        result.sentBytes += gSentBytes - bytesBefore;
+        result.sentMessages += gSentMessages - messagesBefore;
+      }
+    }
+    return result;
+  }
+
+  void printResult(const Scenario &scenario, Result &result, unsigned long clients)
+  {
+    std::vector<uint64_t> &lat = result.latenciesNs;
+    const size_t n = lat.size();
+    uint64_t totalNs = 0;
+    for (uint64_t ns : lat)
+    {
+      totalNs += ns;
+    }
+    std::sort(lat.begin(), lat.end());
+
+    const double msgsPerSec = totalNs > 0 ? n * 1e9 / static_cast<double>(totalNs) : 0;
+    printf("%-20s %8zu %12.0f %10.1f %10.1f %10.1f %10.1f %12.0f %12.0f\n",
+           scenario.type.c_str(),
+           n,
+           msgsPerSec,
+           percentile(lat, 0.50) / 1000.0,
+           percentile(lat, 0.99) / 1000.0,
+           lat.empty() ? 0.0 : lat.back() / 1000.0,
+           n ? static_cast<double>(result.allocations) / n : 0.0,
+           n ? static_cast<double>(result.allocatedBytes) / n : 0.0,
+           (n && clients) ? static_cast<double>(result.sentBytes) / n / clients : 0.0);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+    {
+      options.configPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc)
+    {
+      options.messagesPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+    {
+      options.iterations = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+    {
+      options.warmup = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+    {
+      options.clients = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--fs") == 0 && i + 1 < argc)
+    {
+      nativehal::setFsRoot(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--log") == 0)
+    {
+      options.log = true;
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!options.configPath || options.iterations == 0 || options.clients == 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Serial logging would dominate the timings and bury the report
+  if (!options.log)
+  {
+    LogConfig::setAll(false);
+  }
+
+  if (!hostharness::installConfig(options.configPath))
+  {
+    return 1;
+  }
+
+  hostharness::setupWebSocket();
+
+  deviceManager.loadDevicesFromJsonFile();
+  deviceManager.setup();
+
+  // Every open browser tab is a client; outgoing traffic is counted and discarded
+  AsyncWebSocket *ws = server.webSocket("/ws");
+  uint32_t requesterId = 0;
+  for (unsigned long i = 0; i < options.clients; i++)
+  {
+    AsyncWebSocketClient *client = ws->connect([](AsyncWebSocketClient *, const String &data, bool)
+                                               {
+                                                 gSentBytes += data.length();
+                                                 gSentMessages++; });
+    // Like the website after connecting; until its snapshot is out a client is skipped by every broadcast
+    ws->receive(client->id(), "{\"type\":\"resume\"}");
+    if (requesterId == 0)
+    {
+      requesterId = client->id();
+    }
+  }
+  const unsigned long snapshotStartMs = millis();
+  while (wsManager.hasAwaitingClients() && millis() - snapshotStartMs < SNAPSHOT_TIMEOUT_MS)
+  {
+    wsManager.loop();
+    delay(1);
+  }
+  if (wsManager.hasAwaitingClients())
+  {
+    fprintf(stderr, "Clients were not sent their snapshot within %lu ms\n", SNAPSHOT_TIMEOUT_MS);
+    return 1;
+  }
+
+  std::vector<Scenario> scenarios;
+  if (options.messagesPath)
+  {
+    if (!loadRecordedMessages(options.messagesPath, scenarios))
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    generateMessages(scenarios);
+  }
+
+  printf("%lu iterations per type (+%lu warmup), %lu clients, %u devices\n\n",
+         options.iterations, options.warmup, options.clients, static_cast<unsigned>(deviceManager.getAllDevices().size()));
+  printf("%-20s %8s %12s %10s %10s %10s %10s %12s %12s\n",
+         "type", "count", "msgs/s", "p50 us", "p99 us", "max us", "allocs", "alloc B", "out B/client");
+
+  for (const Scenario &scenario : scenarios)
+  {
+    Result result = run(scenario, options, requesterId);
+    printResult(scenario, result, options.clients);
+    fflush(stdout);
+  }
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(0);
+}
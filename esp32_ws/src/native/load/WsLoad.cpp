@@ -0,0 +1,475 @@
+/**
+ * @file WsLoad.cpp
+ * @brief WebSocket fan-out load generator for the host build
+ *
+ * In-process counterpart of scripts/ws_load.py: connects N synthetic
+ * clients to WebSocketManager, lets the first one send LED 'blink'
+ * commands at a fixed rate and measures per command the echo latency
+ * (command -> device-state at the sender) and the broadcast delivery time
+ * (command -> device-state at the last client). Each command uses a unique
+ * onTime, which the LED reports back in its state. Like the website,
+ * every client sends a resume message right after connecting, so its
+ * broadcasts are not held back waiting for one.
+ *
+ * Clients consume their send queue every --drain-ms (0 = every loop
+ * iteration) and are bounded by --queue-limit, like the library's
+ * per-client queue; broadcasts that never arrive count as missed. The
+ * first --slow-clients clients only drain every --slow-drain-ms, like a
+ * phone on weak WiFi; their misses are counted apart, so it shows whether
+ * one slow client costs the others messages. Steps through every
+ * combination of --clients and --rate and prints one row per step, plus the
+ * drops counted by WebSocketManager.
+ *
+ * Usage: program --config <config.json> [--clients <n,n,..>] [--rate <n,n,..>]
+ *                [--duration-ms <ms>] [--drain-ms <ms>] [--queue-limit <n>]
+ *                [--slow-clients <n>] [--slow-drain-ms <ms>]
+ *                [--device <led id>] [--fs <dir>] [--log]
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <NativeHal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Logging.h"
+#include "WebSocketManager.h"
+#include "DeviceManager.h"
+#include "devices/Device.h"
+#include "devices/Led.h"
+#include "pins/Pins.h"
+#include "../HostHarness.h"
+
+namespace
+{
+  using SteadyClock = std::chrono::steady_clock;
+
+  // onTime values used as command tags; far above anything a user would set
+  constexpr unsigned long TAG_BASE = 100000;
+
+  // GPIO used for the LED under test when its config puts it on an expander
+  constexpr int HOST_LED_GPIO = 48;
+
+  // A broadcast arriving later than this counts as missed
+  constexpr unsigned long DELIVERY_TIMEOUT_MS = 1000;
+
+  struct Options
+  {
+    const char *configPath = nullptr;
+    std::vector<unsigned long> clients = {1, 2, 4, 8};
+    std::vector<double> rates = {5, 20, 50, 100};
+    unsigned long durationMs = 3000;
+    unsigned long drainMs = 0;
+    unsigned long queueLimit = WS_MAX_QUEUED_MESSAGES;
+    unsigned long slowClients = 0;
+    unsigned long slowDrainMs = 500;
+    String deviceId;
+    bool log = false;
+  };
+
+  struct StepResult
+  {
+    uint32_t sent = 0;
+    uint32_t missed = 0;
+    uint32_t slowMissed = 0; // Misses of the --slow-clients clients
+    uint32_t clientQueueDrops = 0;
+    uint32_t closedByServer = 0;
+    std::vector<double> echoMs;
+    std::vector<double> deliveryMs;
+    WebSocketManager::DropStats serverDrops;
+  };
+
+  void usage(const char *program)
+  {
+    fprintf(stderr,
+            "Usage: %s --config <config.json> [--clients <n,n,..>] [--rate <n,n,..>]\n"
+            "          [--duration-ms <ms>] [--drain-ms <ms>] [--queue-limit <n>]\n"
+            "          [--slow-clients <n>] [--slow-drain-ms <ms>]\n"
+            "          [--device <led id>] [--fs <dir>] [--log]\n",
+            program);
+  }
+
+  template <typename T>
+  std::vector<T> parseList(const char *text, T (*parse)(const char *))
+  {
+    std::vector<T> values;
+    std::string item;
+    for (const char *p = text;; p++)
+    {
+      if (*p == ',' || *p == '\0')
+      {
+        if (!item.empty())
+        {
+          values.push_back(parse(item.c_str()));
+        }
+        item.clear();
+        if (*p == '\0')
+        {
+          break;
+        }
+      }
+      else
+      {
+        item += *p;
+      }
+    }
+    return values;
+  }
+
+  unsigned long parseUnsigned(const char *text)
+  {
+    return strtoul(text, nullptr, 10);
+  }
+
+  double parseDouble(const char *text)
+  {
+    return atof(text);
+  }
+
+  double elapsedMs(SteadyClock::time_point since, SteadyClock::time_point now)
+  {
+    return std::chrono::duration<double, std::milli>(now - since).count();
+  }
+
+  double percentile(std::vector<double> values, double p)
+  {
+    if (values.empty())
+    {
+      return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+  }
+
+  void loopOnce()
+  {
+    WebSocketManager::CommandPause commandPause(wsManager);
+    wsManager.beginBatch();
+    wsManager.loop();
+    deviceManager.loop();
+    wsManager.endBatch();
+  }
+
+  /**
+   * @brief Take everything queued for a client and note when each tagged device-state arrived
+   */
+  void drainClient(AsyncWebSocketClient *client, const String &deviceId, std::map<unsigned long, SteadyClock::time_point> &arrivals)
+  {
+    const SteadyClock::time_point now = SteadyClock::now();
+    for (const AsyncWebSocketClient::Message &frame : client->drain())
+    {
+      JsonDocument doc;
+      if (deserializeJson(doc, frame.data))
+      {
+        continue;
+      }
+      // Batches are arrays, single messages objects
+      JsonArray messages = doc.is<JsonArray>() ? doc.as<JsonArray>() : JsonArray();
+      auto handle = [&](JsonObject message)
+      {
+        if (message["type"] == "device-state" && message["deviceId"] == deviceId)
+        {
+          const unsigned long tag = message["state"]["blinkOnTime"] | 0UL;
+          if (tag >= TAG_BASE)
+          {
+            arrivals.emplace(tag, now);
+          }
+        }
+      };
+      if (messages.isNull())
+      {
+        handle(doc.as<JsonObject>());
+      }
+      for (JsonObject message : messages)
+      {
+        handle(message);
+      }
+    }
+  }
+
+  StepResult runStep(AsyncWebSocket *ws, const Options &options, unsigned long clientCount, double rate, unsigned long &tag)
+  {
+    StepResult result;
+    const WebSocketManager::DropStats dropsBefore = wsManager.getDropStats();
+
+    std::vector<uint32_t> ids;
+    for (unsigned long i = 0; i < clientCount; i++)
+    {
+      AsyncWebSocketClient *client = ws->connect();
+      client->setQueueLimit(options.queueLimit);
+      ws->receive(client->id(), "{\"type\":\"resume\"}");
+      ids.push_back(client->id());
+    }
+    std::vector<std::map<unsigned long, SteadyClock::time_point>> arrivals(clientCount);
+    std::vector<uint32_t> lastDropped(clientCount, 0);
+    std::map<unsigned long, SteadyClock::time_point> sentAt;
+
+    // cleanupClients() closes the oldest clients first; send from the newest
+    const uint32_t senderId = ids.back();
+    const unsigned long firstTag = tag;
+    const SteadyClock::time_point start = SteadyClock::now();
+    const double intervalMs = 1000.0 / rate;
+    std::vector<SteadyClock::time_point> lastDrain(clientCount, start);
+    auto isSlow = [&](unsigned long i)
+    {
+      return i < options.slowClients && ids[i] != senderId;
+    };
+
+    while (true)
+    {
+      const SteadyClock::time_point now = SteadyClock::now();
+      const double sinceStart = elapsedMs(start, now);
+      const bool sending = sinceStart < options.durationMs;
+      if (!sending && sinceStart >= options.durationMs + DELIVERY_TIMEOUT_MS)
+      {
+        break;
+      }
+
+      // Commands due by now, at a fixed rate from the start of the step
+      while (sending && (tag - firstTag) * intervalMs <= sinceStart && ws->client(senderId))
+      {
+        JsonDocument doc;
+        doc["type"] = "device-fn";
+        doc["deviceId"] = options.deviceId;
+        doc["fn"] = "blink";
+        doc["args"]["onTime"] = tag;
+        doc["args"]["offTime"] = 500;
+        String command;
+        serializeJson(doc, command);
+
+        sentAt[tag] = SteadyClock::now();
+        ws->receive(senderId, command);
+        tag++;
+      }
+
+      loopOnce();
+
+      for (unsigned long i = 0; i < clientCount; i++)
+      {
+        const unsigned long drainMs = isSlow(i) ? options.slowDrainMs : options.drainMs;
+        if (drainMs != 0 && elapsedMs(lastDrain[i], SteadyClock::now()) < drainMs)
+        {
+          continue;
+        }
+        lastDrain[i] = SteadyClock::now();
+        AsyncWebSocketClient *client = ws->client(ids[i]);
+        if (client)
+        {
+          drainClient(client, options.deviceId, arrivals[i]);
+          lastDropped[i] = client->droppedCount();
+        }
+      }
+      delay(1);
+    }
+
+    result.sent = sentAt.size();
+    for (const auto &entry : sentAt)
+    {
+      double latest = 0.0;
+      uint32_t delivered = 0;
+      uint32_t fastClients = 0;
+      for (unsigned long i = 0; i < clientCount; i++)
+      {
+        auto it = arrivals[i].find(entry.first);
+        const bool arrived = it != arrivals[i].end() && elapsedMs(entry.second, it->second) <= DELIVERY_TIMEOUT_MS;
+        if (isSlow(i))
+        {
+          result.slowMissed += arrived ? 0 : 1;
+          continue;
+        }
+        fastClients++;
+        if (!arrived)
+        {
+          continue;
+        }
+        const double ms = elapsedMs(entry.second, it->second);
+        if (ids[i] == senderId)
+        {
+          result.echoMs.push_back(ms);
+        }
+        latest = std::max(latest, ms);
+        delivered++;
+      }
+      result.missed += fastClients - delivered;
+      if (delivered == fastClients)
+      {
+        result.deliveryMs.push_back(latest);
+      }
+    }
+
+    for (unsigned long i = 0; i < clientCount; i++)
+    {
+      result.clientQueueDrops += lastDropped[i];
+      if (!ws->client(ids[i]))
+      {
+        result.closedByServer++;
+      }
+      ws->disconnect(ids[i]);
+    }
+    const WebSocketManager::DropStats dropsAfter = wsManager.getDropStats();
+    result.serverDrops.batchQueueFull = dropsAfter.batchQueueFull - dropsBefore.batchQueueFull;
+    result.serverDrops.sendBufferFull = dropsAfter.sendBufferFull - dropsBefore.sendBufferFull;
+    return result;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+    {
+      options.configPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+    {
+      options.clients = parseList<unsigned long>(argv[++i], parseUnsigned);
+    }
+    else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+    {
+      options.rates = parseList<double>(argv[++i], parseDouble);
+    }
+    else if (strcmp(argv[i], "--duration-ms") == 0 && i + 1 < argc)
+    {
+      options.durationMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--drain-ms") == 0 && i + 1 < argc)
+    {
+      options.drainMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--queue-limit") == 0 && i + 1 < argc)
+    {
+      options.queueLimit = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--slow-clients") == 0 && i + 1 < argc)
+    {
+      options.slowClients = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--slow-drain-ms") == 0 && i + 1 < argc)
+    {
+      options.slowDrainMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+    {
+      options.deviceId = argv[++i];
+    }
+    else if (strcmp(argv[i], "--fs") == 0 && i + 1 < argc)
+    {
+      nativehal::setFsRoot(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--log") == 0)
+    {
+      options.log = true;
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  const bool validLists = std::none_of(options.clients.begin(), options.clients.end(), [](unsigned long n)
+                                       { return n == 0; }) &&
+                          std::none_of(options.rates.begin(), options.rates.end(), [](double r)
+                                       { return r <= 0; });
+  if (!options.configPath || options.clients.empty() || options.rates.empty() || !validLists)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (!options.log)
+  {
+    LogConfig::setAll(false);
+  }
+
+  if (!hostharness::installConfig(options.configPath))
+  {
+    return 1;
+  }
+
+  hostharness::setupWebSocket();
+
+  deviceManager.loadDevicesFromJsonFile();
+
+  if (options.deviceId.isEmpty())
+  {
+    for (Device *device : deviceManager.getAllDevices())
+    {
+      if (device->getType() == "led")
+      {
+        options.deviceId = device->getId();
+        break;
+      }
+    }
+  }
+  Device *device = deviceManager.getDeviceById(options.deviceId);
+  if (!device || device->getType() != "led")
+  {
+    fprintf(stderr, "No LED '%s' in %s; pass --device\n", options.deviceId.c_str(), options.configPath);
+    return 1;
+  }
+
+  // The host build has no I/O expanders; move an expander LED to a GPIO so blink() works
+  auto *led = static_cast<devices::Led *>(device);
+  devices::LedConfig ledConfig = led->getConfig();
+  if (!ledConfig.pinConfig.expanderId.isEmpty())
+  {
+    ledConfig.pinConfig = PinConfig{"", HOST_LED_GPIO};
+    led->setConfig(ledConfig);
+  }
+
+  deviceManager.setup();
+
+  AsyncWebSocket *ws = server.webSocket("/ws");
+  printf("LED '%s', %lu ms per step, queue limit %lu, drain every %lu ms, %lu slow clients draining every %lu ms\n",
+         options.deviceId.c_str(), options.durationMs, options.queueLimit, options.drainMs, options.slowClients, options.slowDrainMs);
+  printf("%7s %7s %6s %9s %9s %9s %9s %9s %7s %8s %8s %8s %8s %6s\n",
+         "clients", "rate", "sent", "echo p50", "echo p99", "dlvr p50", "dlvr p99", "dlvr max",
+         "missed", "slowMiss", "batchQ", "outbox", "clientQ", "closed");
+
+  unsigned long tag = TAG_BASE;
+  bool dropsSeen = false;
+  for (unsigned long clients : options.clients)
+  {
+    for (double rate : options.rates)
+    {
+      StepResult result = runStep(ws, options, clients, rate, tag);
+      printf("%7lu %7.1f %6u %9.2f %9.2f %9.2f %9.2f %9.2f %7u %8u %8u %8u %8u %6u\n",
+             clients, rate, result.sent,
+             percentile(result.echoMs, 0.50), percentile(result.echoMs, 0.99),
+             percentile(result.deliveryMs, 0.50), percentile(result.deliveryMs, 0.99),
+             result.deliveryMs.empty() ? 0.0 : *std::max_element(result.deliveryMs.begin(), result.deliveryMs.end()),
+             result.missed, result.slowMissed, result.serverDrops.batchQueueFull, result.serverDrops.sendBufferFull,
+             result.clientQueueDrops, result.closedByServer);
+      fflush(stdout);
+
+      const bool drops = result.missed || result.serverDrops.batchQueueFull || result.serverDrops.sendBufferFull ||
+                         result.clientQueueDrops || result.closedByServer;
+      if (drops && !dropsSeen)
+      {
+        dropsSeen = true;
+        printf("        ^ first drops at %lu clients, %.1f commands/s\n", clients, rate);
+      }
+
+      // Let disconnects and cleanup settle before the next step
+      for (int i = 0; i < 10; i++)
+      {
+        loopOnce();
+      }
+    }
+  }
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(0);
+}
@@ -0,0 +1,429 @@
+/**
+ * @file WsReplay.cpp
+ * @brief Replays a captured WebSocket session against the firmware (native build)
+ *
+ * Reads a capture written by WsCapture (the 'ws-capture-start' serial
+ * command) and drives the same connects, disconnects and messages back
+ * into WebSocketManager, at the recorded pace (--rate 1), faster
+ * (--rate 10) or as fast as possible (--rate 0). With --clients N every
+ * captured client is fanned out to N synthetic clients that send the same
+ * traffic, e.g. to turn one browser tab reconnecting into N tabs
+ * reconnecting at once.
+ *
+ * Without --capture, the reconnect storm is generated from the config:
+ * every client connects, resumes, requests devices-list and then the
+ * config and state of every device, like the website does after a
+ * reconnect.
+ *
+ * Synthetic clients consume their send queue every --drain-ms (a browser
+ * busy rendering; 0 = instantly), so the per-client queue limit of the
+ * WebSocket library and the drops in WebSocketManager::notifyClients()
+ * show up like on the device.
+ *
+ * Usage: program --config <config.json> [--capture <file>] [--rate <x>] [--clients <n>]
+ *                [--drain-ms <ms>] [--queue-limit <n>] [--settle-ms <ms>] [--fs <dir>] [--log]
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <NativeHal.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Logging.h"
+#include "LoopStats.h"
+#include "WebSocketManager.h"
+#include "WsCapture.h"
+#include "DeviceManager.h"
+#include "devices/Device.h"
+#include "../HostHarness.h"
+
+namespace
+{
+  struct Options
+  {
+    const char *configPath = nullptr;
+    const char *capturePath = nullptr;
+    double rate = 1.0;
+    unsigned long clients = 1;
+    unsigned long drainMs = 20;
+    unsigned long queueLimit = WS_MAX_QUEUED_MESSAGES;
+    unsigned long settleMs = 1000;
+    bool log = false;
+  };
+
+  struct Record
+  {
+    unsigned long t;
+    uint32_t client;
+    WsCapture::Event event;
+    String data;
+  };
+
+  struct ClientStats
+  {
+    uint32_t received = 0;     // Frames taken from the send queue
+    uint64_t receivedBytes = 0;
+    uint32_t dropped = 0;      // Frames the library discarded because the queue was full
+    bool closedByServer = false;
+  };
+
+  // Synthetic ids per captured client id
+  std::map<uint32_t, std::vector<uint32_t>> fanOut;
+  std::map<uint32_t, ClientStats> clientStats;
+
+  void usage(const char *program)
+  {
+    fprintf(stderr,
+            "Usage: %s --config <config.json> [--capture <file>] [--rate <x>] [--clients <n>]\n"
+            "          [--drain-ms <ms>] [--queue-limit <n>] [--settle-ms <ms>] [--fs <dir>] [--log]\n",
+            program);
+  }
+
+  bool parseEvent(const String &name, WsCapture::Event &event)
+  {
+    for (WsCapture::Event candidate : {WsCapture::Event::Connect, WsCapture::Event::Disconnect, WsCapture::Event::Message})
+    {
+      if (name == WsCapture::getEventName(candidate))
+      {
+        event = candidate;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool loadCapture(const char *path, std::vector<Record> &records)
+  {
+    std::ifstream in(path);
+    if (!in)
+    {
+      fprintf(stderr, "Cannot open %s\n", path);
+      return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+      if (line.empty())
+      {
+        continue;
+      }
+      JsonDocument doc;
+      Record record;
+      if (deserializeJson(doc, line.c_str()) || !parseEvent(doc["event"] | "", record.event))
+      {
+        fprintf(stderr, "Skipping invalid record: %s\n", line.c_str());
+        continue;
+      }
+      record.t = doc["t"] | 0UL;
+      record.client = doc["client"] | 0U;
+      record.data = doc["data"] | "";
+      records.push_back(record);
+    }
+
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b)
+                     { return a.t < b.t; });
+    return true;
+  }
+
+  /**
+   * @brief The traffic of one browser tab reconnecting: devices-list, then config and state per device
+   */
+  void generateReconnectStorm(std::vector<Record> &records)
+  {
+    const uint32_t client = 1;
+    records.push_back({0, client, WsCapture::Event::Connect, ""});
+    records.push_back({0, client, WsCapture::Event::Message, "{\"type\":\"resume\"}"});
+    records.push_back({0, client, WsCapture::Event::Message, "{\"type\":\"devices-list\"}"});
+    for (Device *device : deviceManager.getAllDevices())
+    {
+      for (const char *type : {"device-read-config", "device-state"})
+      {
+        JsonDocument doc;
+        doc["type"] = type;
+        doc["deviceId"] = device->getId();
+        String message;
+        serializeJson(doc, message);
+        records.push_back({0, client, WsCapture::Event::Message, message});
+      }
+    }
+  }
+
+  void drainClient(AsyncWebSocket *ws, uint32_t id)
+  {
+    ClientStats &stats = clientStats[id];
+    AsyncWebSocketClient *client = ws->client(id);
+    if (!client)
+    {
+      return;
+    }
+    for (const AsyncWebSocketClient::Message &message : client->drain())
+    {
+      stats.received++;
+      stats.receivedBytes += message.data.length();
+    }
+    stats.dropped = client->droppedCount();
+  }
+
+  void replay(AsyncWebSocket *ws, const Record &record, const Options &options, std::map<String, uint32_t> &messageCounts)
+  {
+    std::vector<uint32_t> &ids = fanOut[record.client];
+
+    // Capture started mid-session: connect on the first message
+    if (ids.empty() && record.event != WsCapture::Event::Disconnect)
+    {
+      for (unsigned long i = 0; i < options.clients; i++)
+      {
+        AsyncWebSocketClient *client = ws->connect();
+        client->setQueueLimit(options.queueLimit);
+        if (options.drainMs == 0)
+        {
+          client->setSink([](AsyncWebSocketClient *c, const String &data, bool)
+                          {
+                            ClientStats &stats = clientStats[c->id()];
+                            stats.received++;
+                            stats.receivedBytes += data.length(); });
+        }
+        ids.push_back(client->id());
+        clientStats[client->id()];
+      }
+    }
+
+    switch (record.event)
+    {
+    case WsCapture::Event::Connect:
+      break;
+
+    case WsCapture::Event::Disconnect:
+      for (uint32_t id : ids)
+      {
+        drainClient(ws, id);
+        ws->disconnect(id);
+      }
+      ids.clear();
+      break;
+
+    case WsCapture::Event::Message:
+    {
+      JsonDocument doc;
+      deserializeJson(doc, record.data);
+      messageCounts[doc["type"] | "(untyped)"] += ids.size();
+      for (uint32_t id : ids)
+      {
+        ws->receive(id, record.data);
+      }
+      break;
+    }
+    }
+  }
+
+  void loopOnce()
+  {
+    LoopProfiler::beginMainLoop();
+    WebSocketManager::CommandPause commandPause(wsManager);
+    wsManager.beginBatch();
+    wsManager.loop();
+    deviceManager.loop();
+    wsManager.endBatch();
+    LoopProfiler::endMainLoop();
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+    {
+      options.configPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+    {
+      options.capturePath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+    {
+      options.rate = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+    {
+      options.clients = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--drain-ms") == 0 && i + 1 < argc)
+    {
+      options.drainMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--queue-limit") == 0 && i + 1 < argc)
+    {
+      options.queueLimit = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--settle-ms") == 0 && i + 1 < argc)
+    {
+      options.settleMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--fs") == 0 && i + 1 < argc)
+    {
+      nativehal::setFsRoot(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--log") == 0)
+    {
+      options.log = true;
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!options.configPath || options.clients == 0 || options.rate < 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (!options.log)
+  {
+    LogConfig::setAll(false);
+  }
+
+  if (!hostharness::installConfig(options.configPath))
+  {
+    return 1;
+  }
+
+  hostharness::setupWebSocket();
+
+  deviceManager.loadDevicesFromJsonFile();
+  deviceManager.setup();
+
+  std::vector<Record> records;
+  if (options.capturePath)
+  {
+    if (!loadCapture(options.capturePath, records))
+    {
+      return 1;
+    }
+  }
+  else
+  {
+    generateReconnectStorm(records);
+  }
+
+  AsyncWebSocket *ws = server.webSocket("/ws");
+  std::map<String, uint32_t> messageCounts;
+  LoopProfiler::reset();
+
+  // Records are due at their capture time divided by the rate; with rate 0 all are due at once
+  const unsigned long startMs = millis();
+  unsigned long lastDrainMs = startMs;
+  size_t next = 0;
+  unsigned long settleUntilMs = 0;
+  while (true)
+  {
+    const unsigned long elapsedMs = millis() - startMs;
+    while (next < records.size() && (options.rate == 0 || records[next].t / options.rate <= elapsedMs))
+    {
+      replay(ws, records[next++], options, messageCounts);
+    }
+
+    loopOnce();
+
+    if (options.drainMs > 0 && millis() - lastDrainMs >= options.drainMs)
+    {
+      lastDrainMs = millis();
+      for (const auto &entry : clientStats)
+      {
+        drainClient(ws, entry.first);
+      }
+    }
+
+    if (next == records.size())
+    {
+      if (settleUntilMs == 0)
+      {
+        settleUntilMs = millis() + options.settleMs;
+      }
+      else if (millis() >= settleUntilMs)
+      {
+        break;
+      }
+    }
+    delay(1);
+  }
+  const unsigned long durationMs = millis() - startMs;
+
+  // Final drain; clients missing by now were closed by the server (cleanupClients)
+  uint32_t replayedClients = 0;
+  for (auto &entry : clientStats)
+  {
+    drainClient(ws, entry.first);
+  }
+  for (const auto &entry : fanOut)
+  {
+    for (uint32_t id : entry.second)
+    {
+      if (!ws->client(id))
+      {
+        clientStats[id].closedByServer = true;
+      }
+    }
+  }
+
+  uint32_t totalReceived = 0;
+  uint32_t minReceived = UINT32_MAX;
+  uint32_t maxReceived = 0;
+  uint64_t totalBytes = 0;
+  uint32_t totalDropped = 0;
+  uint32_t maxDropped = 0;
+  uint32_t closedByServer = 0;
+  for (const auto &entry : clientStats)
+  {
+    const ClientStats &stats = entry.second;
+    replayedClients++;
+    totalReceived += stats.received;
+    minReceived = std::min(minReceived, stats.received);
+    maxReceived = std::max(maxReceived, stats.received);
+    totalBytes += stats.receivedBytes;
+    totalDropped += stats.dropped;
+    maxDropped = std::max(maxDropped, stats.dropped);
+    closedByServer += stats.closedByServer ? 1 : 0;
+  }
+
+  printf("Replayed %zu records from %s at %s over %zu captured x %lu = %u synthetic clients in %lu ms\n\n",
+         records.size(), options.capturePath ? options.capturePath : "generated reconnect storm",
+         options.rate == 0 ? "max rate" : (String("x") + String(options.rate, 1)).c_str(),
+         fanOut.size(), options.clients, replayedClients, durationMs);
+
+  printf("%-24s %8s\n", "inbound type", "count");
+  for (const auto &entry : messageCounts)
+  {
+    printf("%-24s %8u\n", entry.first.c_str(), entry.second);
+  }
+
+  const WebSocketManager::DropStats drops = wsManager.getDropStats();
+  const LoopStats &duration = LoopProfiler::getMainLoopDuration();
+  printf("\noutbound frames     %u total, per client min %u avg %.1f max %u (%.1f KB total)\n",
+         totalReceived, replayedClients ? minReceived : 0, replayedClients ? static_cast<double>(totalReceived) / replayedClients : 0.0,
+         maxReceived, totalBytes / 1024.0);
+  printf("dropped             batch queue full %u messages, client outbox full %u frames (all clients)\n",
+         drops.batchQueueFull, drops.sendBufferFull);
+  printf("                    client queue full %u frames (max %u on one client, queue limit %lu)\n",
+         totalDropped, maxDropped, options.queueLimit);
+  printf("closed by server    %u clients (max %u)\n", closedByServer, static_cast<unsigned>(DEFAULT_MAX_WS_CLIENTS));
+  printf("main loop           %u iterations, duration avg %u us p99 %u us max %u us\n",
+         duration.getCount(), duration.getAverage(), duration.getPercentile(99), duration.getMax());
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(0);
+}
@@ -0,0 +1,220 @@
+/**
+ * @file SimMain.cpp
+ * @brief Marble track simulator (native build)
+ *
+ * Runs the firmware's devices from a config file against TrackSim, a
+ * physics-lite model of the lift, the wheel and the marbles travelling
+ * between them. Time runs --speed times faster than real time (the native
+ * HAL scales millis()/micros() and the RTOS timeouts), so an hour of
+ * automatic operation takes well under a minute on a PC.
+ *
+ * Progress is printed every --report-min virtual minutes; the final report
+ * covers marbles per minute, lift stalls, device errors, load/unload misses
+ * and the main loop timing, to compare firmware changes against each other.
+ *
+ * Usage: program --config <config.json> [--fs <dir>] [--speed <x>] [--minutes <n>]
+ *                [--report-min <n>] [--marbles <n>] [--track-ms <ms>]
+ *                [--spiral-ms <ms>] [--lift-start <steps>] [--log]
+ */
+
+#include <Arduino.h>
+#include <NativeHal.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include "pins/Pins.h"
+#include "Logging.h"
+#include "LoopStats.h"
+#include "DeviceManager.h"
+#include "LittleFSManager.h"
+#include "TrackSim.h"
+#include "../HostHarness.h"
+
+LittleFSManager littleFSManager;
+
+namespace
+{
+  using SteadyClock = std::chrono::steady_clock;
+
+  struct Options
+  {
+    const char *configPath = nullptr;
+    double speed = 100.0;
+    double minutes = 60.0;
+    double reportMinutes = 10.0;
+    bool log = false;
+    sim::TrackSimConfig track;
+  };
+
+  void usage(const char *program)
+  {
+    fprintf(stderr,
+            "Usage: %s --config <config.json> [--fs <dir>] [--speed <x>] [--minutes <n>]\n"
+            "          [--report-min <n>] [--marbles <n>] [--track-ms <ms>]\n"
+            "          [--spiral-ms <ms>] [--lift-start <steps>] [--log]\n",
+            program);
+  }
+
+  double perMinute(uint32_t count, double minutes)
+  {
+    return minutes > 0 ? count / minutes : 0.0;
+  }
+
+  // LoopStats hold virtual microseconds; convert back to host time
+  double hostUs(uint32_t virtualUs, double speed)
+  {
+    return virtualUs / speed;
+  }
+
+  void printReport(sim::TrackSim &trackSim, const Options &options, double virtualMinutes, double realSeconds)
+  {
+    const sim::TrackSimStats stats = trackSim.getStats();
+    const LoopStats &duration = LoopProfiler::getMainLoopDuration();
+    const LoopStats &period = LoopProfiler::getMainLoopPeriod();
+
+    printf("\n=== Simulation report ===\n");
+    printf("time           %.1f virtual min in %.1f s (x%.0f)\n", virtualMinutes, realSeconds, options.speed);
+    printf("marbles        %d on the track\n", options.track.marbles);
+    printf("deliveries     %u (%.2f marbles/min)\n", stats.liftDeliveries, perMinute(stats.liftDeliveries, virtualMinutes));
+    printf("full loops     %u (%.2f marbles/min)\n", stats.loopsCompleted, perMinute(stats.loopsCompleted, virtualMinutes));
+    printf("longest gap    %.1f s between deliveries\n", stats.longestDeliveryGapMs / 1000.0);
+    printf("wheel          %u revolutions\n", stats.wheelRevolutions);
+    printf("lift stalls    %u (%u steps lost)\n", stats.liftStalls, stats.liftStalledSteps);
+    printf("errors         lift %u, wheel %u\n", stats.liftErrors, stats.wheelErrors);
+    printf("misses         load %u, unload %u\n", stats.loadMisses, stats.unloadMisses);
+    printf("main loop      %u iterations, duration avg %.1f us p99 %.1f us max %.1f us (host time)\n",
+           duration.getCount(),
+           hostUs(duration.getAverage(), options.speed),
+           hostUs(duration.getPercentile(99), options.speed),
+           hostUs(duration.getMax(), options.speed));
+    printf("               period avg %.1f us p99 %.1f us max %.1f us (host time)\n",
+           hostUs(period.getAverage(), options.speed),
+           hostUs(period.getPercentile(99), options.speed),
+           hostUs(period.getMax(), options.speed));
+    printf("state          %s\n", trackSim.describeState().c_str());
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--config") == 0 && i + 1 < argc)
+    {
+      options.configPath = argv[++i];
+    }
+    else if (strcmp(argv[i], "--fs") == 0 && i + 1 < argc)
+    {
+      nativehal::setFsRoot(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+    {
+      options.speed = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--minutes") == 0 && i + 1 < argc)
+    {
+      options.minutes = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--report-min") == 0 && i + 1 < argc)
+    {
+      options.reportMinutes = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--marbles") == 0 && i + 1 < argc)
+    {
+      options.track.marbles = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--track-ms") == 0 && i + 1 < argc)
+    {
+      options.track.trackTravelMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--spiral-ms") == 0 && i + 1 < argc)
+    {
+      options.track.spiralTravelMs = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (strcmp(argv[i], "--lift-start") == 0 && i + 1 < argc)
+    {
+      options.track.liftStartPosition = atol(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--log") == 0)
+    {
+      options.log = true;
+    }
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (!options.configPath || options.speed <= 0 || options.minutes <= 0)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  nativehal::setTimeScale(options.speed);
+
+  if (!hostharness::installConfig(options.configPath))
+  {
+    return 1;
+  }
+
+  littleFSManager.setup();
+  deviceManager.loadLoggingSettings();
+
+  // Serial logging at this speed would bury the report; applied after the config's log settings
+  if (!options.log)
+  {
+    LogConfig::setAll(false);
+  }
+
+  sim::TrackSim trackSim(options.track);
+  trackSim.installPins();
+  deviceManager.loadDevicesFromJsonFile();
+  if (!trackSim.attach(deviceManager))
+  {
+    return 1;
+  }
+  deviceManager.setup();
+  PinFactory::setup();
+
+  printf("Simulating %.0f min at x%.0f with %d marbles\n", options.minutes, options.speed, options.track.marbles);
+  fflush(stdout);
+
+  const SteadyClock::time_point realStart = SteadyClock::now();
+  const unsigned long startMs = millis();
+  const unsigned long endMs = startMs + static_cast<unsigned long>(options.minutes * 60000.0);
+  const unsigned long reportMs = static_cast<unsigned long>(options.reportMinutes * 60000.0);
+  unsigned long nextReportMs = startMs + reportMs;
+
+  for (unsigned long nowMs = startMs; nowMs < endMs; nowMs = millis())
+  {
+    LoopProfiler::beginMainLoop();
+    deviceManager.loop();
+    LoopProfiler::endMainLoop();
+
+    trackSim.update(nowMs);
+
+    if (reportMs > 0 && nowMs >= nextReportMs)
+    {
+      const sim::TrackSimStats stats = trackSim.getStats();
+      printf("[%6.1f min] deliveries %u, loops %u | %s\n",
+             (nowMs - startMs) / 60000.0, stats.liftDeliveries, stats.loopsCompleted, trackSim.describeState().c_str());
+      fflush(stdout);
+      nextReportMs += reportMs;
+    }
+
+    // Same pacing as the Arduino loop task on the device
+    delay(1);
+  }
+
+  const double realSeconds = std::chrono::duration<double>(SteadyClock::now() - realStart).count();
+  printReport(trackSim, options, (millis() - startMs) / 60000.0, realSeconds);
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(0);
+}
@@ -0,0 +1,440 @@
+#include "TrackSim.h"
+
+#include <ArduinoJson.h>
+#include <cstdio>
+
+namespace sim
+{
+  namespace
+  {
+    // Expander id used for pins the simulator adds to unconfigured devices
+    const char *const SIM_EXPANDER_ID = "sim";
+
+    // Servo pins used when the config has none (MCPWM needs a GPIO number)
+    const int SIM_SERVO_PINS[] = {62, 63};
+
+    Device *findChild(Device *parent, const String &suffix)
+    {
+      const String id = parent->getId() + suffix;
+      for (Device *child : parent->getChildren())
+      {
+        if (child->getId() == id)
+        {
+          return child;
+        }
+      }
+      return nullptr;
+    }
+
+    long positiveModulo(long value, long modulus)
+    {
+      const long result = value % modulus;
+      return result < 0 ? result + modulus : result;
+    }
+  }
+
+  TrackSim::TrackSim(const TrackSimConfig &config) : _config(config)
+  {
+    _waitingAtLift = config.marbles;
+  }
+
+  void TrackSim::installPins()
+  {
+    PinFactory::setPinCreator([this](const PinConfig &config) -> pins::IPin *
+                              { return new SimPin(*this, config.toString()); });
+  }
+
+  bool TrackSim::attach(DeviceManager &deviceManager)
+  {
+    for (Device *device : deviceManager.getAllDevices())
+    {
+      if (!_lift && device->getType() == "lift")
+      {
+        _lift = static_cast<devices::Lift *>(device);
+      }
+      else if (!_wheel && device->getType() == "wheel")
+      {
+        _wheel = static_cast<devices::Wheel *>(device);
+      }
+    }
+    if (!_lift)
+    {
+      fprintf(stderr, "TrackSim: config has no lift\n");
+      return false;
+    }
+
+    auto assignSimPin = [this](PinConfig &pin)
+    {
+      if (pin.pin < 0)
+      {
+        pin.expanderId = SIM_EXPANDER_ID;
+        pin.pin = _nextSimPin++;
+      }
+    };
+
+    auto wireStepper = [&](Device *device, SimStepper &model) -> bool
+    {
+      if (!device || device->getType() != "stepper")
+      {
+        return false;
+      }
+      auto *stepper = static_cast<devices::Stepper *>(device);
+      devices::StepperConfig config = stepper->getConfig();
+      if (config.stepperType != "DRIVER")
+      {
+        printf("TrackSim: %s simulated as DRIVER stepper (was '%s')\n", stepper->getId().c_str(), config.stepperType.c_str());
+        config.stepperType = "DRIVER";
+      }
+      assignSimPin(config.stepPin);
+      assignSimPin(config.dirPin);
+      stepper->setConfig(config);
+
+      model.stepKey = config.stepPin.toString();
+      model.dirKey = config.dirPin.toString();
+      model.enableKey = config.enablePin.pin >= 0 ? config.enablePin.toString() : "";
+      model.invertDirection = config.invertDirection;
+      model.invertEnable = config.invertEnable;
+      return true;
+    };
+
+    auto wireSensor = [&](Device *device, SimSensor &sensor) -> bool
+    {
+      if (!device || device->getType() != "button")
+      {
+        return false;
+      }
+      auto *button = static_cast<devices::Button *>(device);
+      devices::ButtonConfig config = button->getConfig();
+      assignSimPin(config.pinConfig);
+      button->setConfig(config);
+
+      sensor.key = config.pinConfig.toString();
+      sensor.pullUp = config.pinMode == devices::PinModeOption::PullUp;
+      return true;
+    };
+
+    int servoPinIndex = 0;
+    auto wireServo = [&](Device *device) -> devices::Servo *
+    {
+      if (!device || device->getType() != "servo")
+      {
+        return nullptr;
+      }
+      auto *servo = static_cast<devices::Servo *>(device);
+      devices::ServoConfig config = servo->getConfig();
+      if (config.pin < 0)
+      {
+        config.pin = SIM_SERVO_PINS[servoPinIndex++];
+        servo->setConfig(config);
+      }
+      return servo;
+    };
+
+    // Lift
+    if (!wireStepper(findChild(_lift, "-stepper"), _liftStepper) ||
+        !wireSensor(findChild(_lift, "-limit"), _liftLimit) ||
+        !wireSensor(findChild(_lift, "-ball-sensor"), _ballSensor))
+    {
+      fprintf(stderr, "TrackSim: lift '%s' is missing its stepper or sensors\n", _lift->getId().c_str());
+      return false;
+    }
+    _loader = wireServo(findChild(_lift, "-loader"));
+    _unloader = wireServo(findChild(_lift, "-unloader"));
+
+    _liftMaxSteps = _lift->getConfig().maxSteps;
+    _liftStepper.minPosition = -_config.liftFloorSteps;
+    _liftStepper.maxPosition = _liftMaxSteps + _config.liftTopMarginSteps;
+    _liftStepper.position = _config.liftStartPosition;
+
+    // Wheel (optional: without one, marbles go straight from the track to the spiral)
+    if (_wheel)
+    {
+      if (!wireStepper(findChild(_wheel, "-stepper"), _wheelStepper) ||
+          !wireSensor(findChild(_wheel, "-zero-sensor"), _wheelZero))
+      {
+        fprintf(stderr, "TrackSim: wheel '%s' is missing its stepper or zero sensor\n", _wheel->getId().c_str());
+        return false;
+      }
+
+      const devices::WheelConfig &wheelConfig = _wheel->getConfig();
+      _wheelStepsPerRevolution = _config.wheelStepsPerRevolution > 0 ? _config.wheelStepsPerRevolution
+                                 : wheelConfig.stepsPerRevolution > 0  ? wheelConfig.stepsPerRevolution
+                                                                       : wheelConfig.maxStepsPerRevolution;
+      _wheelStepper.position = wheelStepsOf(_config.wheelStartDegrees);
+    }
+
+    return true;
+  }
+
+  void TrackSim::update(unsigned long nowMs)
+  {
+    const bool loaderOpen = _loader && _loader->getState().value >= 50.0f;
+    const bool unloaderOpen = _unloader && _unloader->getState().value >= 50.0f;
+    const bool liftError = _lift && _lift->getState().state == devices::LiftStateEnum::ERROR;
+    const bool wheelError = _wheel && _wheel->getState().state == devices::WheelStateEnum::ERROR;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Loader opening lets one waiting marble roll into an empty carriage at the bottom
+    if (loaderOpen && !_loaderWasOpen && _waitingAtLift > 0 && !_carriageLoaded)
+    {
+      if (isLiftAtBottom())
+      {
+        _waitingAtLift--;
+        _carriageLoaded = true;
+      }
+      else
+      {
+        _stats.loadMisses++;
+      }
+    }
+    _loaderWasOpen = loaderOpen;
+
+    // Unloader opening at the top pushes the marble onto the track
+    if (unloaderOpen && !_unloaderWasOpen && _carriageLoaded)
+    {
+      if (isLiftAtTop())
+      {
+        _carriageLoaded = false;
+        _stats.liftDeliveries++;
+        _onTrack.push_back(nowMs + _config.trackTravelMs);
+
+        if (_lastDeliveryMs > 0 && nowMs - _lastDeliveryMs > _stats.longestDeliveryGapMs)
+        {
+          _stats.longestDeliveryGapMs = nowMs - _lastDeliveryMs;
+        }
+        _lastDeliveryMs = nowMs;
+      }
+      else
+      {
+        _stats.unloadMisses++;
+      }
+    }
+    _unloaderWasOpen = unloaderOpen;
+
+    while (!_onTrack.empty() && _onTrack.front() <= nowMs)
+    {
+      _onTrack.pop_front();
+      if (_wheel)
+      {
+        _inWheel++;
+      }
+      else
+      {
+        _onSpiral.push_back(nowMs + _config.spiralTravelMs);
+      }
+    }
+
+    // Each pass of the release angle drops one marble from the wheel
+    for (; _pendingReleases > 0; _pendingReleases--)
+    {
+      if (_inWheel > 0)
+      {
+        _inWheel--;
+        _onSpiral.push_back(nowMs + _config.spiralTravelMs);
+      }
+    }
+
+    while (!_onSpiral.empty() && _onSpiral.front() <= nowMs)
+    {
+      _onSpiral.pop_front();
+      _waitingAtLift++;
+      _stats.loopsCompleted++;
+    }
+
+    if (liftError && !_liftWasError)
+    {
+      _stats.liftErrors++;
+    }
+    _liftWasError = liftError;
+    if (wheelError && !_wheelWasError)
+    {
+      _stats.wheelErrors++;
+    }
+    _wheelWasError = wheelError;
+  }
+
+  void TrackSim::writePin(const String &key, int level)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (SimStepper *stepper : {&_liftStepper, &_wheelStepper})
+    {
+      if (stepper->stepKey.isEmpty())
+      {
+        continue;
+      }
+      if (key == stepper->stepKey)
+      {
+        if (level == HIGH && stepper->stepLevel == LOW)
+        {
+          step(*stepper, stepper == &_liftStepper);
+        }
+        stepper->stepLevel = level;
+        return;
+      }
+      if (key == stepper->dirKey)
+      {
+        stepper->dirLevel = level;
+        return;
+      }
+      if (key == stepper->enableKey)
+      {
+        stepper->enableLevel = level;
+        return;
+      }
+    }
+  }
+
+  bool TrackSim::readPin(const String &key, int &level)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (key == _liftLimit.key)
+    {
+      level = levelFor(_liftLimit, _liftStepper.position <= 0);
+      return true;
+    }
+    if (key == _ballSensor.key)
+    {
+      level = levelFor(_ballSensor, _waitingAtLift > 0);
+      return true;
+    }
+    if (_wheel && key == _wheelZero.key)
+    {
+      level = levelFor(_wheelZero, wheelAngleSteps() < wheelStepsOf(_config.wheelZeroWindowDegrees));
+      return true;
+    }
+    return false;
+  }
+
+  void TrackSim::step(SimStepper &stepper, bool isLift)
+  {
+    // Enable is active HIGH unless inverted (see Stepper::enableStepper)
+    if (!stepper.enableKey.isEmpty() && (stepper.enableLevel == HIGH) == stepper.invertEnable)
+    {
+      return;
+    }
+
+    // The firmware inverts the dir pin for invertDirection, so undo that to get the logical direction
+    const bool isForward = (stepper.dirLevel == HIGH) != stepper.invertDirection;
+    const long next = stepper.position + (isForward ? 1 : -1);
+    if (next < stepper.minPosition || next > stepper.maxPosition)
+    {
+      if (isLift)
+      {
+        if (!stepper.stalled)
+        {
+          _stats.liftStalls++;
+        }
+        _stats.liftStalledSteps++;
+      }
+      stepper.stalled = true;
+      return;
+    }
+    stepper.stalled = false;
+    stepper.position = next;
+
+    if (!isLift && _wheelStepsPerRevolution > 0 && isForward)
+    {
+      const long angleSteps = wheelAngleSteps();
+      if (angleSteps == wheelStepsOf(_config.wheelReleaseDegrees))
+      {
+        _pendingReleases++;
+      }
+      if (angleSteps == 0)
+      {
+        _stats.wheelRevolutions++;
+      }
+    }
+  }
+
+  bool TrackSim::isLiftAtBottom() const
+  {
+    return _liftStepper.position <= _config.liftToleranceSteps;
+  }
+
+  bool TrackSim::isLiftAtTop() const
+  {
+    return _liftStepper.position >= _liftMaxSteps - _config.liftToleranceSteps;
+  }
+
+  long TrackSim::wheelStepsOf(float degrees) const
+  {
+    return static_cast<long>(degrees / 360.0f * _wheelStepsPerRevolution);
+  }
+
+  long TrackSim::wheelAngleSteps() const
+  {
+    return _wheelStepsPerRevolution > 0 ? positiveModulo(_wheelStepper.position, _wheelStepsPerRevolution) : 0;
+  }
+
+  int TrackSim::levelFor(const SimSensor &sensor, bool closed)
+  {
+    // Same mapping as Button::readIsButtonPressed(): pull-up inputs read LOW when the contact is closed
+    return sensor.pullUp ? (closed ? LOW : HIGH) : (closed ? HIGH : LOW);
+  }
+
+  TrackSimStats TrackSim::getStats()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+  }
+
+  String TrackSim::describeState()
+  {
+    String liftState = "-";
+    String wheelState = "-";
+    {
+      JsonDocument doc;
+      _lift->addStateToJson(doc);
+      liftState = doc["state"].as<String>();
+    }
+    if (_wheel)
+    {
+      JsonDocument doc;
+      _wheel->addStateToJson(doc);
+      wheelState = doc["state"].as<String>();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    const float wheelDegrees = _wheelStepsPerRevolution > 0 ? wheelAngleSteps() * 360.0f / _wheelStepsPerRevolution : 0.0f;
+    char buffer[200];
+    snprintf(buffer, sizeof(buffer), "lift %s @%ld%s | wheel %s @%.1f° | waiting %d, track %u, wheel %d, spiral %u",
+             liftState.c_str(), _liftStepper.position, _carriageLoaded ? " (loaded)" : "",
+             wheelState.c_str(), wheelDegrees,
+             _waitingAtLift, static_cast<unsigned>(_onTrack.size()), _inWheel, static_cast<unsigned>(_onSpiral.size()));
+    return String(buffer);
+  }
+
+  bool SimPin::setup(int pinNumber, pins::PinMode mode)
+  {
+    _pinNumber = pinNumber;
+    _mode = mode;
+    _isSetup = true;
+    return true;
+  }
+
+  int SimPin::read()
+  {
+    int level;
+    if (_sim.readPin(_key, level))
+    {
+      return level;
+    }
+    if (_mode == pins::PinMode::Output)
+    {
+      return _level;
+    }
+    // Nothing connected: inputs rest at their pull level
+    return _mode == pins::PinMode::InputPullUp ? HIGH : LOW;
+  }
+
+  bool SimPin::write(uint8_t value)
+  {
+    _level = value ? HIGH : LOW;
+    _sim.writePin(_key, _level);
+    return true;
+  }
+
+} // namespace sim
@@ -0,0 +1,193 @@
+/**
+ * @file TrackSim.h
+ * @brief Physics-lite model of the marble track for the native simulator
+ *
+ * TrackSim stands in for the hardware behind the firmware's pins: it counts
+ * step pulses on the lift and wheel stepper pins, drives the lift limit
+ * switch, the lift ball sensor and the wheel zero sensor from the modelled
+ * positions, watches the loader/unloader servos and moves marbles between
+ * the stations:
+ *
+ *   lift entrance --load--> lift carriage --unload at top--> track
+ *   track --trackTravelMs--> wheel --release angle--> spiral
+ *   spiral --spiralTravelMs--> lift entrance
+ *
+ * Pins are handed to the firmware through PinFactory::setPinCreator(), so
+ * the devices run unmodified. Servos are driven through MCPWM rather than a
+ * pins::IPin; their position is read from the Servo device state.
+ */
+
+#ifndef TRACK_SIM_H
+#define TRACK_SIM_H
+
+#include <Arduino.h>
+#include <climits>
+#include <deque>
+#include <mutex>
+
+#include "DeviceManager.h"
+#include "pins/Pins.h"
+#include "devices/Button.h"
+#include "devices/Lift.h"
+#include "devices/Servo.h"
+#include "devices/Stepper.h"
+#include "devices/Wheel.h"
+
+namespace sim
+{
+  struct TrackSimConfig
+  {
+    int marbles = 5;                      // Marbles on the track, all waiting at the lift at start
+    long liftStartPosition = 500;         // Carriage position at boot, in steps above the limit switch
+    long liftFloorSteps = 20;             // Mechanical floor below the limit switch trigger point
+    long liftTopMarginSteps = 50;         // Mechanical top above the lift's maxSteps
+    long liftToleranceSteps = 30;         // Max distance from bottom/top at which loading/unloading works
+    long wheelStepsPerRevolution = 0;     // 0 = the wheel's configured stepsPerRevolution
+    float wheelStartDegrees = 90.0f;      // Wheel angle at boot
+    float wheelZeroWindowDegrees = 2.0f;  // Arc over which the zero sensor is pressed
+    float wheelReleaseDegrees = 180.0f;   // Angle at which the wheel drops a marble into the spiral
+    uint32_t trackTravelMs = 8000;        // Lift top to wheel
+    uint32_t spiralTravelMs = 12000;      // Wheel to lift entrance
+  };
+
+  struct TrackSimStats
+  {
+    uint32_t liftDeliveries = 0;   // Marbles unloaded at the top
+    uint32_t loopsCompleted = 0;   // Marbles back at the lift entrance
+    uint32_t loadMisses = 0;       // Loader opened with the carriage away from the bottom
+    uint32_t unloadMisses = 0;     // Unloader opened with a loaded carriage away from the top
+    uint32_t liftStalls = 0;       // Times the lift stepper ran into a mechanical end
+    uint32_t liftStalledSteps = 0; // Step pulses lost against a mechanical end
+    uint32_t liftErrors = 0;       // Lift entered its ERROR state
+    uint32_t wheelErrors = 0;      // Wheel entered its ERROR state
+    uint32_t wheelRevolutions = 0; // Forward revolutions of the wheel
+    unsigned long longestDeliveryGapMs = 0; // Longest time between two lift deliveries
+  };
+
+  /**
+   * @brief Stepper driven through step/dir/enable pins
+   */
+  struct SimStepper
+  {
+    String stepKey;
+    String dirKey;
+    String enableKey;
+    bool invertDirection = false;
+    bool invertEnable = false;
+    int stepLevel = LOW;
+    int dirLevel = LOW;
+    int enableLevel = LOW;
+    long position = 0;
+    long minPosition = LONG_MIN;
+    long maxPosition = LONG_MAX;
+    bool stalled = false;
+  };
+
+  struct SimSensor
+  {
+    String key;
+    bool pullUp = true;
+  };
+
+  class TrackSim
+  {
+  public:
+    explicit TrackSim(const TrackSimConfig &config);
+
+    /**
+     * @brief Install the simulated pins; call before the devices are set up
+     */
+    void installPins();
+
+    /**
+     * @brief Find the lift and wheel and give unconfigured pins a simulated one
+     *
+     * Call after loading the device config and before DeviceManager::setup().
+     * @return false if the config has no lift
+     */
+    bool attach(DeviceManager &deviceManager);
+
+    /**
+     * @brief Advance marbles and servo interactions; call from the main loop
+     */
+    void update(unsigned long nowMs);
+
+    // Called by SimPin from device tasks and the main loop
+    void writePin(const String &key, int level);
+    bool readPin(const String &key, int &level);
+
+    TrackSimStats getStats();
+
+    /**
+     * @brief One-line summary of lift, wheel and marble positions
+     */
+    String describeState();
+
+  private:
+    void step(SimStepper &stepper, bool isLift);
+    bool isLiftAtBottom() const;
+    bool isLiftAtTop() const;
+    long wheelStepsOf(float degrees) const;
+    long wheelAngleSteps() const;
+    static int levelFor(const SimSensor &sensor, bool closed);
+
+    TrackSimConfig _config;
+    TrackSimStats _stats;
+    std::mutex _mutex;
+
+    devices::Lift *_lift = nullptr;
+    devices::Servo *_loader = nullptr;
+    devices::Servo *_unloader = nullptr;
+    devices::Wheel *_wheel = nullptr;
+
+    SimStepper _liftStepper;
+    SimStepper _wheelStepper;
+    SimSensor _liftLimit;
+    SimSensor _ballSensor;
+    SimSensor _wheelZero;
+    long _liftMaxSteps = 0;
+    long _wheelStepsPerRevolution = 0;
+    int _nextSimPin = 0;
+
+    // Marbles
+    int _waitingAtLift = 0;
+    bool _carriageLoaded = false;
+    int _inWheel = 0;
+    uint32_t _pendingReleases = 0;
+    std::deque<unsigned long> _onTrack;  // Arrival times at the wheel
+    std::deque<unsigned long> _onSpiral; // Arrival times at the lift
+    bool _loaderWasOpen = false;
+    bool _unloaderWasOpen = false;
+    bool _liftWasError = false;
+    bool _wheelWasError = false;
+    unsigned long _lastDeliveryMs = 0;
+  };
+
+  /**
+   * @class SimPin
+   * @brief pins::IPin backed by TrackSim; unmodelled pins behave like idle GPIO
+   */
+  class SimPin : public pins::IPin
+  {
+  public:
+    SimPin(TrackSim &sim, const String &key) : _sim(sim), _key(key) {}
+
+    bool setup(int pinNumber, pins::PinMode mode) override;
+    int read() override;
+    bool write(uint8_t value) override;
+    int getPinNumber() const override { return _pinNumber; }
+    bool isConfigured() const override { return _isSetup; }
+    String toString() const override { return _key; }
+
+  private:
+    TrackSim &_sim;
+    String _key;
+    int _pinNumber = -1;
+    bool _isSetup = false;
+    pins::PinMode _mode = pins::PinMode::Input;
+    int _level = LOW;
+  };
+
+} // namespace sim
+
+#endif // TRACK_SIM_H
@@ -11,6 +11,13 @@ extern DeviceManager deviceManager;
 // Static cache for resolved expander addresses
 static std::map<String, uint8_t> expanderAddresses;
 
+PinFactory::PinCreator PinFactory::pinCreator = nullptr;
+
+void PinFactory::setPinCreator(PinCreator creator)
+{
+    pinCreator = creator;
+}
+
 // Setup method to resolve expander IDs to I2C addresses
 void PinFactory::setup()
 {
@@ -40,6 +47,11 @@ pins::IPin *PinFactory::createPin(int pinNumber)
 // Factory function to create IPin from PinConfig
 pins::IPin *PinFactory::createPin(const PinConfig &config)
 {
+    if (pinCreator)
+    {
+        return pinCreator(config);
+    }
+
     // If no expanderId, it's a GPIO pin
     if (config.expanderId.isEmpty())
     {
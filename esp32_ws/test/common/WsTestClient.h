@@ -0,0 +1,232 @@
+/**
+ * @file WsTestClient.h
+ * @brief Firmware setup and a synthetic WebSocket client for the native test suites
+ *
+ * Header only, included by the test_* suites: PlatformIO builds each suite
+ * on its own and only treats test_* directories as suites.
+ */
+
+#ifndef WS_TEST_CLIENT_H
+#define WS_TEST_CLIENT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <NativeHal.h>
+#include <unity.h>
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "native/HostHarness.h"
+
+namespace wstest
+{
+  /**
+   * @brief Load esp32_ws/config.json into a fresh simulated LittleFS and start the devices, like main.cpp's setup()
+   */
+  inline void setupFirmware()
+  {
+    nativehal::setFsRoot(".pio/test_fs");
+    TEST_ASSERT_TRUE(hostharness::installConfig("esp32_ws/config.json"));
+    hostharness::setupWebSocket();
+    deviceManager.loadDevicesFromJsonFile();
+    deviceManager.setup();
+  }
+
+  /**
+   * @brief One iteration of main.cpp's loop(); inbound commands run after it returns
+   */
+  inline void loopOnce()
+  {
+    {
+      WebSocketManager::CommandPause commandPause(wsManager);
+      wsManager.beginBatch();
+      wsManager.loop();
+      deviceManager.loop();
+      wsManager.endBatch();
+    }
+    delay(1);
+  }
+
+  /**
+   * @brief Run loopOnce() until done() holds
+   * @return false if it did not within timeoutMs
+   */
+  inline bool loopUntil(const std::function<bool()> &done, uint32_t timeoutMs = 2000)
+  {
+    const unsigned long startMs = millis();
+    while (!done())
+    {
+      if (millis() - startMs >= timeoutMs)
+      {
+        return false;
+      }
+      loopOnce();
+    }
+    return true;
+  }
+
+  /**
+   * @brief A connected client that records every frame it is sent
+   *
+   * Frames arrive on the main loop and on the command task, so they are
+   * kept under a mutex.
+   */
+  class Client
+  {
+  public:
+    /**
+     * @brief Connect, send firstMessage (a resume, like the website) and wait until the snapshot or missed broadcasts are sent
+     */
+    void connect(const String &firstMessage = "{\"type\":\"resume\"}")
+    {
+      clear();
+      AsyncWebSocket *ws = server.webSocket("/ws");
+      AsyncWebSocketClient *client = ws->connect([this](AsyncWebSocketClient *, const String &data, bool)
+                                                 { record(data); });
+      _id = client->id();
+      ws->receive(_id, firstMessage);
+      TEST_ASSERT_TRUE_MESSAGE(loopUntil([]()
+                                         { return !wsManager.hasAwaitingClients(); }),
+                               "no snapshot within 2 s");
+    }
+
+    // A failed assertion leaves the test early; the sink must not outlive the client
+    ~Client()
+    {
+      disconnect();
+    }
+
+    void disconnect()
+    {
+      AsyncWebSocket *ws = server.webSocket("/ws");
+      if (ws->client(_id))
+      {
+        ws->disconnect(_id);
+      }
+    }
+
+    /**
+     * @brief Deliver a message from this client, split into frames of fragmentSize bytes (0 = single frame)
+     */
+    void send(const String &message, size_t fragmentSize = 0)
+    {
+      server.webSocket("/ws")->receive(_id, message, fragmentSize);
+    }
+
+    /**
+     * @brief Stop taking frames: the socket queue holds queueLimit frames and refuses the rest
+     */
+    void stall(size_t queueLimit)
+    {
+      AsyncWebSocketClient *client = socket();
+      client->setSink(nullptr);
+      client->setQueueLimit(queueLimit);
+    }
+
+    /**
+     * @brief Take the frames the stalled socket holds, and every frame after them as they are sent
+     */
+    void unstall()
+    {
+      AsyncWebSocketClient *client = socket();
+      for (const AsyncWebSocketClient::Message &message : client->drain())
+      {
+        record(message.data);
+      }
+      client->setQueueLimit(WS_MAX_QUEUED_MESSAGES);
+      client->setSink([this](AsyncWebSocketClient *, const String &data, bool)
+                      { record(data); });
+    }
+
+    uint32_t id() const { return _id; }
+
+    void clear()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _frames.clear();
+    }
+
+    std::vector<String> frames()
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _frames;
+    }
+
+    /**
+     * @brief Every message received so far, in order; frames that are arrays are flattened
+     */
+    JsonDocument messages()
+    {
+      JsonDocument all;
+      JsonArray out = all.to<JsonArray>();
+      for (const String &frame : frames())
+      {
+        JsonDocument doc;
+        TEST_ASSERT_FALSE_MESSAGE(deserializeJson(doc, frame), frame.c_str());
+        if (doc.is<JsonArray>())
+        {
+          for (JsonVariant message : doc.as<JsonArray>())
+          {
+            out.add(message);
+          }
+        }
+        else
+        {
+          out.add(doc);
+        }
+      }
+      return all;
+    }
+
+    /**
+     * @brief The messages of the given type, and of deviceId if not null
+     */
+    JsonDocument messagesOf(const char *type, const char *deviceId = nullptr)
+    {
+      JsonDocument matching;
+      JsonArray out = matching.to<JsonArray>();
+      JsonDocument all = messages();
+      for (JsonObject message : all.as<JsonArray>())
+      {
+        if (message["type"] == type && (!deviceId || message["deviceId"] == deviceId))
+        {
+          out.add(message);
+        }
+      }
+      return matching;
+    }
+
+    /**
+     * @brief Run the loop until a message of the given type arrived
+     */
+    bool waitFor(const char *type, uint32_t timeoutMs = 2000)
+    {
+      return loopUntil([this, type]()
+                       { return messagesOf(type).size() > 0; },
+                       timeoutMs);
+    }
+
+  private:
+    AsyncWebSocketClient *socket()
+    {
+      AsyncWebSocketClient *client = server.webSocket("/ws")->client(_id);
+      TEST_ASSERT_NOT_NULL(client);
+      return client;
+    }
+
+    void record(const String &data)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _frames.push_back(data);
+    }
+
+    uint32_t _id = 0;
+    std::mutex _mutex;
+    std::vector<String> _frames;
+  };
+}
+
+#endif // WS_TEST_CLIENT_H
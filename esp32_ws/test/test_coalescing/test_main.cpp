@@ -0,0 +1,161 @@
+/**
+ * @file test_main.cpp
+ * @brief Per-device coalescing of state changes within a batch (native build): pio test -e native_test
+ *
+ * Moves the lift servos of esp32_ws/config.json between beginBatch() and
+ * endBatch(), like the lift does during deviceManager.loop(); no loop runs
+ * during the tests, so the lift leaves them alone.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "devices/mixins/IControllable.h"
+#include "../common/WsTestClient.h"
+
+namespace
+{
+  constexpr const char *SERVO_ID = "lift-loader";
+  constexpr const char *OTHER_SERVO_ID = "lift-unloader";
+
+  wstest::Client client;
+
+  IControllable *controllable(const char *deviceId)
+  {
+    IControllable *device = mixins::ControllableRegistry::get(deviceId);
+    TEST_ASSERT_NOT_NULL(device);
+    return device;
+  }
+
+  /**
+   * @brief Move a servo at once; value is 0..1, the state reports percent
+   */
+  void setServo(const char *deviceId, float value)
+  {
+    JsonDocument args;
+    args["value"] = value;
+    args["durationMs"] = 0;
+    JsonObject argsObj = args.as<JsonObject>();
+    TEST_ASSERT_TRUE(controllable(deviceId)->control("setValue", &argsObj));
+  }
+
+  float servoValue(const char *deviceId)
+  {
+    JsonDocument state;
+    controllable(deviceId)->addStateToJson(state);
+    return state["value"].as<float>();
+  }
+
+  /**
+   * @brief Open a batch like the main loop does; commands are held back until it is sent
+   */
+  class Batch
+  {
+  public:
+    Batch() : _commandPause(wsManager) { wsManager.beginBatch(); }
+    ~Batch() { wsManager.endBatch(); }
+
+  private:
+    WebSocketManager::CommandPause _commandPause;
+  };
+}
+
+void setUp()
+{
+  setServo(SERVO_ID, 0.0f);
+  client.clear();
+}
+
+void tearDown()
+{
+}
+
+void test_changes_in_a_batch_are_sent_once_per_device()
+{
+  const uint32_t version = controllable(SERVO_ID)->getStateVersion();
+  const float otherValue = servoValue(OTHER_SERVO_ID);
+  {
+    Batch batch;
+    setServo(SERVO_ID, 0.25f);
+    setServo(OTHER_SERVO_ID, otherValue > 50 ? 0.0f : 1.0f);
+    setServo(SERVO_ID, 0.75f);
+  }
+
+  // One frame, one message per device in order of their first change, with the final state
+  TEST_ASSERT_EQUAL_UINT32(1, client.frames().size());
+  JsonDocument states = client.messagesOf("device-state");
+  TEST_ASSERT_EQUAL_UINT32(2, states.size());
+  TEST_ASSERT_EQUAL_STRING(SERVO_ID, states[0]["deviceId"].as<const char *>());
+  TEST_ASSERT_EQUAL_FLOAT(75.0f, states[0]["state"]["value"].as<float>());
+  TEST_ASSERT_EQUAL_UINT32(version + 1, states[0]["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_STRING(OTHER_SERVO_ID, states[1]["deviceId"].as<const char *>());
+  TEST_ASSERT_EQUAL_UINT32(version + 1, controllable(SERVO_ID)->getStateVersion());
+}
+
+void test_change_undone_in_the_same_batch_is_not_sent()
+{
+  const uint32_t version = controllable(SERVO_ID)->getStateVersion();
+  {
+    Batch batch;
+    setServo(SERVO_ID, 1.0f);
+    setServo(SERVO_ID, 0.0f);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(0, client.messagesOf("device-state", SERVO_ID).size());
+  TEST_ASSERT_EQUAL_UINT32(version, controllable(SERVO_ID)->getStateVersion());
+}
+
+void test_batch_messages_and_state_share_one_frame()
+{
+  {
+    Batch batch;
+    setServo(SERVO_ID, 1.0f);
+    JsonDocument doc;
+    doc["type"] = "test-broadcast";
+    wsManager.notifyClients(doc);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(1, client.frames().size());
+  JsonDocument messages = client.messages();
+  TEST_ASSERT_EQUAL_UINT32(2, messages.size());
+  // Queued messages go first; device state is serialized when the batch ends
+  TEST_ASSERT_EQUAL_STRING("test-broadcast", messages[0]["type"].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING("device-state", messages[1]["type"].as<const char *>());
+  TEST_ASSERT_EQUAL_UINT32(messages[0]["seq"].as<uint32_t>() + 1, messages[1]["seq"].as<uint32_t>());
+}
+
+void test_changes_outside_a_batch_are_sent_at_once()
+{
+  const uint32_t version = controllable(SERVO_ID)->getStateVersion();
+  {
+    WebSocketManager::CommandPause commandPause(wsManager);
+    setServo(SERVO_ID, 1.0f);
+    setServo(SERVO_ID, 0.5f);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(2, client.frames().size());
+  JsonDocument states = client.messagesOf("device-state", SERVO_ID);
+  TEST_ASSERT_EQUAL_UINT32(2, states.size());
+  TEST_ASSERT_EQUAL_FLOAT(100.0f, states[0]["state"]["value"].as<float>());
+  TEST_ASSERT_EQUAL_UINT32(version + 1, states[0]["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_FLOAT(50.0f, states[1]["state"]["value"].as<float>());
+  TEST_ASSERT_EQUAL_UINT32(version + 2, states[1]["version"].as<uint32_t>());
+}
+
+int main(int argc, char **argv)
+{
+  wstest::setupFirmware();
+  client.connect();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_changes_in_a_batch_are_sent_once_per_device);
+  RUN_TEST(test_change_undone_in_the_same_batch_is_not_sent);
+  RUN_TEST(test_batch_messages_and_state_share_one_frame);
+  RUN_TEST(test_changes_outside_a_batch_are_sent_at_once);
+  const int failures = UNITY_END();
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(failures);
+}
@@ -0,0 +1,271 @@
+/**
+ * @file test_main.cpp
+ * @brief Broadcast history and resume tests (native build): pio test -e native_test
+ *
+ * WsHistory on its own for the ring buffer, and through WebSocketManager
+ * for clients that reconnect with the last seq they got.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "WsHistory.h"
+#include "../common/WsTestClient.h"
+
+namespace
+{
+  /**
+   * @brief A numbered message of exactly length bytes: {"seq":N,"pad":"xxx"}
+   */
+  String makeMessage(uint32_t seq, size_t length)
+  {
+    char prefix[WsHistory::kSeqPrefixSize];
+    String message = String(prefix, WsHistory::formatSeqPrefix(prefix, seq)) + ",\"pad\":\"";
+    while (message.length() + 2 < length)
+    {
+      message += 'x';
+    }
+    message += "\"}";
+    return message;
+  }
+
+  void append(WsHistory &history, uint32_t seq, const String &message)
+  {
+    history.append(seq, message.c_str(), message.length());
+  }
+
+  String writeSince(const WsHistory &history, uint32_t seq)
+  {
+    std::vector<uint8_t> out;
+    TEST_ASSERT_TRUE(history.writeSince(seq, out));
+    return String(reinterpret_cast<const char *>(out.data()), out.size());
+  }
+
+  /**
+   * @brief The seq and epoch of the client's last sync message
+   */
+  void lastSync(wstest::Client &client, uint32_t &epoch, uint32_t &seq, bool &resumed)
+  {
+    JsonDocument syncs = client.messagesOf("sync");
+    TEST_ASSERT_GREATER_THAN(0, syncs.size());
+    JsonObject sync = syncs[syncs.size() - 1];
+    epoch = sync["epoch"];
+    seq = sync["seq"];
+    resumed = sync["resumed"];
+  }
+
+  void broadcast(const char *value)
+  {
+    JsonDocument doc;
+    doc["type"] = "test-broadcast";
+    doc["value"] = value;
+    wsManager.notifyClients(doc);
+  }
+
+  String resumeMessage(uint32_t epoch, uint32_t lastSeq)
+  {
+    return String("{\"type\":\"resume\",\"epoch\":") + epoch + ",\"lastSeq\":" + lastSeq + "}";
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_seq_prefix_fits_every_seq()
+{
+  const uint32_t seqs[] = {1, 99999999, 100000000, 4294967295u};
+  for (uint32_t seq : seqs)
+  {
+    char prefix[WsHistory::kSeqPrefixSize];
+    const size_t length = WsHistory::formatSeqPrefix(prefix, seq);
+    const std::string expected = "{\"seq\":" + std::to_string(seq);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), prefix);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), length);
+  }
+}
+
+void test_messages_wrap_around_the_buffer_end()
+{
+  // 3 messages of 30 bytes fit; every fourth one starts 10 bytes before the end and wraps
+  WsHistory history(100);
+  TEST_ASSERT_TRUE(history.begin());
+  for (uint32_t seq = 1; seq <= 10; seq++)
+  {
+    append(history, history.takeSeq(), makeMessage(seq, 30));
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(3, history.getMessageCount());
+  TEST_ASSERT_EQUAL_UINT32(8, history.getOldestSeq());
+  TEST_ASSERT_EQUAL_UINT32(90, history.getUsedBytes());
+  const String expected = "[" + makeMessage(8, 30) + "," + makeMessage(9, 30) + "," + makeMessage(10, 30) + "]";
+  TEST_ASSERT_EQUAL_STRING(expected.c_str(), writeSince(history, 7).c_str());
+}
+
+void test_resume_only_within_the_window()
+{
+  WsHistory history(100);
+  TEST_ASSERT_TRUE(history.begin());
+  for (uint32_t seq = 1; seq <= 10; seq++)
+  {
+    append(history, history.takeSeq(), makeMessage(seq, 30));
+  }
+
+  // Oldest held is 8: a client that got 7 misses nothing that is gone, one that got 6 missed 7
+  TEST_ASSERT_TRUE(history.canResume(7));
+  TEST_ASSERT_FALSE(history.canResume(6));
+  TEST_ASSERT_FALSE(history.canResume(0));
+
+  // Up to date, and ahead of the board (a seq from before a restart)
+  TEST_ASSERT_TRUE(history.canResume(10));
+  TEST_ASSERT_EQUAL_STRING("[]", writeSince(history, 10).c_str());
+  TEST_ASSERT_FALSE(history.canResume(11));
+
+  // The frame limit counts the brackets and commas too
+  TEST_ASSERT_TRUE(history.canResume(8, 63));
+  TEST_ASSERT_FALSE(history.canResume(8, 62));
+}
+
+void test_skipped_seq_blocks_resume_across_it()
+{
+  WsHistory history(1024);
+  TEST_ASSERT_TRUE(history.begin());
+  append(history, history.takeSeq(), makeMessage(1, 30));
+  append(history, history.takeSeq(), makeMessage(2, 30));
+  history.skip(); // 3: nobody was connected
+  append(history, history.takeSeq(), makeMessage(4, 30));
+
+  TEST_ASSERT_EQUAL_UINT32(4, history.getLastSeq());
+  TEST_ASSERT_FALSE(history.canResume(1));
+  TEST_ASSERT_FALSE(history.canResume(2));
+  TEST_ASSERT_TRUE(history.canResume(3));
+  TEST_ASSERT_TRUE(history.canResume(4));
+  TEST_ASSERT_EQUAL_STRING(("[" + makeMessage(4, 30) + "]").c_str(), writeSince(history, 3).c_str());
+}
+
+void test_message_larger_than_the_buffer_clears_it()
+{
+  WsHistory history(100);
+  TEST_ASSERT_TRUE(history.begin());
+  append(history, history.takeSeq(), makeMessage(1, 30));
+  append(history, history.takeSeq(), makeMessage(2, 120));
+
+  TEST_ASSERT_EQUAL_UINT32(0, history.getMessageCount());
+  TEST_ASSERT_FALSE(history.canResume(1));
+}
+
+void test_seqs_above_ten_to_the_eighth()
+{
+  WsHistory history(1024);
+  TEST_ASSERT_TRUE(history.begin());
+  for (uint32_t i = 0; i < 100000000; i++)
+  {
+    history.skip();
+  }
+  const uint32_t first = history.takeSeq();
+  append(history, first, makeMessage(first, 40));
+  const uint32_t second = history.takeSeq();
+  append(history, second, makeMessage(second, 40));
+
+  TEST_ASSERT_TRUE(history.canResume(first - 1));
+  TEST_ASSERT_FALSE(history.canResume(first - 2));
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, writeSince(history, first)));
+  TEST_ASSERT_EQUAL_UINT32(1, doc.size());
+  TEST_ASSERT_EQUAL_UINT32(second, doc[0]["seq"].as<uint32_t>());
+}
+
+void test_reconnect_is_sent_the_broadcasts_it_missed()
+{
+  wstest::Client stays;
+  stays.connect();
+  wstest::Client reconnects;
+  reconnects.connect();
+
+  uint32_t epoch = 0;
+  uint32_t lastSeq = 0;
+  bool resumed = true;
+  lastSync(reconnects, epoch, lastSeq, resumed);
+  TEST_ASSERT_FALSE(resumed);
+  reconnects.disconnect();
+
+  broadcast("first");
+  broadcast("second");
+
+  reconnects.connect(resumeMessage(epoch, lastSeq));
+  JsonDocument missed = reconnects.messagesOf("test-broadcast");
+  TEST_ASSERT_EQUAL_UINT32(2, missed.size());
+  TEST_ASSERT_EQUAL_STRING("first", missed[0]["value"].as<const char *>());
+  TEST_ASSERT_EQUAL_UINT32(lastSeq + 1, missed[0]["seq"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_STRING("second", missed[1]["value"].as<const char *>());
+  TEST_ASSERT_EQUAL_UINT32(0, reconnects.messagesOf("devices-list").size());
+
+  uint32_t syncSeq = 0;
+  lastSync(reconnects, epoch, syncSeq, resumed);
+  TEST_ASSERT_TRUE(resumed);
+  TEST_ASSERT_EQUAL_UINT32(lastSeq + 2, syncSeq);
+
+  // The client that stayed got them live, numbered the same
+  JsonDocument live = stays.messagesOf("test-broadcast");
+  TEST_ASSERT_EQUAL_UINT32(2, live.size());
+  TEST_ASSERT_EQUAL_UINT32(lastSeq + 2, live[1]["seq"].as<uint32_t>());
+
+  stays.disconnect();
+  reconnects.disconnect();
+}
+
+void test_reconnect_across_a_skipped_broadcast_gets_the_snapshot()
+{
+  wstest::Client client;
+  client.connect();
+  uint32_t epoch = 0;
+  uint32_t lastSeq = 0;
+  bool resumed = true;
+  lastSync(client, epoch, lastSeq, resumed);
+  client.disconnect();
+
+  broadcast("nobody"); // No client: the seq is taken but not held
+
+  client.connect(resumeMessage(epoch, lastSeq));
+  TEST_ASSERT_EQUAL_UINT32(0, client.messagesOf("test-broadcast").size());
+  TEST_ASSERT_EQUAL_UINT32(1, client.messagesOf("devices-list").size());
+  uint32_t syncSeq = 0;
+  lastSync(client, epoch, syncSeq, resumed);
+  TEST_ASSERT_FALSE(resumed);
+  TEST_ASSERT_EQUAL_UINT32(lastSeq + 1, syncSeq);
+
+  // A resume from another boot is not tried at all
+  client.disconnect();
+  client.connect(resumeMessage(epoch + 1, syncSeq));
+  lastSync(client, epoch, syncSeq, resumed);
+  TEST_ASSERT_FALSE(resumed);
+  client.disconnect();
+}
+
+int main(int argc, char **argv)
+{
+  wstest::setupFirmware();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_seq_prefix_fits_every_seq);
+  RUN_TEST(test_messages_wrap_around_the_buffer_end);
+  RUN_TEST(test_resume_only_within_the_window);
+  RUN_TEST(test_skipped_seq_blocks_resume_across_it);
+  RUN_TEST(test_message_larger_than_the_buffer_clears_it);
+  RUN_TEST(test_seqs_above_ten_to_the_eighth);
+  RUN_TEST(test_reconnect_is_sent_the_broadcasts_it_missed);
+  RUN_TEST(test_reconnect_across_a_skipped_broadcast_gets_the_snapshot);
+  const int failures = UNITY_END();
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(failures);
+}
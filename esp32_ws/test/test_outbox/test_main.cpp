@@ -0,0 +1,247 @@
+/**
+ * @file test_main.cpp
+ * @brief Per-client outbox tests (native build): pio test -e native_test
+ *
+ * The client stalls its socket so every frame goes to its outbox, then
+ * takes them again: responses and device state keep their order, telemetry
+ * keeps only the latest sample per device and is the first to go when the
+ * outbox is full.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "devices/mixins/IControllable.h"
+#include "../common/WsTestClient.h"
+
+namespace
+{
+  constexpr const char *SERVO_ID = "lift-loader";
+  constexpr const char *OTHER_SERVO_ID = "lift-unloader";
+
+  // WebSocketManager.cpp's kMaxOutboxFrames
+  constexpr uint32_t kMaxOutboxFrames = 32;
+
+  wstest::Client client;
+
+  IControllable *controllable(const char *deviceId)
+  {
+    IControllable *device = mixins::ControllableRegistry::get(deviceId);
+    TEST_ASSERT_NOT_NULL(device);
+    return device;
+  }
+
+  /**
+   * @brief Move a servo at once; value is 0..1
+   */
+  void setServo(const char *deviceId, float value)
+  {
+    JsonDocument args;
+    args["value"] = value;
+    args["durationMs"] = 0;
+    JsonObject argsObj = args.as<JsonObject>();
+    WebSocketManager::CommandPause commandPause(wsManager);
+    TEST_ASSERT_TRUE(controllable(deviceId)->control("setValue", &argsObj));
+  }
+
+  /**
+   * @brief Have a request of the client handled at once, like the command task does; the response is numbered n
+   */
+  void request(uint32_t n)
+  {
+    const String message = String("{\"type\":\"device-read-config\",\"deviceId\":\"") + SERVO_ID + "\",\"requestId\":\"" + n + "\"}";
+    WebSocketManager::CommandPause commandPause(wsManager);
+    wsManager.parseMessage(message.c_str(), message.length(), client.id());
+  }
+
+  uint32_t responseNumber(JsonVariant message)
+  {
+    TEST_ASSERT_EQUAL_STRING("device-config", message["type"].as<const char *>());
+    return String(message["requestId"].as<const char *>()).toInt();
+  }
+
+  /**
+   * @brief Start (or with 0, stop) the telemetry stream of a device and wait for the answer
+   */
+  void streamTelemetry(const char *deviceId, int rateHz)
+  {
+    const size_t answers = client.messagesOf("telemetry", deviceId).size();
+    client.send(String("{\"type\":\"telemetry\",\"deviceId\":\"") + deviceId + "\",\"rateHz\":" + rateHz + "}");
+    TEST_ASSERT_TRUE(wstest::loopUntil([deviceId, answers]()
+                                       { return client.messagesOf("telemetry", deviceId).size() > answers; }));
+  }
+
+  /**
+   * @brief Run one loop after the stream period, so every stream with a new value sends a sample
+   */
+  void sampleTelemetry()
+  {
+    delay(25);
+    wstest::loopOnce();
+  }
+
+  /**
+   * @brief Telemetry samples received, without the answers to the telemetry requests
+   */
+  JsonDocument samplesOf(const char *deviceId)
+  {
+    JsonDocument samples;
+    JsonArray out = samples.to<JsonArray>();
+    JsonDocument all = client.messagesOf("telemetry", deviceId);
+    for (JsonObject message : all.as<JsonArray>())
+    {
+      if (message["values"].is<JsonObject>())
+      {
+        out.add(message);
+      }
+    }
+    return samples;
+  }
+
+  /**
+   * @brief Take every queued frame again
+   */
+  void unstall()
+  {
+    client.unstall();
+    wstest::loopOnce();
+  }
+}
+
+void setUp()
+{
+  setServo(SERVO_ID, 0.0f);
+  setServo(OTHER_SERVO_ID, 0.0f);
+  client.clear();
+}
+
+void tearDown()
+{
+  // A failed assertion may leave the socket stalled
+  client.unstall();
+}
+
+void test_responses_and_state_wait_in_order()
+{
+  const WebSocketManager::DropStats before = wsManager.getDropStats();
+  client.stall(0);
+  setServo(SERVO_ID, 0.25f);
+  request(1);
+  setServo(SERVO_ID, 0.5f);
+  request(2);
+  TEST_ASSERT_EQUAL_UINT32(0, client.frames().size());
+
+  unstall();
+  JsonDocument messages = client.messages();
+  TEST_ASSERT_EQUAL_UINT32(4, messages.size());
+  TEST_ASSERT_EQUAL_STRING("device-state", messages[0]["type"].as<const char *>());
+  TEST_ASSERT_EQUAL_FLOAT(25.0f, messages[0]["state"]["value"].as<float>());
+  TEST_ASSERT_EQUAL_UINT32(1, responseNumber(messages[1]));
+  TEST_ASSERT_EQUAL_FLOAT(50.0f, messages[2]["state"]["value"].as<float>());
+  TEST_ASSERT_EQUAL_UINT32(2, responseNumber(messages[3]));
+
+  const WebSocketManager::ClientDropStats drops = wsManager.getClientDropStats(client.id());
+  TEST_ASSERT_EQUAL_UINT32(0, drops.responses + drops.states + drops.telemetry);
+  TEST_ASSERT_EQUAL_UINT32(before.sendBufferFull, wsManager.getDropStats().sendBufferFull);
+}
+
+void test_queued_telemetry_keeps_the_latest_sample_and_goes_last()
+{
+  streamTelemetry(SERVO_ID, 50);
+  const uint32_t superseded = wsManager.getClientDropStats(client.id()).telemetrySuperseded;
+  client.stall(0);
+  setServo(SERVO_ID, 0.1f);
+  sampleTelemetry();
+  setServo(SERVO_ID, 0.2f);
+  sampleTelemetry();
+  setServo(SERVO_ID, 0.3f);
+  sampleTelemetry();
+  request(1);
+
+  // Two samples replaced while queued; that is not a loss
+  const WebSocketManager::ClientDropStats drops = wsManager.getClientDropStats(client.id());
+  TEST_ASSERT_EQUAL_UINT32(superseded + 2, drops.telemetrySuperseded);
+  TEST_ASSERT_EQUAL_UINT32(0, drops.telemetry);
+
+  client.clear();
+  unstall();
+  JsonDocument latest;
+  controllable(SERVO_ID)->addTelemetryToJson(latest.to<JsonObject>());
+  JsonDocument messages = client.messages();
+  // Three states and the response, then the one sample left
+  TEST_ASSERT_GREATER_OR_EQUAL(5, messages.size());
+  for (size_t i = 0; i < 3; i++)
+  {
+    TEST_ASSERT_EQUAL_STRING("device-state", messages[i]["type"].as<const char *>());
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, responseNumber(messages[3]));
+  TEST_ASSERT_EQUAL_STRING("telemetry", messages[4]["type"].as<const char *>());
+  TEST_ASSERT_EQUAL_FLOAT(latest["value"].as<float>(), messages[4]["values"]["value"].as<float>());
+  TEST_ASSERT_EQUAL_UINT32(1, samplesOf(SERVO_ID).size());
+
+  streamTelemetry(SERVO_ID, 0);
+}
+
+void test_full_outbox_evicts_telemetry_first()
+{
+  streamTelemetry(SERVO_ID, 50);
+  streamTelemetry(OTHER_SERVO_ID, 50);
+  const WebSocketManager::ClientDropStats before = wsManager.getClientDropStats(client.id());
+  const uint32_t sendBufferFull = wsManager.getDropStats().sendBufferFull;
+  client.stall(0);
+
+  // One state frame per servo, then a sample of each
+  setServo(SERVO_ID, 0.4f);
+  setServo(OTHER_SERVO_ID, 0.4f);
+  sampleTelemetry();
+
+  // 28 responses fill the outbox; the next two push the samples out, the one after is dropped
+  for (uint32_t n = 0; n < kMaxOutboxFrames - 1; n++)
+  {
+    request(n);
+  }
+  WebSocketManager::ClientDropStats drops = wsManager.getClientDropStats(client.id());
+  TEST_ASSERT_EQUAL_UINT32(before.telemetry + 2, drops.telemetry);
+  TEST_ASSERT_EQUAL_UINT32(before.responses + 1, drops.responses);
+  TEST_ASSERT_EQUAL_UINT32(before.states, drops.states);
+
+  // Nothing left to evict: a new sample is dropped itself
+  setServo(SERVO_ID, 0.6f);
+  sampleTelemetry();
+  drops = wsManager.getClientDropStats(client.id());
+  TEST_ASSERT_EQUAL_UINT32(before.states + 1, drops.states);
+  TEST_ASSERT_EQUAL_UINT32(before.telemetry + 3, drops.telemetry);
+  TEST_ASSERT_EQUAL_UINT32(sendBufferFull + 5, wsManager.getDropStats().sendBufferFull);
+
+  // The states and the responses that fitted, in order
+  client.clear();
+  unstall();
+  JsonDocument queued = client.messages();
+  TEST_ASSERT_GREATER_OR_EQUAL(kMaxOutboxFrames, queued.size());
+  TEST_ASSERT_EQUAL_STRING(SERVO_ID, queued[0]["deviceId"].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING(OTHER_SERVO_ID, queued[1]["deviceId"].as<const char *>());
+  for (uint32_t n = 0; n < kMaxOutboxFrames - 2; n++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(n, responseNumber(queued[n + 2]));
+  }
+
+  streamTelemetry(SERVO_ID, 0);
+  streamTelemetry(OTHER_SERVO_ID, 0);
+}
+
+int main(int argc, char **argv)
+{
+  wstest::setupFirmware();
+  client.connect();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_responses_and_state_wait_in_order);
+  RUN_TEST(test_queued_telemetry_keeps_the_latest_sample_and_goes_last);
+  RUN_TEST(test_full_outbox_evicts_telemetry_first);
+  const int failures = UNITY_END();
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(failures);
+}
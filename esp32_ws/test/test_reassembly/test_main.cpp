@@ -0,0 +1,194 @@
+/**
+ * @file test_main.cpp
+ * @brief Inbound message reassembly tests (native build): pio test -e native_test
+ *
+ * Requests are sent whole and in fragments, up to and over the 32 KB
+ * message limit. Fragments the fake socket cannot produce (a message cut
+ * off, or one whose start was not seen) are handed to onEvent() directly.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "../common/WsTestClient.h"
+
+namespace
+{
+  constexpr const char *SERVO_ID = "lift-loader";
+
+  // WebSocketManager.cpp's kMaxMessageBytes
+  constexpr size_t kMaxMessageBytes = 32 * 1024;
+
+  wstest::Client client;
+
+  /**
+   * @brief A request answered to the client only, padded to exactly length bytes
+   */
+  String requestOf(const char *requestId, size_t length)
+  {
+    String message = String("{\"type\":\"device-read-config\",\"deviceId\":\"") + SERVO_ID + "\",\"requestId\":\"" + requestId + "\",\"pad\":\"";
+    String pad;
+    pad.reserve(length);
+    while (message.length() + pad.length() + 2 < length)
+    {
+      pad += 'x';
+    }
+    return message + pad + "\"}";
+  }
+
+  /**
+   * @brief The requestIds of the answered requests, in order
+   */
+  std::vector<String> answered()
+  {
+    std::vector<String> ids;
+    JsonDocument responses = client.messagesOf("device-config");
+    for (JsonObject response : responses.as<JsonArray>())
+    {
+      ids.push_back(response["requestId"].as<String>());
+    }
+    return ids;
+  }
+
+  /**
+   * @brief Send a small request and wait for its answer; commands run in order, so everything before it is done
+   */
+  void sync()
+  {
+    const size_t count = answered().size();
+    client.send(requestOf("sync", 0));
+    TEST_ASSERT_TRUE(wstest::loopUntil([count]()
+                                       { return answered().size() > count; }));
+  }
+
+  uint32_t tooLargeCount()
+  {
+    uint32_t count = 0;
+    JsonDocument messages = client.messages();
+    for (JsonObject message : messages.as<JsonArray>())
+    {
+      if (message["message"] == "Message too large")
+      {
+        TEST_ASSERT_FALSE(message["success"].as<bool>());
+        count++;
+      }
+    }
+    return count;
+  }
+
+  /**
+   * @brief Hand length bytes of message from index on to the manager as one fragment, like the socket library does
+   */
+  void fragment(const String &message, size_t index, size_t length, uint32_t num, bool final)
+  {
+    AsyncWebSocket *ws = server.webSocket("/ws");
+    AsyncWebSocketClient *socket = ws->client(client.id());
+    TEST_ASSERT_NOT_NULL(socket);
+
+    AwsFrameInfo info = {};
+    info.message_opcode = WS_TEXT;
+    info.opcode = WS_TEXT;
+    info.num = num;
+    info.index = index;
+    info.len = message.length();
+    info.final = final;
+    std::vector<uint8_t> data(message.c_str() + index, message.c_str() + index + length);
+    data.push_back(0);
+    wsManager.onEvent(ws, socket, WS_EVT_DATA, &info, data.data(), length);
+  }
+}
+
+void setUp()
+{
+  client.clear();
+}
+
+void tearDown()
+{
+}
+
+void test_fragmented_message_is_reassembled()
+{
+  client.send(requestOf("small-fragments", 4096), 100);
+  client.send(requestOf("one-byte-fragments", 300), 1);
+  sync();
+
+  const std::vector<String> ids = answered();
+  TEST_ASSERT_EQUAL_UINT32(3, ids.size());
+  TEST_ASSERT_EQUAL_STRING("small-fragments", ids[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("one-byte-fragments", ids[1].c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, tooLargeCount());
+}
+
+void test_message_at_the_limit_is_accepted()
+{
+  client.send(requestOf("whole", kMaxMessageBytes));
+  client.send(requestOf("fragmented", kMaxMessageBytes), 1024);
+  sync();
+
+  const std::vector<String> ids = answered();
+  TEST_ASSERT_EQUAL_UINT32(3, ids.size());
+  TEST_ASSERT_EQUAL_STRING("whole", ids[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("fragmented", ids[1].c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, tooLargeCount());
+}
+
+void test_message_over_the_limit_is_refused()
+{
+  client.send(requestOf("whole", kMaxMessageBytes + 1));
+  client.send(requestOf("fragmented", kMaxMessageBytes + 1), 1024);
+  sync();
+
+  // One refusal per message, not per fragment; the next message is handled as usual
+  TEST_ASSERT_EQUAL_UINT32(2, tooLargeCount());
+  const std::vector<String> ids = answered();
+  TEST_ASSERT_EQUAL_UINT32(1, ids.size());
+  TEST_ASSERT_EQUAL_STRING("sync", ids[0].c_str());
+}
+
+void test_unfinished_message_is_replaced_by_the_next()
+{
+  const String cutOff = requestOf("cut-off", 2048);
+  fragment(cutOff, 0, 1024, 0, false);
+  client.send(requestOf("next", 2048), 512);
+  sync();
+
+  const std::vector<String> ids = answered();
+  TEST_ASSERT_EQUAL_UINT32(2, ids.size());
+  TEST_ASSERT_EQUAL_STRING("next", ids[0].c_str());
+}
+
+void test_fragments_without_their_start_are_skipped()
+{
+  // The rest of a message whose first fragment never came
+  const String headless = requestOf("headless", 3072);
+  fragment(headless, 1024, 1024, 1, false);
+  fragment(headless, 2048, 1024, 2, true);
+  sync();
+
+  const std::vector<String> ids = answered();
+  TEST_ASSERT_EQUAL_UINT32(1, ids.size());
+  TEST_ASSERT_EQUAL_STRING("sync", ids[0].c_str());
+  TEST_ASSERT_EQUAL_UINT32(0, tooLargeCount());
+}
+
+int main(int argc, char **argv)
+{
+  wstest::setupFirmware();
+  client.connect();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_fragmented_message_is_reassembled);
+  RUN_TEST(test_message_at_the_limit_is_accepted);
+  RUN_TEST(test_message_over_the_limit_is_refused);
+  RUN_TEST(test_unfinished_message_is_replaced_by_the_next);
+  RUN_TEST(test_fragments_without_their_start_are_skipped);
+  const int failures = UNITY_END();
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(failures);
+}
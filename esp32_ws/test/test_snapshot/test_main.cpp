@@ -0,0 +1,76 @@
+/**
+ * @file test_main.cpp
+ * @brief Connect snapshot tests (native build): pio test -e native_test
+ *
+ * Runs the firmware's WebSocketManager and devices from esp32_ws/config.json
+ * on the host HAL, through the same harness as the native tools.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "devices/mixins/IControllable.h"
+#include "../common/WsTestClient.h"
+
+namespace
+{
+  constexpr const char *SERVO_ID = "lift-loader";
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_snapshot_has_state_changed_without_clients()
+{
+  IControllable *servo = mixins::ControllableRegistry::get(SERVO_ID);
+  TEST_ASSERT_NOT_NULL(servo);
+  JsonDocument before;
+  servo->addStateToJson(before);
+
+  // A client that got the state, and left
+  wstest::Client client;
+  client.connect();
+  client.disconnect();
+  JsonDocument sent = client.messagesOf("device-state", SERVO_ID);
+  TEST_ASSERT_EQUAL_UINT32(1, sent.size());
+  const uint32_t versionSent = sent[0]["version"];
+
+  // Nobody is connected while the servo moves
+  JsonDocument args;
+  args["value"] = before["value"].as<float>() > 50 ? 0.0f : 1.0f; // 0..1 in, percent in the state
+  args["durationMs"] = 0;
+  JsonObject argsObj = args.as<JsonObject>();
+  TEST_ASSERT_TRUE(servo->control("setValue", &argsObj));
+  deviceManager.loop();
+  TEST_ASSERT_FALSE(wsManager.hasClients());
+
+  JsonDocument now;
+  servo->addStateToJson(now);
+  TEST_ASSERT_TRUE(now["value"] != before["value"]);
+
+  client.connect();
+
+  JsonDocument messages = client.messagesOf("device-state", SERVO_ID);
+  TEST_ASSERT_EQUAL_UINT32(1, messages.size());
+  TEST_ASSERT_EQUAL_FLOAT(now["value"].as<float>(), messages[0]["state"]["value"].as<float>());
+  TEST_ASSERT_GREATER_THAN_UINT32(versionSent, messages[0]["version"].as<uint32_t>());
+}
+
+int main(int argc, char **argv)
+{
+  wstest::setupFirmware();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_snapshot_has_state_changed_without_clients);
+  const int failures = UNITY_END();
+
+  // Device tasks are still running; skip static destructors instead of tearing objects down under them
+  fflush(stdout);
+  std::quick_exit(failures);
+}
@@ -0,0 +1,205 @@
+/**
+ * @file test_main.cpp
+ * @brief Versioned device-state delta tests (native build): pio test -e native_test
+ *
+ * ControllableMixin on a device whose state the test sets directly, so
+ * every key that is added, changed or removed is known.
+ */
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+
+#include "devices/Device.h"
+#include "devices/mixins/ControllableMixin.h"
+
+namespace
+{
+  class DeltaDevice : public Device, public ControllableMixin<DeltaDevice>
+  {
+  public:
+    explicit DeltaDevice(const String &id) : Device(id, "delta") {}
+
+    JsonDocument state;
+
+    void addStateToJson(JsonDocument &doc) override { doc.set(state); }
+    bool control(const String &, JsonObject *) override { return false; }
+
+    // No StateMixin: the test asks for every change itself
+    template <typename Callback>
+    void onStateChange(Callback) {}
+  };
+
+  DeltaDevice *device = nullptr;
+}
+
+void setUp()
+{
+  ControllableMixinBase::setStateDeltas(true);
+  device = new DeltaDevice("delta-1");
+  device->state["mode"] = "IDLE";
+  device->state["position"] = 0;
+  device->state["limits"]["min"] = 0;
+  device->state["limits"]["max"] = 100;
+}
+
+void tearDown()
+{
+  delete device;
+  device = nullptr;
+}
+
+void test_first_change_is_the_full_state()
+{
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+
+  TEST_ASSERT_EQUAL_STRING("device-state", doc["type"].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING("delta-1", doc["deviceId"].as<const char *>());
+  TEST_ASSERT_FALSE(doc["delta"].is<bool>());
+  TEST_ASSERT_EQUAL_UINT32(1, doc["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(3, doc["state"].size());
+  TEST_ASSERT_EQUAL_UINT32(1, device->getStateVersion());
+}
+
+void test_change_sends_only_the_changed_keys()
+{
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+
+  device->state["position"] = 42;
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+
+  TEST_ASSERT_TRUE(doc["delta"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(2, doc["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(1, doc["state"].size());
+  TEST_ASSERT_EQUAL_INT(42, doc["state"]["position"].as<int>());
+  TEST_ASSERT_FALSE(doc["removed"].is<JsonArray>());
+}
+
+void test_nested_change_sends_the_whole_top_level_key()
+{
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+
+  device->state["limits"]["max"] = 200;
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+
+  TEST_ASSERT_EQUAL_UINT32(1, doc["state"].size());
+  TEST_ASSERT_EQUAL_INT(0, doc["state"]["limits"]["min"].as<int>());
+  TEST_ASSERT_EQUAL_INT(200, doc["state"]["limits"]["max"].as<int>());
+}
+
+void test_unchanged_state_sends_nothing_and_keeps_the_version()
+{
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(device->addStateChangeToJson(doc));
+  TEST_ASSERT_EQUAL_UINT32(0, doc.size());
+  TEST_ASSERT_EQUAL_UINT32(1, device->getStateVersion());
+
+  // The next real change follows on without a gap
+  device->state["mode"] = "MOVING";
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+  TEST_ASSERT_EQUAL_UINT32(2, doc["version"].as<uint32_t>());
+}
+
+void test_removed_and_added_keys()
+{
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+
+  device->state.remove("limits");
+  device->state["error"] = "stalled";
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+
+  TEST_ASSERT_TRUE(doc["delta"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(1, doc["state"].size());
+  TEST_ASSERT_EQUAL_STRING("stalled", doc["state"]["error"].as<const char *>());
+  TEST_ASSERT_EQUAL_UINT32(1, doc["removed"].size());
+  TEST_ASSERT_EQUAL_STRING("limits", doc["removed"][0].as<const char *>());
+
+  // A key that is removed and comes back is sent as a change
+  device->state["limits"]["min"] = 0;
+  JsonDocument back;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(back));
+  TEST_ASSERT_TRUE(back["state"]["limits"].is<JsonObject>());
+  TEST_ASSERT_FALSE(back["removed"].is<JsonArray>());
+}
+
+void test_without_deltas_every_change_is_the_full_state()
+{
+  ControllableMixinBase::setStateDeltas(false);
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+
+  device->state["position"] = 7;
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+  TEST_ASSERT_FALSE(doc["delta"].is<bool>());
+  TEST_ASSERT_EQUAL_UINT32(3, doc["state"].size());
+  TEST_ASSERT_EQUAL_UINT32(2, doc["version"].as<uint32_t>());
+}
+
+void test_snapshot_is_a_new_version_and_the_new_base()
+{
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+
+  device->state["position"] = 10;
+  JsonDocument snapshot;
+  device->addStateSnapshotToJson(snapshot);
+  TEST_ASSERT_EQUAL_UINT32(2, snapshot["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(3, snapshot["state"].size());
+  TEST_ASSERT_EQUAL_INT(10, snapshot["state"]["position"].as<int>());
+
+  // Already in the snapshot: not a change any more
+  JsonDocument doc;
+  TEST_ASSERT_FALSE(device->addStateChangeToJson(doc));
+
+  device->state["position"] = 11;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+  TEST_ASSERT_EQUAL_UINT32(3, doc["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_UINT32(1, doc["state"].size());
+}
+
+void test_last_state_is_what_clients_have()
+{
+  JsonDocument none;
+  TEST_ASSERT_FALSE(device->addLastStateToJson(none));
+
+  JsonDocument first;
+  device->addStateChangeToJson(first);
+  device->state["position"] = 5; // Not sent yet
+
+  JsonDocument last;
+  TEST_ASSERT_TRUE(device->addLastStateToJson(last));
+  TEST_ASSERT_EQUAL_UINT32(1, last["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_INT(0, last["state"]["position"].as<int>());
+  TEST_ASSERT_EQUAL_UINT32(1, device->getStateVersion());
+
+  // Deltas still apply to it
+  JsonDocument doc;
+  TEST_ASSERT_TRUE(device->addStateChangeToJson(doc));
+  TEST_ASSERT_EQUAL_UINT32(2, doc["version"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_INT(5, doc["state"]["position"].as<int>());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_change_is_the_full_state);
+  RUN_TEST(test_change_sends_only_the_changed_keys);
+  RUN_TEST(test_nested_change_sends_the_whole_top_level_key);
+  RUN_TEST(test_unchanged_state_sends_nothing_and_keeps_the_version);
+  RUN_TEST(test_removed_and_added_keys);
+  RUN_TEST(test_without_deltas_every_change_is_the_full_state);
+  RUN_TEST(test_snapshot_is_a_new_version_and_the_new_base);
+  RUN_TEST(test_last_state_is_what_clients_have);
+  return UNITY_END();
+}
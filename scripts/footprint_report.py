@@ -0,0 +1,260 @@
+"""Flash and static RAM footprint report for the firmware.
+
+Breaks the linked firmware down by
+
+- device type: members, vtables and statics of devices::<Type>
+- mixin instantiation: each CRTP mixin per device, e.g. ControllableMixin<Stepper>
+- library: AccelStepper, ArduinoJson, DYPlayer, the web server, the Arduino
+  core, ESP-IDF components, the C/C++ runtime and the firmware itself
+
+Symbol sizes come from `nm`; flash is text + rodata + initialised data,
+static RAM is initialised data + bss. The object file a symbol came from is
+looked up in the linker map, which the PlatformIO hook below enables.
+Header-only libraries (ArduinoJson) are recognised by namespace.
+
+As a PlatformIO extra script it prints the report after every firmware
+link and writes it to footprint.txt in the build directory. It can also be
+run on its own:
+
+    python scripts/footprint_report.py .pio/build/<env>/firmware.elf \\
+        --map .pio/build/<env>/firmware.map --nm xtensa-esp32s3-elf-nm
+"""
+
+from __future__ import annotations
+
+import argparse
+import bisect
+import re
+import subprocess
+from collections import defaultdict
+from dataclasses import dataclass
+from pathlib import Path
+
+FLASH_TYPES = set("tTwWvVrRdD")
+RAM_TYPES = set("bBdD")
+
+# Demangled prefixes that do not change which class a symbol belongs to
+SYMBOL_PREFIXES = (
+    "vtable for ",
+    "typeinfo for ",
+    "typeinfo name for ",
+    "non-virtual thunk to ",
+    "virtual thunk to ",
+    "guard variable for ",
+    "construction vtable for ",
+)
+
+DEVICE_PATTERN = re.compile(r"^devices::(\w+)::")
+DEVICE_SUFFIX_PATTERN = re.compile(r"(?:Config|State|StateEnum|ErrorCode)$")
+MIXIN_PATTERN = re.compile(r"^(?:mixins::)?(\w+Mixin)<(?:devices::)?(\w+)")
+
+# Libraries recognised by symbol name; checked before the object file path
+NAMED_LIBRARIES = (
+    (re.compile(r"^ArduinoJson"), "ArduinoJson"),
+    (re.compile(r"^AccelStepper\b"), "AccelStepper"),
+    (re.compile(r"^(?:DY::|DYPlayer)"), "DYPlayer"),
+    (re.compile(r"^(?:AsyncWeb|AsyncCallbackWebHandler|AsyncStatic|AsyncEventSource|AsyncResponse|WebRequest)"), "ESPAsyncWebServer"),
+    (re.compile(r"^(?:AsyncClient|AsyncServer|AsyncTCP)"), "AsyncTCP"),
+)
+
+BUILD_LIB_PATTERN = re.compile(r"\.pio/(?:libdeps|build)/[^/]+/(?:lib[0-9a-f]*/)?([^/]+)/")
+ARCHIVE_PATTERN = re.compile(r"lib([\w+-]+)\.a\(")
+MAP_LINE_PATTERN = re.compile(r"^ (\.\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+MAP_SECTION_ONLY_PATTERN = re.compile(r"^ (\.\S+)$")
+
+
+@dataclass
+class Symbol:
+    address: int
+    size: int
+    kind: str
+    name: str
+
+    @property
+    def flash(self) -> int:
+        return self.size if self.kind in FLASH_TYPES else 0
+
+    @property
+    def ram(self) -> int:
+        return self.size if self.kind in RAM_TYPES else 0
+
+
+class Footprint:
+    def __init__(self) -> None:
+        self.flash: dict[str, int] = defaultdict(int)
+        self.ram: dict[str, int] = defaultdict(int)
+
+    def add(self, key: str, symbol: Symbol) -> None:
+        self.flash[key] += symbol.flash
+        self.ram[key] += symbol.ram
+
+    def rows(self) -> list[tuple[str, int, int]]:
+        keys = set(self.flash) | set(self.ram)
+        return sorted(((k, self.flash[k], self.ram[k]) for k in keys), key=lambda row: (-row[1], -row[2], row[0]))
+
+
+def read_symbols(elf: Path, nm: str) -> list[Symbol]:
+    output = subprocess.run(
+        [nm, "--demangle", "--print-size", "--size-sort", str(elf)],
+        check=True,
+        capture_output=True,
+        text=True,
+    ).stdout
+    symbols = []
+    for line in output.splitlines():
+        parts = line.split(" ", 3)
+        if len(parts) != 4:
+            continue
+        address, size, kind, name = parts
+        symbols.append(Symbol(int(address, 16), int(size, 16), kind, name))
+    return symbols
+
+
+def read_map(map_file: Path) -> tuple[list[int], list[tuple[int, str]]]:
+    """Input sections of the linker map as (sorted starts, [(end, object)])."""
+    sections: list[tuple[int, int, str]] = []
+    in_memory_map = False
+    pending_section = False
+    for line in map_file.read_text(errors="replace").splitlines():
+        if not in_memory_map:
+            in_memory_map = line.startswith("Linker script and memory map")
+            continue
+        if MAP_SECTION_ONLY_PATTERN.match(line):
+            # Long section names put the address on the next line
+            pending_section = True
+            continue
+        match = MAP_LINE_PATTERN.match(line)
+        if match and (match.group(1) or pending_section):
+            start, size, obj = int(match.group(2), 16), int(match.group(3), 16), match.group(4).strip()
+            if size and start:
+                sections.append((start, start + size, obj))
+        pending_section = False
+
+    sections.sort()
+    return [start for start, _, _ in sections], [(end, obj) for _, end, obj in sections]
+
+
+def object_for(address: int, starts: list[int], ends: list[tuple[int, str]]) -> str | None:
+    index = bisect.bisect_right(starts, address) - 1
+    if index < 0:
+        return None
+    end, obj = ends[index]
+    return obj if address < end else None
+
+
+def library_for(name: str, obj: str | None) -> str:
+    for pattern, library in NAMED_LIBRARIES:
+        if pattern.search(name):
+            return library
+    if obj is None:
+        return "(unknown)"
+
+    path = obj.replace("\\", "/")
+    if "/src/" in path and ".pio/build/" in path:
+        return "firmware"
+    if "framework-arduinoespressif32" in path:
+        return "arduino-esp32 core"
+    build_lib = BUILD_LIB_PATTERN.search(path)
+    if build_lib:
+        return build_lib.group(1)
+    archive = ARCHIVE_PATTERN.search(path)
+    if archive:
+        lib = archive.group(1)
+        if lib in ("c", "m", "gcc", "stdc++", "supc++", "nosys", "g"):
+            return f"toolchain: lib{lib}"
+        return f"esp-idf: {lib}"
+    return Path(path).name
+
+
+def strip_prefix(name: str) -> str:
+    for prefix in SYMBOL_PREFIXES:
+        if name.startswith(prefix):
+            return name[len(prefix):]
+    return name
+
+
+def build_report(elf: Path, map_file: Path | None, nm: str, top: int) -> str:
+    symbols = read_symbols(elf, nm)
+    starts: list[int] = []
+    ends: list[tuple[int, str]] = []
+    if map_file and map_file.exists():
+        starts, ends = read_map(map_file)
+
+    devices = Footprint()
+    mixins = Footprint()
+    libraries = Footprint()
+    total = Footprint()
+    for symbol in symbols:
+        name = strip_prefix(symbol.name)
+        total.add("total", symbol)
+
+        mixin = MIXIN_PATTERN.match(name)
+        device = DEVICE_PATTERN.match(name)
+        if mixin:
+            mixins.add(f"{mixin.group(1)}<{mixin.group(2)}>", symbol)
+        elif device:
+            # devices::StepperConfig and friends count towards their device
+            devices.add(DEVICE_SUFFIX_PATTERN.sub("", device.group(1)) or device.group(1), symbol)
+
+        libraries.add(library_for(name, object_for(symbol.address, starts, ends) if starts else None), symbol)
+
+    lines = [f"Footprint of {elf} (symbol sizes; flash = text+rodata+data, RAM = data+bss)"]
+    lines.append(f"  total: {total.flash['total']:>9} flash {total.ram['total']:>9} RAM")
+
+    def table(title: str, footprint: Footprint, limit: int | None) -> None:
+        rows = footprint.rows()
+        lines.append("")
+        lines.append(f"{title:<44} {'flash':>9} {'RAM':>9}")
+        for key, flash, ram in rows[:limit]:
+            lines.append(f"  {key:<42} {flash:>9} {ram:>9}")
+        if limit is not None and len(rows) > limit:
+            rest = rows[limit:]
+            lines.append(f"  {f'({len(rest)} more)':<42} {sum(r[1] for r in rest):>9} {sum(r[2] for r in rest):>9}")
+        lines.append(f"  {'sum':<42} {sum(r[1] for r in rows):>9} {sum(r[2] for r in rows):>9}")
+
+    table("By device type (devices::<Type> members)", devices, None)
+    table("By mixin instantiation", mixins, None)
+    table("By library" + ("" if starts else " (no linker map: named libraries only)"), libraries, top)
+    return "\n".join(lines)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Flash/RAM footprint by device type, mixin and library")
+    parser.add_argument("elf", type=Path)
+    parser.add_argument("--map", type=Path, help="linker map (default: firmware.map next to the ELF)")
+    parser.add_argument("--nm", default="xtensa-esp32s3-elf-nm")
+    parser.add_argument("--top", type=int, default=25, help="libraries to list")
+    args = parser.parse_args()
+
+    map_file = args.map or args.elf.with_suffix(".map")
+    print(build_report(args.elf, map_file, args.nm, args.top))
+
+
+def _register_platformio_hook() -> None:
+    from SCons.Script import DefaultEnvironment
+
+    env = DefaultEnvironment()
+    build_dir = Path(env.subst("$BUILD_DIR"))
+    map_file = build_dir / "firmware.map"
+    env.Append(LINKFLAGS=[f"-Wl,-Map,{map_file}"])
+
+    # nm from the same toolchain as the compiler, e.g. xtensa-esp32s3-elf-gcc -> xtensa-esp32s3-elf-nm
+    nm = re.sub(r"g(?:cc|\+\+)$", "nm", env.subst("$CC"))
+
+    def report(target, source, env) -> None:  # type: ignore[no-untyped-def]
+        elf = Path(str(target[0]))
+        try:
+            text = build_report(elf, map_file, nm, 25)
+        except (OSError, subprocess.CalledProcessError) as err:
+            print(f"Footprint report skipped: {err}")
+            return
+        print(text)
+        (build_dir / "footprint.txt").write_text(text + "\n")
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)
+
+
+if __name__ == "__main__":
+    main()
+else:
+    _register_platformio_hook()
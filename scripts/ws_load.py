@@ -0,0 +1,311 @@
+"""WebSocket fan-out load generator for the marble track.
+
+Opens N WebSocket clients against /ws, lets the first one send LED 'blink'
+commands at a fixed rate and measures, per command:
+
+- echo latency: command sent -> device-state received by the sender
+- delivery time: command sent -> device-state received by the last client
+
+Every command uses a unique onTime, which the LED reports back in its
+state, so each device-state broadcast can be matched to its command. Like
+the website, every client sends a resume message right after connecting;
+the firmware holds broadcasts back from a new client until it does. A
+broadcast that does not reach a client within --timeout counts as missed:
+WebSocketManager drops messages when a client's send queue is full.
+
+Steps through every combination of --clients and --rate and prints one row
+per step, so the client count and message rate at which drops start are
+visible at a glance. Works against the board (ws://marble-track.local/ws)
+or anything else serving the same protocol. Only needs the standard
+library.
+
+Example:
+    python scripts/ws_load.py ws://marble-track.local/ws --clients 1,2,4,6 --rate 5,10,20,50
+"""
+
+from __future__ import annotations
+
+import argparse
+import asyncio
+import base64
+import json
+import os
+import struct
+import time
+from dataclasses import dataclass, field
+from urllib.parse import urlsplit
+
+OPCODE_CONTINUATION = 0x0
+OPCODE_TEXT = 0x1
+OPCODE_CLOSE = 0x8
+OPCODE_PING = 0x9
+OPCODE_PONG = 0xA
+
+# onTime values used as command tags; far above anything a user would set
+TAG_BASE = 100000
+
+
+class WebSocketClosed(Exception):
+    pass
+
+
+class WebSocketClient:
+    """Minimal RFC 6455 text client on top of asyncio streams."""
+
+    def __init__(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        self._reader = reader
+        self._writer = writer
+
+    @classmethod
+    async def connect(cls, url: str, timeout: float) -> "WebSocketClient":
+        parsed = urlsplit(url)
+        host = parsed.hostname or "localhost"
+        port = parsed.port or 80
+        path = parsed.path or "/"
+
+        reader, writer = await asyncio.wait_for(asyncio.open_connection(host, port), timeout)
+        key = base64.b64encode(os.urandom(16)).decode("ascii")
+        request = (
+            f"GET {path} HTTP/1.1\r\n"
+            f"Host: {host}:{port}\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key}\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n"
+        )
+        writer.write(request.encode("ascii"))
+        await writer.drain()
+
+        response = await asyncio.wait_for(reader.readuntil(b"\r\n\r\n"), timeout)
+        status = response.split(b"\r\n", 1)[0]
+        if b" 101 " not in status:
+            writer.close()
+            raise ConnectionError(f"WebSocket handshake failed: {status.decode(errors='replace')}")
+        return cls(reader, writer)
+
+    async def send_text(self, text: str) -> None:
+        await self._send_frame(OPCODE_TEXT, text.encode("utf-8"))
+
+    async def _send_frame(self, opcode: int, payload: bytes) -> None:
+        header = bytearray([0x80 | opcode])
+        length = len(payload)
+        if length < 126:
+            header.append(0x80 | length)
+        elif length < 65536:
+            header.append(0x80 | 126)
+            header += struct.pack("!H", length)
+        else:
+            header.append(0x80 | 127)
+            header += struct.pack("!Q", length)
+
+        # Client frames must be masked
+        mask = os.urandom(4)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self._writer.write(bytes(header) + mask + masked)
+        await self._writer.drain()
+
+    async def receive_text(self) -> str:
+        message = bytearray()
+        while True:
+            first, second = await self._reader.readexactly(2)
+            final = bool(first & 0x80)
+            opcode = first & 0x0F
+            length = second & 0x7F
+            if length == 126:
+                (length,) = struct.unpack("!H", await self._reader.readexactly(2))
+            elif length == 127:
+                (length,) = struct.unpack("!Q", await self._reader.readexactly(8))
+            if second & 0x80:
+                mask = await self._reader.readexactly(4)
+                payload = bytes(b ^ mask[i % 4] for i, b in enumerate(await self._reader.readexactly(length)))
+            else:
+                payload = await self._reader.readexactly(length)
+
+            if opcode == OPCODE_PING:
+                await self._send_frame(OPCODE_PONG, payload)
+                continue
+            if opcode == OPCODE_CLOSE:
+                raise WebSocketClosed()
+            if opcode in (OPCODE_TEXT, OPCODE_CONTINUATION):
+                message += payload
+                if final:
+                    return message.decode("utf-8", errors="replace")
+
+    def close(self) -> None:
+        self._writer.close()
+
+
+@dataclass
+class StepResult:
+    clients: int
+    rate: float
+    sent: int = 0
+    connected: int = 0
+    disconnected: int = 0
+    echo_ms: list[float] = field(default_factory=list)
+    delivery_ms: list[float] = field(default_factory=list)
+    missed: int = 0
+
+
+def _messages(text: str) -> list[dict]:
+    # The firmware sends batches as JSON arrays, single messages as objects
+    try:
+        data = json.loads(text)
+    except json.JSONDecodeError:
+        return []
+    return data if isinstance(data, list) else [data]
+
+
+def _first_led(devices: list[dict]) -> str | None:
+    for device in devices:
+        if device.get("type") == "led":
+            return device["id"]
+        child = _first_led(device.get("children", []))
+        if child:
+            return child
+    return None
+
+
+async def _find_led(url: str, timeout: float) -> str:
+    client = await WebSocketClient.connect(url, timeout)
+    try:
+        await client.send_text(json.dumps({"type": "devices-list"}))
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            text = await asyncio.wait_for(client.receive_text(), deadline - time.monotonic())
+            for message in _messages(text):
+                if message.get("type") != "devices-list":
+                    continue
+                led = _first_led(message.get("devices", []))
+                if led is None:
+                    raise RuntimeError("No LED in devices-list; pass --device")
+                return led
+    finally:
+        client.close()
+    raise RuntimeError("No devices-list response")
+
+
+async def run_step(url: str, device_id: str, clients: int, rate: float, duration: float, timeout: float, tag_start: int) -> StepResult:
+    result = StepResult(clients, rate)
+    sockets: list[WebSocketClient] = []
+    for _ in range(clients):
+        try:
+            sock = await WebSocketClient.connect(url, timeout)
+            await sock.send_text(json.dumps({"type": "resume"}))
+            sockets.append(sock)
+        except (OSError, asyncio.TimeoutError, ConnectionError):
+            pass
+    result.connected = len(sockets)
+    if not sockets:
+        return result
+
+    sent_at: dict[int, float] = {}
+    received_at: list[dict[int, float]] = [{} for _ in sockets]
+    alive = [True] * len(sockets)
+
+    async def reader(index: int) -> None:
+        try:
+            while True:
+                text = await sockets[index].receive_text()
+                now = time.monotonic()
+                for message in _messages(text):
+                    if message.get("type") != "device-state" or message.get("deviceId") != device_id:
+                        continue
+                    tag = message.get("state", {}).get("blinkOnTime")
+                    if isinstance(tag, int) and tag in sent_at:
+                        received_at[index].setdefault(tag, now)
+        except (WebSocketClosed, asyncio.IncompleteReadError, ConnectionError, OSError):
+            alive[index] = False
+
+    readers = [asyncio.create_task(reader(i)) for i in range(len(sockets))]
+
+    interval = 1.0 / rate
+    start = time.monotonic()
+    tag = tag_start
+    while time.monotonic() - start < duration and alive[0]:
+        command = {"type": "device-fn", "deviceId": device_id, "fn": "blink", "args": {"onTime": tag, "offTime": 500}}
+        sent_at[tag] = time.monotonic()
+        try:
+            await sockets[0].send_text(json.dumps(command))
+        except (ConnectionError, OSError):
+            break
+        tag += 1
+        next_send = start + (tag - tag_start) * interval
+        await asyncio.sleep(max(0.0, next_send - time.monotonic()))
+
+    # Give the last broadcasts time to arrive
+    await asyncio.sleep(timeout)
+    for task in readers:
+        task.cancel()
+    for sock in sockets:
+        sock.close()
+
+    result.sent = len(sent_at)
+    result.disconnected = alive.count(False)
+    for tag_sent, at in sent_at.items():
+        echo = received_at[0].get(tag_sent)
+        if echo is not None:
+            result.echo_ms.append((echo - at) * 1000)
+        arrivals = [received[tag_sent] for received in received_at if tag_sent in received and received[tag_sent] - at <= timeout]
+        result.missed += len(sockets) - len(arrivals)
+        if len(arrivals) == len(sockets):
+            result.delivery_ms.append((max(arrivals) - at) * 1000)
+    return result
+
+
+def _percentile(values: list[float], p: float) -> float:
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(p * (len(ordered) - 1) + 0.5))]
+
+
+def _print_result(result: StepResult) -> None:
+    deliveries = result.sent * max(result.connected, 1)
+    missed_pct = 100.0 * result.missed / deliveries if deliveries else 0.0
+    print(
+        f"{result.clients:>7} {result.rate:>7.1f} {result.connected:>9} {result.sent:>6} "
+        f"{_percentile(result.echo_ms, 0.5):>9.1f} {_percentile(result.echo_ms, 0.99):>9.1f} "
+        f"{_percentile(result.delivery_ms, 0.5):>9.1f} {_percentile(result.delivery_ms, 0.99):>9.1f} "
+        f"{max(result.delivery_ms, default=float('nan')):>9.1f} {result.missed:>7} {missed_pct:>7.1f}% {result.disconnected:>6}"
+    )
+
+
+async def main() -> None:
+    parser = argparse.ArgumentParser(description="WebSocket fan-out load generator")
+    parser.add_argument("url", nargs="?", default="ws://marble-track.local/ws")
+    parser.add_argument("--clients", default="1,2,4,6,8", help="comma separated client counts")
+    parser.add_argument("--rate", default="2,5,10,20", help="comma separated command rates (commands/s)")
+    parser.add_argument("--duration", type=float, default=10.0, help="seconds per step")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds before a broadcast counts as missed")
+    parser.add_argument("--device", help="LED device id (default: first LED in devices-list)")
+    args = parser.parse_args()
+
+    client_counts = [int(v) for v in args.clients.split(",") if v]
+    rates = [float(v) for v in args.rate.split(",") if v]
+    device_id = args.device or await _find_led(args.url, args.timeout)
+
+    print(f"Target {args.url}, LED '{device_id}', {args.duration:.0f} s per step")
+    print(
+        f"{'clients':>7} {'rate':>7} {'connected':>9} {'sent':>6} {'echo p50':>9} {'echo p99':>9} "
+        f"{'dlvr p50':>9} {'dlvr p99':>9} {'dlvr max':>9} {'missed':>7} {'missed%':>8} {'closed':>6}"
+    )
+
+    tag = TAG_BASE
+    first_drop: StepResult | None = None
+    for clients in client_counts:
+        for rate in rates:
+            result = await run_step(args.url, device_id, clients, rate, args.duration, args.timeout, tag)
+            tag += result.sent + 1
+            _print_result(result)
+            if first_drop is None and (result.missed or result.disconnected or result.connected < clients):
+                first_drop = result
+
+    if first_drop:
+        print(f"\nFirst drops at {first_drop.clients} clients, {first_drop.rate:.1f} commands/s")
+    else:
+        print("\nNo drops")
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
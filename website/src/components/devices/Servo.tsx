@@ -3,16 +3,16 @@ import { debounce } from "@solid-primitives/scheduled";
 import { createEffect, createMemo, createSignal } from "solid-js";
 import deviceStyles from "./Device.module.css";
 import servoStyles from "./Servo.module.css";
-import { useServo } from "../../stores/Servo";
+import { IServoState, useServo } from "../../stores/Servo";
 import { ServoIcon } from "../icons/Icons";
 import ServoConfig from "./ServoConfig";
+import { useTelemetry } from "../../stores/Devices";
 
 export function Servo(props: { id: string; isPopup?: boolean; onClose?: () => void }) {
   const servoStore = useServo(props.id);
   const device = () => servoStore[0];
   const actions = servoStore[1];
-
-  const deviceState = createMemo(() => device()?.state);
+  const deviceState = useTelemetry<IServoState>(props.id);
   const [currentValue, setCurrentValue] = createSignal<number | undefined>(undefined);
   const [currentDuration, setCurrentDuration] = createSignal<number>(
     device()?.config?.defaultDurationInMs ?? 500
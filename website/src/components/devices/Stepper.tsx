@@ -2,16 +2,16 @@ import { createEffect, createMemo, createSignal } from "solid-js";
 import { Device } from "./Device";
 import styles from "./Device.module.css";
 import stepperStyles from "./Stepper.module.css";
-import { useStepper } from "../../stores/Stepper";
+import { IStepperState, useStepper } from "../../stores/Stepper";
 import StepperConfig from "./StepperConfig";
 import { StepperIcon } from "../icons/Icons";
+import { useTelemetry } from "../../stores/Devices";
 
 export function Stepper(props: { id: string; isPopup?: boolean; onClose?: () => void }) {
   const stepperStore = useStepper(props.id);
   const device = () => stepperStore[0];
   const actions = stepperStore[1];
-
-  const state = createMemo(() => device()?.state);
+  const state = useTelemetry<IStepperState>(props.id);
   const config = createMemo(() => device()?.config);
   const isMoving = createMemo(() => Boolean(state()?.isMoving));
   const currentPosition = createMemo(() => state()?.currentPosition ?? 0);
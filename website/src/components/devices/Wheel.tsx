@@ -5,16 +5,16 @@ import "./Wheel.module.css";
 
 import { WheelConfig } from "./WheelConfig";
 import { WheelGraphic } from "./WheelGraphic";
-import { useWheel } from "../../stores/Wheel";
+import { IWheelState, useWheel } from "../../stores/Wheel";
 import { useWheelAnimation } from "../../hooks/useWheelAnimation";
 import { getDeviceIcon } from "../icons/Icons";
+import { useTelemetry } from "../../stores/Devices";
 
 export function Wheel(props: { id: string; isPopup?: boolean; onClose?: () => void }) {
   const wheelStore = useWheel(props.id);
   const device = () => wheelStore[0];
   const actions = wheelStore[1];
-
-  const state = () => device()?.state;
+  const state = useTelemetry<IWheelState>(props.id);
   // TODO: Handle error state - might need to be added to device state
   const error = () => undefined; // Placeholder until error handling is implemented
 
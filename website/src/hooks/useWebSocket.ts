@@ -202,6 +202,9 @@ function createWebSocketStore(url?: string): [IWebSocketStore, IWebSocketActions
   // Message subscribers
   const messageSubscribers = new Set<MessageCallback>();
 
+  // Position in the firmware's broadcast stream; resumed from on reconnect so only missed broadcasts are resent
+  let sync: { epoch: number; seq: number } | null = null;
+
   // Deduplication cache: message string -> last sent timestamp
   const sentMessagesCache = new Map<string, number>();
   const DEDUPE_WINDOW_MS = 100; // Don't send identical messages within 100ms
@@ -258,6 +261,7 @@ function createWebSocketStore(url?: string): [IWebSocketStore, IWebSocketActions
       reconnectAttempts: 0,
       lastHeartbeat: Date.now(),
     });
+    sendMessage(sync ? { type: "resume", epoch: sync.epoch, lastSeq: sync.seq } : { type: "resume" });
   };
 
   const handleClose = (event: CloseEvent) => {
@@ -295,6 +299,12 @@ function createWebSocketStore(url?: string): [IWebSocketStore, IWebSocketActions
     parsedData.forEach((msg) => {
       console.log("WebSocket message received:", msg);
 
+      if (msg.type === "sync") {
+        sync = { epoch: msg.epoch, seq: msg.seq };
+      } else if (sync && msg.seq !== undefined) {
+        sync.seq = msg.seq;
+      }
+
       // Skip heartbeat messages in batch
       if (msg.type === "pong") {
         setStore("lastHeartbeat", Date.now());
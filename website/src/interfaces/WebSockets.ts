@@ -79,10 +79,10 @@ export interface NetworkStatus {
 
 interface IWsMessageBase<TType extends string = string> {
   type: TType;
-}
-
-interface IWsMessageBase<TType extends string = string> {
-  type: TType;
+  /** Sent with a request, echoed on its reply; replies only go to the requesting client */
+  requestId?: string;
+  /** Set on broadcasts: their position in the firmware's broadcast stream, see IWsSendResumeMessage */
+  seq?: number;
 }
 
 export interface IWsDeviceMessage extends IWsMessageBase<"device-fn"> {
@@ -112,7 +112,14 @@ export type IWsReceiveDeviceStateMessage =
   | IWsDeviceError<"device-state">
   | (IWsMessageBase<"device-state"> & {
       deviceId: string;
+      /** Full state, or only the changed keys when delta is set */
       state: Record<string, unknown>;
+      /** Increases by one with every device-state broadcast of this device */
+      version?: number;
+      /** state holds only the keys changed since version - 1 */
+      delta?: boolean;
+      /** Keys no longer present in the state (deltas only) */
+      removed?: string[];
       isChanged?: boolean;
     });
 
@@ -155,6 +162,54 @@ export type IWsReceiveDeviceErrorMessage = IWsMessageBase<"device-error"> & {
   error: string;
 };
 
+export type IWsSendGetBootStatsMessage = IWsMessageBase<"boot-stats">;
+
+/**
+ * Switch the frames this client receives to MessagePack (WS_BINARY, same arrays of messages) or back to JSON.
+ * Messages sent by the client stay JSON text.
+ */
+export type IWsSendSetEncodingMessage = IWsMessageBase<"set-encoding"> & {
+  encoding: WsEncoding;
+};
+
+/**
+ * Limit the device-state messages this client receives. Until the first subscribe a client gets every device;
+ * after it only the listed device ids and types. `all: true` subscribes to every device again (or, on
+ * unsubscribe, to none).
+ */
+export type IWsSendSubscribeMessage = IWsMessageBase<"subscribe"> & {
+  deviceIds?: string[];
+  deviceTypes?: string[];
+  all?: boolean;
+};
+
+export type IWsSendUnsubscribeMessage = IWsMessageBase<"unsubscribe"> & {
+  deviceIds?: string[];
+  deviceTypes?: string[];
+  all?: boolean;
+};
+
+/**
+ * Stream sampled values of a moving device (stepper, servo, wheel) to this client at a fixed rate
+ * (at most 50 Hz); `rateHz: 0` stops the stream. Streams end when the connection closes.
+ */
+export type IWsSendGetClientStatsMessage = IWsMessageBase<"client-stats">;
+
+export type IWsSendTelemetryMessage = IWsMessageBase<"telemetry"> & {
+  deviceId: string;
+  rateHz: number;
+};
+
+/**
+ * First message after connecting. With the epoch and last seq of the previous connection the firmware resends
+ * the broadcasts missed since, if it still holds them; otherwise (or without them) it sends the device snapshot.
+ * A sync message follows either way.
+ */
+export type IWsSendResumeMessage = IWsMessageBase<"resume"> & {
+  epoch?: number;
+  lastSeq?: number;
+};
+
 // Heartbeat messages
 export type IWsReceivePongMessage = IWsMessageBase<"pong"> & {
   timestamp?: number;
@@ -208,6 +263,203 @@ export type IWsReceiveExpanderAddressesMessage =
       addresses: number[];
     });
 
+/** Loop timing in microseconds */
+export interface LoopStats {
+  count: number;
+  min: number;
+  avg: number;
+  max: number;
+  p99: number;
+}
+
+export interface DeviceLoopStats {
+  id: string;
+  type: DeviceType;
+  /** Including children */
+  total: LoopStats;
+  /** Excluding children */
+  self: LoopStats;
+}
+
+export type IWsReceiveLoopStatsMessage =
+  | (IWsMessageBase<"loop-stats"> & _IWsErrorResponse)
+  | (IWsMessageBase<"loop-stats"> & {
+      mainLoop: {
+        period: LoopStats;
+        duration: LoopStats;
+      };
+      devices: DeviceLoopStats[];
+    });
+
+export interface AllocSubsystemStats {
+  name: "loop" | "websocket" | "state-change" | "device-setup";
+  calls: number;
+  allocations: number;
+  bytes: number;
+  avgAllocationsPerCall: number;
+  maxAllocationsPerCall: number;
+  /** Over the last sample interval */
+  allocationsPerSec: number;
+}
+
+/** Heap snapshot, taken every sampleIntervalSec */
+export interface HeapSample {
+  t: number;
+  free: number;
+  largest: number;
+  /** Percent of free memory not usable for the largest allocation */
+  fragmentation: number;
+  freePsram: number;
+  largestPsram: number;
+}
+
+export interface DeviceHeapUsage {
+  id: string;
+  type: string;
+  /** Heap kept since creation, configuration and setup, children included */
+  heapBytes: number;
+}
+
+export type IWsReceiveAllocStatsMessage = IWsMessageBase<"alloc-stats"> & {
+  uptimeSec: number;
+  sampleIntervalSec: number;
+  totals: {
+    allocations: number;
+    frees: number;
+    bytes: number;
+    allocationsPerSec: number;
+  };
+  subsystems: AllocSubsystemStats[];
+  heap: {
+    free: number;
+    minFree: number;
+    largestFreeBlock: number;
+    fragmentation: number;
+    freePsram: number;
+    largestFreePsramBlock: number;
+    psramFragmentation: number;
+  };
+  /** Oldest first */
+  samples: HeapSample[];
+  /** Root devices only */
+  devices: DeviceHeapUsage[];
+};
+
+export interface BootPhase {
+  /** e.g. "network", "device-setup", "device" */
+  name: string;
+  /** Device id for "device" phases */
+  detail?: string;
+  /** Nesting level; device phases sit under "device-setup" */
+  depth: number;
+  /** Microseconds since the application started */
+  startUs: number;
+  durationUs: number;
+}
+
+export type IWsReceiveBootStatsMessage = IWsMessageBase<"boot-stats"> & {
+  resetReason: string;
+  /** False while setup() is still running */
+  finished: boolean;
+  /** When setup() finished, microseconds since the application started */
+  totalUs: number;
+  /** Phases that did not fit in the table */
+  dropped: number;
+  /** In start order */
+  phases: BootPhase[];
+};
+
+export type WsEncoding = "json" | "msgpack";
+
+/** Sent to the requesting client only, already in the new encoding */
+export type IWsReceiveSetEncodingMessage =
+  | (IWsMessageBase<"set-encoding"> & {
+      success: false;
+      message: string;
+    })
+  | (IWsMessageBase<"set-encoding"> & {
+      success: true;
+      message: string;
+      encoding: WsEncoding;
+    });
+
+// Subscriptions of this client after a subscribe/unsubscribe
+export type IWsReceiveSubscriptionMessage =
+  | (IWsMessageBase<"subscribe" | "unsubscribe"> & {
+      success: false;
+      message: string;
+    })
+  | (IWsMessageBase<"subscribe" | "unsubscribe"> & {
+      success: true;
+      message: string;
+      all: boolean;
+      deviceIds: string[];
+      deviceTypes: string[];
+    });
+
+export type IWsReceiveTelemetryMessage =
+  | (IWsMessageBase<"telemetry"> & {
+      deviceId: string;
+      success: boolean;
+      message: string;
+      rateHz?: number;
+    })
+  // Sample; the keys are the same as in the device state
+  | (IWsMessageBase<"telemetry"> & {
+      deviceId: string;
+      /** millis() when sampled */
+      t: number;
+      values: Record<string, unknown>;
+    });
+
+/** The client has every broadcast up to seq; `resumed: false` means it got the snapshot instead */
+export type IWsReceiveSyncMessage = IWsMessageBase<"sync"> & {
+  /** Changes when the board restarts */
+  epoch: number;
+  seq: number;
+  resumed: boolean;
+};
+
+export interface WsClientStats {
+  id: number;
+  encoding: WsEncoding;
+  /** Receives device-state only for its subscriptions */
+  filtered: boolean;
+  telemetryStreams: number;
+  /** Frames waiting because the client's socket is busy */
+  queuedFrames: number;
+  queuedBytes: number;
+  /** Frames lost because the client's queue was full */
+  drops: {
+    responses: number;
+    states: number;
+    telemetry: number;
+    /** Replaced by a newer sample of the same device while queued */
+    telemetrySuperseded: number;
+  };
+}
+
+export type IWsReceiveClientStatsMessage = IWsMessageBase<"client-stats"> & {
+  /** Messages dropped because a batch was full, for all clients */
+  batchQueueFull: number;
+  /** Inbound commands refused because the firmware's command queue was full */
+  commandQueueFull: number;
+  /** Device snapshot sent to connecting clients: size, times rebuilt and times sent */
+  snapshot: { bytes: number; builds: number; sent: number };
+  /** Recent broadcasts held for clients that resume, and how often resuming worked */
+  history: {
+    seq: number;
+    oldestSeq: number;
+    messages: number;
+    bytes: number;
+    capacity: number;
+    psram: boolean;
+    resumes: number;
+    resumesRefused: number;
+  };
+  clients: WsClientStats[];
+};
+
 // Individual message type (non-batch)
 export type IWsReceiveSingleMessage =
   | IWsReceiveDevicesListMessage
@@ -226,6 +478,14 @@ export type IWsReceiveSingleMessage =
   | IWsReceiveDevicesConfigMessage
   | IWsReceiveStepsPerRevolutionMessage
   | IWsReceiveExpanderAddressesMessage
+  | IWsReceiveLoopStatsMessage
+  | IWsReceiveAllocStatsMessage
+  | IWsReceiveBootStatsMessage
+  | IWsReceiveSetEncodingMessage
+  | IWsReceiveSubscriptionMessage
+  | IWsReceiveTelemetryMessage
+  | IWsReceiveClientStatsMessage
+  | IWsReceiveSyncMessage
   | IWsReceivePongMessage;
 
 // Message is always an array of messages (batch)
@@ -256,6 +516,16 @@ export type IWsSendDeviceSaveConfigMessage = IWsMessageBase<"device-save-config"
   config: Record<string, unknown>;
 };
 
+export type IWsSendGetLoopStatsMessage = IWsMessageBase<"loop-stats"> & {
+  /** Clear the stats after this report */
+  reset?: boolean;
+};
+
+export type IWsSendGetAllocStatsMessage = IWsMessageBase<"alloc-stats"> & {
+  /** Clear the stats after this report */
+  reset?: boolean;
+};
+
 // Heartbeat message
 export type IWsSendPingMessage = IWsMessageBase<"ping"> & {
   timestamp?: number;
@@ -307,4 +577,13 @@ export type IWsSendMessage =
   | IWsSendGetNetworksMessage
   | IWsSendGetNetworkStatusMessage
   | IWsSendGetExpanderAddressesMessage
+  | IWsSendGetLoopStatsMessage
+  | IWsSendGetAllocStatsMessage
+  | IWsSendGetBootStatsMessage
+  | IWsSendSetEncodingMessage
+  | IWsSendSubscribeMessage
+  | IWsSendUnsubscribeMessage
+  | IWsSendTelemetryMessage
+  | IWsSendGetClientStatsMessage
+  | IWsSendResumeMessage
   | IWsSendPingMessage;
@@ -1,5 +1,5 @@
 import { createStore, produce } from "solid-js/store";
-import { createContext, onCleanup, onMount, useContext } from "solid-js";
+import { createContext, createEffect, createMemo, onCleanup, onMount, useContext } from "solid-js";
 import { IWebSocketActions, useWebSocket2 } from "../hooks/useWebSocket";
 import { DeviceInfo } from "../interfaces/WebSockets";
 
@@ -17,7 +17,11 @@ export interface IDevice<
   /** Generic features mirrored from firmware mixins */
   features?: string[];
   state?: TState;
+  /** Version of state, to detect missed deltas */
+  stateVersion?: number;
   stateErrorMessage?: string;
+  /** Latest telemetry sample, cleared by the next device-state so it never hides a newer state */
+  telemetry?: { t: number; values: Partial<TState> };
   config?: TConfig;
   configErrorMessage?: string;
   children?: {
@@ -38,6 +42,9 @@ export function createDevicesStore({
   // for debugging
   (window as any).__store = store;
 
+  // Devices with a device-state snapshot requested but not received yet
+  const pendingSnapshots = new Set<string>();
+
   const handleMessage: Parameters<IWebSocketActions["subscribe"]>[0] = (message) => {
     switch (message.type) {
       case "devices-list": {
@@ -169,12 +176,40 @@ export function createDevicesStore({
       }
       case "device-state": {
         if ("state" in message) {
+          const device = store.devices[message.deviceId];
+          if (
+            message.delta &&
+            device &&
+            (!device.state ||
+              message.version === undefined ||
+              device.stateVersion !== message.version - 1)
+          ) {
+            // Missed an update (or reconnected): deltas no longer apply, ask for a snapshot
+            if (!pendingSnapshots.has(message.deviceId)) {
+              pendingSnapshots.add(message.deviceId);
+              sendMessage({ type: "device-state", deviceId: message.deviceId });
+            }
+            break;
+          }
+          if (!message.delta) {
+            pendingSnapshots.delete(message.deviceId);
+          }
           setStore(
             produce((draft) => {
               const draftDevice = draft.devices[message.deviceId];
               if (draftDevice) {
-                draftDevice.state = message.state;
+                if (message.delta) {
+                  const state = { ...draftDevice.state, ...message.state };
+                  for (const key of message.removed ?? []) {
+                    delete state[key];
+                  }
+                  draftDevice.state = state;
+                } else {
+                  draftDevice.state = message.state;
+                }
+                draftDevice.stateVersion = message.version;
                 draftDevice.stateErrorMessage = undefined;
+                draftDevice.telemetry = undefined;
               }
             })
           );
@@ -191,6 +226,20 @@ export function createDevicesStore({
         }
         break;
       }
+      case "telemetry": {
+        if ("values" in message) {
+          // Kept next to the state, not in it, so deltas and snapshots stay the only writers of state
+          setStore(
+            produce((draft) => {
+              const draftDevice = draft.devices[message.deviceId];
+              if (draftDevice) {
+                draftDevice.telemetry = { t: message.t, values: message.values };
+              }
+            })
+          );
+        }
+        break;
+      }
       case "device-save-config": {
         if ("success" in message && !message.success) {
           setStore(
@@ -273,10 +322,15 @@ export function useDevice<TState extends IDeviceState, TConfig extends IDeviceCo
 
   const [, { getDeviceConfig, setDeviceConfig, getDeviceState, sendMessage }] = useDevices();
 
-  // tracking only needed once
+  // tracking only needed once; the snapshot sent on connect usually has both already
   onMount(() => {
-    getDeviceConfig(deviceId);
-    getDeviceState(deviceId);
+    const device = store.devices[deviceId];
+    if (device?.config === undefined) {
+      getDeviceConfig(deviceId);
+    }
+    if (device?.state === undefined) {
+      getDeviceState(deviceId);
+    }
   });
 
   return [
@@ -289,3 +343,41 @@ export function useDevice<TState extends IDeviceState, TConfig extends IDeviceCo
     },
   ] as const;
 }
+
+// Components showing a device's telemetry, per device id
+const telemetryUsers = new Map<string, number>();
+
+/**
+ * Stream the moving values of a device while the calling component is mounted
+ * @returns The device state with the latest telemetry sample applied on top
+ */
+export function useTelemetry<TState extends IDeviceState>(deviceId: string, rateHz = 20) {
+  const store = useContext(DevicesContext);
+  const [webSocket, { sendMessage }] = useWebSocket2();
+  telemetryUsers.set(deviceId, (telemetryUsers.get(deviceId) ?? 0) + 1);
+
+  // Streams belong to the connection; start again after a reconnect
+  createEffect(() => {
+    if (webSocket.isConnected) {
+      sendMessage({ type: "telemetry", deviceId, rateHz });
+    }
+  });
+
+  onCleanup(() => {
+    const users = (telemetryUsers.get(deviceId) ?? 1) - 1;
+    if (users > 0) {
+      telemetryUsers.set(deviceId, users);
+      return;
+    }
+    telemetryUsers.delete(deviceId);
+    sendMessage({ type: "telemetry", deviceId, rateHz: 0 });
+  });
+
+  return createMemo(() => {
+    const device = store.devices[deviceId] as IDevice<TState> | undefined;
+    if (!device?.state || !device.telemetry) {
+      return device?.state;
+    }
+    return { ...device.state, ...device.telemetry.values };
+  });
+}
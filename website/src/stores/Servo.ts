@@ -3,7 +3,7 @@ import { useDevice } from "./Devices";
 
 const deviceType = "servo";
 
-interface IServoState extends IDeviceState {
+export interface IServoState extends IDeviceState {
   value?: number;
   targetValue?: number;
   targetDurationMs?: number;